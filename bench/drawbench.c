@@ -0,0 +1,425 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Column and span drawer microbenchmark.
+//	Draws the same random columns and spans with every drawer
+//	 the CPU supports, row and column major, prints the time
+//	 per pixel, and checks that each one writes the same
+//	 pixels as the row major C drawers.
+//	Build with "make bench-draw", run as
+//	 drawbench [-repeat n] [-width w] [-height h]
+//
+//-----------------------------------------------------------------------------
+
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "doomdef.h"
+
+#include "m_argv.h"
+#include "v_video.h"
+
+#include "r_local.h"
+#include "r_simd.h"
+
+
+#define NUMCOLUMNS		8192
+#define NUMSPANS		8192
+
+// the view, as with a full screen status bar
+#define BENCHWIDTH		screenwidth
+#define BENCHHEIGHT		(screenheight-SCALEY(32))
+
+
+typedef struct
+{
+    int			x;
+    int			yl;
+    int			yh;
+    fixed_t		iscale;
+    fixed_t		texturemid;
+    int			source;
+    int			light;
+
+} benchcolumn_t;
+
+typedef struct
+{
+    int			y;
+    int			x1;
+    int			x2;
+    fixed_t		xfrac;
+    fixed_t		yfrac;
+    fixed_t		xstep;
+    fixed_t		ystep;
+    int			flat;
+    int			light;
+
+} benchspan_t;
+
+typedef enum
+{
+    cpu_any,
+    cpu_sse2,
+    cpu_avx2
+
+} cpufeature_t;
+
+typedef struct
+{
+    char*		name;
+    void		(*column) (void);
+    void		(*span) (void);
+    cpufeature_t	cpu;
+
+} drawer_t;
+
+
+drawer_t	drawers[] =
+{
+    { "C",	R_DrawColumn,		R_DrawSpan,		cpu_any },
+#ifdef SIMD_X86
+    { "SSE2",	R_DrawColumnSSE2,	R_DrawSpanSSE2,		cpu_sse2 },
+    { "AVX2",	R_DrawColumnAVX2,	R_DrawSpanAVX2,		cpu_avx2 },
+#endif
+    { NULL }
+};
+
+
+benchcolumn_t	columns[NUMCOLUMNS];
+benchspan_t	spans[NUMSPANS];
+
+// 16 textures of 128 texel columns, 16 flats, 32 light levels,
+//  behind a few bytes of slack like a lump in its zone block
+#define SLACK			4
+
+byte		texelbuf[SLACK+16*128];
+byte		flatbuf[SLACK+16*64*64];
+byte		lightbuf[SLACK+32*256];
+
+#define texels			(texelbuf+SLACK)
+#define flats			(flatbuf+SLACK)
+#define lights			(lightbuf+SLACK)
+
+// screens[0] and screens[1], see V_Init
+byte*		screen;
+byte*		reference;
+
+
+static double BenchSeconds (void)
+{
+    struct timespec	ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+
+static int BenchSupported (cpufeature_t cpu)
+{
+#ifdef SIMD_X86
+    __builtin_cpu_init ();
+
+    switch (cpu)
+    {
+      case cpu_sse2:
+	return __builtin_cpu_supports ("sse2");
+      case cpu_avx2:
+	return __builtin_cpu_supports ("avx2");
+      default:
+	break;
+    }
+#endif
+    return 1;
+}
+
+
+//
+// BenchSetup
+// Random textures and draws, the same on every run.
+//
+static void BenchSetup (void)
+{
+    int		i;
+    int		a;
+    int		b;
+
+    srand (1993);
+
+    for (i=0 ; i<sizeof(texelbuf) ; i++)
+	texelbuf[i] = rand();
+    for (i=0 ; i<sizeof(flatbuf) ; i++)
+	flatbuf[i] = rand();
+    for (i=0 ; i<sizeof(lightbuf) ; i++)
+	lightbuf[i] = rand();
+
+    for (i=0 ; i<NUMCOLUMNS ; i++)
+    {
+	a = rand() % BENCHHEIGHT;
+	b = rand() % BENCHHEIGHT;
+	columns[i].x = rand() % BENCHWIDTH;
+	columns[i].yl = a < b ? a : b;
+	columns[i].yh = a < b ? b : a;
+	columns[i].iscale = 0x1000 + rand() % (4*FRACUNIT);
+	columns[i].texturemid = rand() % (256*FRACUNIT) - 128*FRACUNIT;
+	columns[i].source = rand() % 16;
+	columns[i].light = rand() % 32;
+    }
+
+    for (i=0 ; i<NUMSPANS ; i++)
+    {
+	a = rand() % BENCHWIDTH;
+	b = rand() % BENCHWIDTH;
+	spans[i].y = rand() % BENCHHEIGHT;
+	spans[i].x1 = a < b ? a : b;
+	spans[i].x2 = a < b ? b : a;
+	spans[i].xfrac = rand() * 2;
+	spans[i].yfrac = rand() * 2;
+	spans[i].xstep = rand() % (4*FRACUNIT) - 2*FRACUNIT;
+	spans[i].ystep = rand() % (4*FRACUNIT) - 2*FRACUNIT;
+	spans[i].flat = rand() % 16;
+	spans[i].light = rand() % 32;
+    }
+}
+
+
+//
+// BenchColumns
+// Returns the pixels drawn.
+//
+static double BenchColumns (drawer_t* d)
+{
+    int		i;
+    double	pixels;
+
+    pixels = 0;
+
+    for (i=0 ; i<NUMCOLUMNS ; i++)
+    {
+	dc_x = columns[i].x;
+	dc_yl = columns[i].yl;
+	dc_yh = columns[i].yh;
+	dc_iscale = columns[i].iscale;
+	dc_texturemid = columns[i].texturemid;
+	dc_source = texels + columns[i].source*128;
+	dc_colormap = lights + columns[i].light*256;
+	d->column ();
+	pixels += dc_yh - dc_yl + 1;
+    }
+
+    return pixels;
+}
+
+
+//
+// BenchSpans
+//
+static double BenchSpans (drawer_t* d)
+{
+    int		i;
+    double	pixels;
+
+    pixels = 0;
+
+    for (i=0 ; i<NUMSPANS ; i++)
+    {
+	ds_y = spans[i].y;
+	ds_x1 = spans[i].x1;
+	ds_x2 = spans[i].x2;
+	ds_xfrac = spans[i].xfrac;
+	ds_yfrac = spans[i].yfrac;
+	ds_xstep = spans[i].xstep;
+	ds_ystep = spans[i].ystep;
+	ds_source = flats + spans[i].flat*64*64;
+	ds_colormap = lights + spans[i].light*256;
+	d->span ();
+	pixels += ds_x2 - ds_x1 + 1;
+    }
+
+    return pixels;
+}
+
+
+//
+// BenchTime
+// Nanoseconds per pixel.
+//
+static double
+BenchTime
+( double	(*run) (drawer_t* d),
+  drawer_t*	d,
+  int		repeat )
+{
+    double	start;
+    double	pixels;
+    int		r;
+
+    start = BenchSeconds ();
+    pixels = 0;
+    for (r=0 ; r<repeat ; r++)
+	pixels += run (d);
+
+    return (BenchSeconds () - start)*1e9/pixels;
+}
+
+
+//
+// BenchCheck
+// Draws everything once and compares with the
+//  row major C drawers.
+// Returns false on a mismatch.
+//
+static boolean
+BenchCheck
+( drawer_t*	d,
+  boolean	spans )
+{
+    memset (screen, 0, screenwidth*screenheight);
+    if (colmajor)
+	memset (viewbuffer, 0, screenwidth*screenheight);
+
+    // C spans stand in for the row only vector ones
+    BenchColumns (d);
+    BenchSpans (spans ? d : drawers);
+
+    R_TransposeView ();
+
+    if (d == drawers && !colmajor)
+    {
+	memcpy (reference, screen, screenwidth*screenheight);
+	return true;
+    }
+
+    return !memcmp (screen, reference, screenwidth*screenheight);
+}
+
+
+//
+// BenchLayout
+// Times every drawer in the current layout.
+//
+static boolean BenchLayout (int repeat)
+{
+    drawer_t*	d;
+    boolean	spans;
+    boolean	ok;
+    double	columntime;
+    double	spantime;
+    double	transposetime;
+    double	start;
+    int		r;
+
+    ok = true;
+
+    printf ("%s major:\n", colmajor ? "column" : "row");
+
+    for (d = drawers ; d->name ; d++)
+    {
+	if (!BenchSupported (d->cpu))
+	{
+	    printf ("  %-6s not supported by this CPU\n", d->name);
+	    continue;
+	}
+
+	// the vector span drawers store whole rows
+	spans = !colmajor || d->cpu == cpu_any;
+
+	if (!BenchCheck (d, spans))
+	    ok = false;
+
+	columntime = BenchTime (BenchColumns, d, repeat);
+	spantime = spans ? BenchTime (BenchSpans, d, repeat) : 0;
+
+	printf ("  %-6s columns %7.3f ns/pixel  spans ", d->name, columntime);
+	if (spans)
+	    printf ("%7.3f ns/pixel", spantime);
+	else
+	    printf ("    n/a        ");
+	printf ("  %s\n", BenchCheck (d, spans) ? "ok" : "MISMATCH");
+    }
+
+    if (colmajor)
+    {
+	start = BenchSeconds ();
+	for (r=0 ; r<repeat ; r++)
+	    R_TransposeView ();
+	transposetime = BenchSeconds () - start;
+
+	printf ("  transpose %7.3f us/frame\n", transposetime*1e6/repeat);
+    }
+
+    return ok;
+}
+
+
+int
+main
+( int		argc,
+  char**	argv )
+{
+    int		repeat;
+    int		p;
+    boolean	ok;
+
+    myargc = argc;
+    myargv = argv;
+
+    repeat = 50;
+    p = M_CheckParm ("-repeat");
+    if (p && p < myargc-1)
+	repeat = atoi (myargv[p+1]);
+
+    // -width and -height
+    V_Init ();
+    screen = screens[0];
+    reference = screens[1];
+    ylookup = malloc (screenheight*sizeof(*ylookup));
+    columnofs = malloc (screenwidth*sizeof(*columnofs));
+
+    printf ("%ix%i\n", screenwidth, screenheight);
+
+    BenchSetup ();
+
+    // row major first, it makes the reference image
+    viewheight = BENCHHEIGHT;
+    scaledviewwidth = BENCHWIDTH;
+    centery = viewheight/2;
+
+    colmajor = false;
+    R_InitBuffer (BENCHWIDTH, BENCHHEIGHT);
+    transposefunc = R_TransposeBlock;
+#ifdef SIMD_X86
+    if (BenchSupported (cpu_sse2))
+	transposefunc = R_TransposeBlockSSE2;
+#endif
+    ok = BenchLayout (repeat);
+
+    colmajor = true;
+    viewbuffer = malloc (screenwidth*screenheight);
+    R_InitBuffer (BENCHWIDTH, BENCHHEIGHT);
+    if (!BenchLayout (repeat))
+	ok = false;
+
+    return !ok;
+}
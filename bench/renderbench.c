@@ -0,0 +1,433 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Headless renderer benchmark.
+//	Loads the wads, sets up one map, and renders a fixed list
+//	 of views with R_RenderPlayerView, no game tics, no video
+//	 and no sound. Prints ms/frame percentiles and a CRC of
+//	 screens[0] for every view, so both speed and output can
+//	 be compared between builds.
+//	Build with "make bench-render", run as
+//	 renderbench [-file iwad [pwads...]] [-warp [e] m] [-skill s]
+//	  [-views file] [-repeat n] [-width w] [-height h]
+//	  [-rthreads n] [-colmajor]
+//	A views file has one "x y angle [z]" per line, in map units
+//	 and degrees. z is the eye height, from the floor plus
+//	 VIEWHEIGHT if left out. Without one, every player and
+//	 deathmatch start is looked at in four directions.
+//
+//-----------------------------------------------------------------------------
+
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "i_device.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "z_zone.h"
+#include "w_wad.h"
+#include "v_video.h"
+
+#include "d_main.h"
+#include "g_game.h"
+#include "p_setup.h"
+#include "p_local.h"
+#include "st_stuff.h"
+#include "hu_stuff.h"
+
+#include "r_local.h"
+#include "r_sky.h"
+#include "r_strip.h"
+
+
+#define MAXVIEWS		256
+#define MAXWADS			MAXWADFILES
+
+typedef struct
+{
+    fixed_t		x;
+    fixed_t		y;
+    fixed_t		z;	// 0 for the floor plus VIEWHEIGHT
+    angle_t		angle;
+
+} benchview_t;
+
+
+benchview_t	views[MAXVIEWS];
+int		numviews;
+
+// microseconds of every frame of every view
+unsigned*	frametimes;
+
+// in m_menu.c, normally from the config file
+extern int	detailLevel;
+extern int	screenblocks;
+
+void R_ExecuteSetViewSize (void);
+
+
+//
+// BenchCRC
+// CRC-32 of the screen, to see that a change
+//  did not change the output.
+//
+static unsigned BenchCRC (byte* data, int length)
+{
+    static unsigned	table[256];
+    unsigned		crc;
+    int			i;
+    int			j;
+
+    if (!table[1])
+    {
+	for (i=0 ; i<256 ; i++)
+	{
+	    crc = i;
+	    for (j=0 ; j<8 ; j++)
+		crc = crc & 1 ? (crc>>1) ^ 0xedb88320 : crc>>1;
+	    table[i] = crc;
+	}
+    }
+
+    crc = 0xffffffff;
+    for (i=0 ; i<length ; i++)
+	crc = table[(crc ^ data[i]) & 0xff] ^ (crc>>8);
+
+    return ~crc;
+}
+
+
+//
+// BenchAddView
+//
+static void
+BenchAddView
+( int		x,
+  int		y,
+  int		angle,
+  int		z )
+{
+    benchview_t*	v;
+
+    if (numviews == MAXVIEWS)
+	return;
+
+    v = &views[numviews++];
+    v->x = x<<FRACBITS;
+    v->y = y<<FRACBITS;
+    v->z = z<<FRACBITS;
+    v->angle = (angle_t)((long long)angle*ANG45/45);
+}
+
+
+//
+// BenchLoadViews
+// From a file, or from the map starts.
+//
+static void BenchLoadViews (char* filename)
+{
+    FILE*		f;
+    char		line[256];
+    int			x;
+    int			y;
+    int			angle;
+    int			z;
+    int			i;
+    int			a;
+    mapthing_t*		mt;
+
+    if (filename)
+    {
+	f = fopen (filename, "r");
+	if (!f)
+	    I_Error ("BenchLoadViews: couldn't open %s", filename);
+
+	while (fgets (line, sizeof(line), f))
+	{
+	    z = 0;
+	    if (sscanf (line, "%i %i %i %i", &x, &y, &angle, &z) >= 3)
+		BenchAddView (x, y, angle, z);
+	}
+	fclose (f);
+    }
+    else
+    {
+	for (i=0 ; i<MAXPLAYERS ; i++)
+	{
+	    mt = &playerstarts[i];
+	    if (!mt->type)
+		continue;
+	    for (a=0 ; a<360 ; a+=90)
+		BenchAddView (mt->x, mt->y, mt->angle+a, 0);
+	}
+
+	for (mt = deathmatchstarts ; mt < deathmatch_p ; mt++)
+	    for (a=0 ; a<360 ; a+=90)
+		BenchAddView (mt->x, mt->y, mt->angle+a, 0);
+    }
+
+    if (!numviews)
+	I_Error ("BenchLoadViews: no views");
+}
+
+
+//
+// BenchSetView
+// Moves the player to the view, the renderer
+//  only looks at its mobj and viewz.
+//
+static void BenchSetView (benchview_t* v)
+{
+    player_t*	player;
+    mobj_t*	mo;
+    sector_t*	sec;
+
+    player = &players[consoleplayer];
+    mo = player->mo;
+
+    P_UnsetThingPosition (mo);
+    mo->x = v->x;
+    mo->y = v->y;
+    mo->angle = v->angle;
+    P_SetThingPosition (mo);
+
+    sec = mo->subsector->sector;
+    mo->z = sec->floorheight;
+
+    if (v->z)
+	player->viewz = v->z;
+    else
+	player->viewz = sec->floorheight + VIEWHEIGHT;
+
+    if (player->viewz > sec->ceilingheight-4*FRACUNIT)
+	player->viewz = sec->ceilingheight-4*FRACUNIT;
+}
+
+
+static int BenchCompare (const void* a, const void* b)
+{
+    unsigned	ua = *(unsigned *)a;
+    unsigned	ub = *(unsigned *)b;
+
+    return ua < ub ? -1 : ua > ub;
+}
+
+
+//
+// BenchPercentile
+// Of sorted times, in milliseconds.
+//
+static double
+BenchPercentile
+( unsigned*	times,
+  int		count,
+  int		percent )
+{
+    return times[(count-1)*percent/100] / 1000.0;
+}
+
+
+//
+// BenchSetup
+// What G_InitNew and G_DoLoadLevel would do,
+//  without the rest of the game.
+//
+static void
+BenchSetup
+( int		episode,
+  int		map,
+  skill_t	skill )
+{
+    if (W_CheckNumForName ("MAP01") >= 0)
+	gamemode = commercial;
+    else if (W_CheckNumForName ("E4M1") >= 0)
+	gamemode = retail;
+    else if (W_CheckNumForName ("E3M1") >= 0)
+	gamemode = registered;
+    else
+	gamemode = shareware;
+
+    // full view with the status bar
+    screenblocks = 10;
+    detailLevel = 0;
+
+    R_Init ();
+    R_ExecuteSetViewSize ();
+    P_Init ();
+    HU_Init ();
+    ST_Init ();
+
+    if (gamemode == commercial)
+    {
+	episode = 1;
+	skytexture = R_TextureNumForName ("SKY3");
+	if (map < 12)
+	    skytexture = R_TextureNumForName ("SKY1");
+	else if (map < 21)
+	    skytexture = R_TextureNumForName ("SKY2");
+    }
+    else
+    {
+	char	name[5];
+
+	sprintf (name, "SKY%i", episode);
+	skytexture = R_TextureNumForName (name);
+    }
+    skyflatnum = R_FlatNumForName (SKYFLATNAME);
+
+    gameepisode = episode;
+    gamemap = map;
+    gameskill = skill;
+
+    consoleplayer = displayplayer = 0;
+    playeringame[0] = true;
+    players[0].playerstate = PST_REBORN;
+
+    P_SetupLevel (episode, map, 0, skill);
+
+    if (!players[0].mo)
+	I_Error ("BenchSetup: no player 1 start");
+}
+
+
+int
+main
+( int		argc,
+  char**	argv )
+{
+    char*	wads[MAXWADS+1];
+    int		numwads;
+    int		episode;
+    int		map;
+    skill_t	skill;
+    int		repeat;
+    int		p;
+    int		i;
+    int		r;
+    unsigned	start;
+    unsigned*	times;
+    unsigned	crc;
+    char*	viewfile;
+
+    myargc = argc;
+    myargv = argv;
+
+    System_Init ();
+
+    numwads = 0;
+    p = M_CheckParm ("-file");
+    if (p)
+    {
+	while (++p != myargc && myargv[p][0] != '-' && numwads < MAXWADS)
+	    wads[numwads++] = myargv[p];
+    }
+    if (!numwads)
+	wads[numwads++] = "doom.wad";
+    wads[numwads] = NULL;
+
+    episode = 1;
+    map = 1;
+    p = M_CheckParm ("-warp");
+    if (p && p < myargc-1)
+    {
+	if (p < myargc-2 && myargv[p+2][0] != '-')
+	{
+	    episode = atoi (myargv[p+1]);
+	    map = atoi (myargv[p+2]);
+	}
+	else
+	    map = atoi (myargv[p+1]);
+    }
+
+    skill = sk_medium;
+    p = M_CheckParm ("-skill");
+    if (p && p < myargc-1)
+	skill = myargv[p+1][0]-'1';
+
+    repeat = 50;
+    p = M_CheckParm ("-repeat");
+    if (p && p < myargc-1)
+	repeat = atoi (myargv[p+1]);
+    if (repeat < 1)
+	repeat = 1;
+
+    viewfile = NULL;
+    p = M_CheckParm ("-views");
+    if (p && p < myargc-1)
+	viewfile = myargv[p+1];
+
+    // -width and -height
+    V_Init ();
+    Z_Init ();
+    W_InitMultipleFiles (wads);
+
+    BenchSetup (episode, map, skill);
+    BenchLoadViews (viewfile);
+
+    printf ("\n%ix%i, %s major, %i strips, %i views of %i frames\n",
+	    screenwidth, screenheight, colmajor ? "column" : "row",
+	    numstrips, numviews, repeat);
+    printf ("view      x      y angle    p50    p90    max  crc\n");
+
+    frametimes = malloc (numviews*repeat*sizeof(*frametimes));
+
+    for (i=0 ; i<numviews ; i++)
+    {
+	BenchSetView (&views[i]);
+
+	// the first frame caches the textures and
+	//  makes the image, it is not timed
+	memset (screens[0], 0, screenwidth*screenheight);
+	R_RenderPlayerView (&players[consoleplayer]);
+	crc = BenchCRC (screens[0], screenwidth*screenheight);
+
+	times = frametimes + i*repeat;
+	for (r=0 ; r<repeat ; r++)
+	{
+	    start = I_GetTimeUS ();
+	    R_RenderPlayerView (&players[consoleplayer]);
+	    times[r] = I_GetTimeUS () - start;
+	}
+	qsort (times, repeat, sizeof(*times), BenchCompare);
+
+	printf ("%4i %6i %6i %5i %6.2f %6.2f %6.2f  %08x\n", i,
+		views[i].x>>FRACBITS, views[i].y>>FRACBITS,
+		(int)(views[i].angle/(ANG45/45)),
+		BenchPercentile (times, repeat, 50),
+		BenchPercentile (times, repeat, 90),
+		BenchPercentile (times, repeat, 100),
+		crc);
+    }
+
+    qsort (frametimes, numviews*repeat, sizeof(*frametimes), BenchCompare);
+    printf ("all frames: p50 %.2f  p90 %.2f  p99 %.2f  max %.2f ms\n",
+	    BenchPercentile (frametimes, numviews*repeat, 50),
+	    BenchPercentile (frametimes, numviews*repeat, 90),
+	    BenchPercentile (frametimes, numviews*repeat, 99),
+	    BenchPercentile (frametimes, numviews*repeat, 100));
+
+    return 0;
+}
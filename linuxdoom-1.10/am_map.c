@@ -539,9 +539,10 @@ void AM_LevelInit(void)
 {
     leveljuststarted = 0;
 
+    // the real screen above the status bar
     f_x = f_y = 0;
-    f_w = finit_width;
-    f_h = finit_height;
+    f_w = SCALEX(finit_width);
+    f_h = SCALEY(finit_height);
 
     AM_clearMarks();
 
@@ -1315,9 +1316,11 @@ void AM_drawMarks(void)
 	    //      h = SHORT(marknums[i]->height);
 	    w = 5; // because something's wrong with the wad, i guess
 	    h = 6; // because something's wrong with the wad, i guess
-	    fx = CXMTOF(markpoints[i].x);
-	    fy = CYMTOF(markpoints[i].y);
-	    if (fx >= f_x && fx <= f_w - w && fy >= f_y && fy <= f_h - h)
+	    // the patches go on the 320x200 screen
+	    fx = CXMTOF(markpoints[i].x)*SCREENWIDTH/screenwidth;
+	    fy = CYMTOF(markpoints[i].y)*SCREENHEIGHT/screenheight;
+	    if (fx >= f_x && fx <= finit_width - w
+		&& fy >= f_y && fy <= finit_height - h)
 		V_DrawPatch(fx, fy, FB, marknums[i]);
 	}
     }
@@ -1345,6 +1348,6 @@ void AM_Drawer (void)
 
     AM_drawMarks();
 
-    V_MarkRect(f_x, f_y, f_w, f_h);
+    V_MarkRect(f_x, f_y, finit_width, finit_height);
 
 }
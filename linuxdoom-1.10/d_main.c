@@ -50,6 +50,7 @@ rcsid[] = "$Id: d_main.c,v 1.8 1997/02/03 22:45:09 b1 Exp $";
 
 
 #include "z_zone.h"
+#include "z_stats.h"
 #include "w_wad.h"
 #include "s_sound.h"
 #include "v_video.h"
@@ -74,6 +75,9 @@ rcsid[] = "$Id: d_main.c,v 1.8 1997/02/03 22:45:09 b1 Exp $";
 
 #include "p_setup.h"
 #include "r_local.h"
+#include "r_interp.h"
+#include "r_stats.h"
+#include "r_cache.h"
 
 
 #include "d_main.h"
@@ -103,6 +107,7 @@ boolean         fastparm;	// checkparm of -fast
 boolean         drone;
 
 boolean		singletics = false; // debug flag to cancel adaptiveness
+boolean		uncapped;	// checkparm of -uncapped
 
 
 
@@ -201,6 +206,8 @@ void D_Display (void)
     static  boolean		fullscreen = false;
     static  gamestate_t		oldgamestate = -1;
     static  int			borderdrawcount;
+    static  lumphandle_t	playpal = LUMPHANDLE("PLAYPAL");
+    static  lumphandle_t	pausepic = LUMPHANDLE("M_PAUSE");
     int				nowtime;
     int				tics;
     int				wipestart;
@@ -212,6 +219,12 @@ void D_Display (void)
     if (nodrawers)
 	return;                    // for comparative timing / profiling
 		
+    // what this frame draws is purged last
+    Z_CacheFrame ();
+
+    // lumps read ahead since the last frame
+    W_UpdatePrefetch ();
+
     redrawsbar = false;
     
     // change the view size if needed
@@ -226,7 +239,7 @@ void D_Display (void)
     if (gamestate != wipegamestate)
     {
 	wipe = true;
-	wipe_StartScreen(0, 0, SCREENWIDTH, SCREENHEIGHT);
+	wipe_StartScreen(0, 0, screenwidth, screenheight);
     }
     else
 	wipe = false;
@@ -242,12 +255,14 @@ void D_Display (void)
 	    break;
 	if (automapactive)
 	    AM_Drawer ();
-	if (wipe || (viewheight != 200 && fullscreen) )
+	if (wipe || (viewheight != screenheight && fullscreen) )
 	    redrawsbar = true;
 	if (inhelpscreensstate && !inhelpscreens)
 	    redrawsbar = true;              // just put away the help screen
-	ST_Drawer (viewheight == 200, redrawsbar );
-	fullscreen = viewheight == 200;
+	R_StartTimer (rt_hud);
+	ST_Drawer (viewheight == screenheight, redrawsbar );
+	R_StopTimer (rt_hud);
+	fullscreen = viewheight == screenheight;
 	break;
 
       case GS_INTERMISSION:
@@ -271,11 +286,15 @@ void D_Display (void)
 	R_RenderPlayerView (&players[displayplayer]);
 
     if (gamestate == GS_LEVEL && gametic)
+    {
+	R_StartTimer (rt_hud);
 	HU_Drawer ();
+	R_StopTimer (rt_hud);
+    }
     
     // clean up border stuff
     if (gamestate != oldgamestate && gamestate != GS_LEVEL)
-	I_SetPalette (W_CacheLumpName ("PLAYPAL",PU_CACHE));
+	I_SetPalette (W_CacheLumpHandle (&playpal,PU_CACHE));
 
     // see if the border needs to be initially drawn
     if (gamestate == GS_LEVEL && oldgamestate != GS_LEVEL)
@@ -285,7 +304,7 @@ void D_Display (void)
     }
 
     // see if the border needs to be updated to the screen
-    if (gamestate == GS_LEVEL && !automapactive && scaledviewwidth != 320)
+    if (gamestate == GS_LEVEL && !automapactive && scaledviewwidth != screenwidth)
     {
 	if (menuactive || menuactivestate || !viewactivestate)
 	    borderdrawcount = 3;
@@ -308,9 +327,9 @@ void D_Display (void)
 	if (automapactive)
 	    y = 4;
 	else
-	    y = viewwindowy+4;
-	V_DrawPatchDirect(viewwindowx+(scaledviewwidth-68)/2,
-			  y,0,W_CacheLumpName ("M_PAUSE", PU_CACHE));
+	    y = viewwindowy*SCREENHEIGHT/screenheight+4;
+	V_DrawPatchDirect((viewwindowx+scaledviewwidth/2)*SCREENWIDTH/screenwidth-34,
+			  y,0,W_CacheLumpHandle (&pausepic, PU_CACHE));
     }
 
 
@@ -319,15 +338,21 @@ void D_Display (void)
     NetUpdate ();         // send out any new accumulation
 
 
+    // renderer timing, over everything but the wipe
+    R_DrawStats ();
+
     // normal update
     if (!wipe)
     {
+	R_StartTimer (rt_blit);
 	I_FinishUpdate ();              // page flip or blit buffer
+	R_StopTimer (rt_blit);
+	R_FinishStats ();
 	return;
     }
     
     // wipe update
-    wipe_EndScreen(0, 0, SCREENWIDTH, SCREENHEIGHT);
+    wipe_EndScreen(0, 0, screenwidth, screenheight);
 
     wipestart = I_GetTime () - 1;
 
@@ -340,12 +365,14 @@ void D_Display (void)
 	} while (!tics);
 	wipestart = nowtime;
 	done = wipe_ScreenWipe(wipe_Melt
-			       , 0, 0, SCREENWIDTH, SCREENHEIGHT, tics);
+			       , 0, 0, screenwidth, screenheight, tics);
 	I_UpdateNoBlit ();
 	M_Drawer ();                            // menu is drawn even on top of wipes
 	I_FinishUpdate ();                      // page flip or blit buffer
 	I_StartFrame ();                        // must start a new frame
     } while (!done);
+
+    R_FinishStats ();
 }
 
 
@@ -390,8 +417,14 @@ void D_DoomLoop (void)
 	}
 	else
 	{
-	    TryRunTics (); // will run at least one tic
+	    TryRunTics (); // will run at least one tic, unless uncapped
 	}
+
+	// draw between the last two tics
+	if (uncapped && !singletics)
+	    interpfrac = I_GetTimeFrac ();
+	else
+	    interpfrac = FRACUNIT;
 		
 	S_UpdateSounds (players[consoleplayer].mo);// move positional sounds
 
@@ -808,6 +841,58 @@ void FindResponseFile (void)
 }
 
 
+//
+// STARTUP TIMES
+// -timestartup prints how long each stage of
+//  D_DoomMain took, once they are all done.
+//
+#define MAXSTARTUPSTAGES	16
+
+static char*		stagenames[MAXSTARTUPSTAGES];
+static unsigned		stagetimes[MAXSTARTUPSTAGES];
+static int		numstages;
+static unsigned		stagestart;
+static unsigned		startupstart;
+
+
+//
+// D_StartupStage
+// Ends the stage that started with the one before.
+//
+static void D_StartupStage (char* name)
+{
+    unsigned	now;
+
+    now = I_GetTimeUS ();
+
+    if (numstages < MAXSTARTUPSTAGES)
+    {
+	stagenames[numstages] = name;
+	stagetimes[numstages] = now - stagestart;
+	numstages++;
+    }
+
+    stagestart = now;
+}
+
+
+//
+// D_StartupTimes
+//
+static void D_StartupTimes (void)
+{
+    int		i;
+
+    if (!M_CheckParm ("-timestartup"))
+	return;
+
+    printf ("\nstartup         time ms\n");
+    for (i=0 ; i<numstages ; i++)
+	printf ("%-14s %8.1f\n", stagenames[i], stagetimes[i]/1000.0);
+    printf ("total          %8.1f\n", (stagestart - startupstart)/1000.0);
+}
+
+
 //
 // D_DoomMain
 //
@@ -827,6 +912,7 @@ void D_DoomMain (void)
     respawnparm = M_CheckParm ("-respawn");
     fastparm = M_CheckParm ("-fast");
     devparm = M_CheckParm ("-devparm");
+    uncapped = M_CheckParm ("-uncapped");
     if (M_CheckParm ("-altdeath"))
 	deathmatch = 2;
     else if (M_CheckParm ("-deathmatch"))
@@ -1026,17 +1112,24 @@ void D_DoomMain (void)
     }
     
     // init subsystems
+    startupstart = stagestart = I_GetTimeUS ();
+
     printf ("V_Init: allocate screens.\n");
     V_Init ();
+    D_StartupStage ("V_Init");
 
     printf ("M_LoadDefaults: Load system defaults.\n");
     M_LoadDefaults ();              // load before initing other systems
+    D_StartupStage ("M_LoadDefaults");
 
     printf ("Z_Init: Init zone memory allocation daemon. \n");
     Z_Init ();
+    Z_InitStats ();
+    D_StartupStage ("Z_Init");
 
     printf ("W_Init: Init WADfiles.\n");
     W_InitMultipleFiles (wadfiles);
+    D_StartupStage ("W_Init");
     
 
     // Check for -file in shareware
@@ -1105,30 +1198,44 @@ void D_DoomMain (void)
 	// Ouch.
 	break;
     }
+    D_StartupStage ("check wads");
 
     printf ("M_Init: Init miscellaneous info.\n");
     M_Init ();
+    D_StartupStage ("M_Init");
 
     printf ("R_Init: Init DOOM refresh daemon - ");
     R_Init ();
+    D_StartupStage ("R_Init");
 
     printf ("\nP_Init: Init Playloop state.\n");
     P_Init ();
+    D_StartupStage ("P_Init");
+
+    // what R_Init and P_Init worked out from the wads
+    R_SaveCache ();
+    D_StartupStage ("R_SaveCache");
 
     printf ("I_Init: Setting up machine state.\n");
     I_Init ();
+    D_StartupStage ("I_Init");
 
     printf ("D_CheckNetGame: Checking network game status.\n");
     D_CheckNetGame ();
+    D_StartupStage ("D_CheckNetGame");
 
     printf ("S_Init: Setting up sound.\n");
     S_Init (sfxVolume * 8 + (sfxVolume >> 1), musicVolume * 8 + (musicVolume >> 1) );
+    D_StartupStage ("S_Init");
 
     printf ("HU_Init: Setting up heads up display.\n");
     HU_Init ();
+    D_StartupStage ("HU_Init");
 
     printf ("ST_Init: Init status bar.\n");
     ST_Init ();
+    D_StartupStage ("ST_Init");
+    D_StartupTimes ();
 
     // check for a driver that wants intermission stats
     p = M_CheckParm ("-statcopy");
@@ -675,7 +675,13 @@ void TryRunTics (void)
 	counts = availabletics;
     
     if (counts < 1)
+    {
+	// uncapped frames are drawn between tics,
+	//  don't wait for the next one
+	if (uncapped && availabletics < 1)
+	    return;
 	counts = 1;
+    }
 		
     frameon++;
 
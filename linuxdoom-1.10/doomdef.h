@@ -94,6 +94,10 @@ typedef enum
 // Defines suck. C sucks.
 // C++ might sucks for OOP, but it sure is a better C.
 // So there.
+// This is the 320x200 screen the graphics are laid
+//  out on. The real screen is screenwidth by
+//  screenheight, see V_Init, and everything drawn
+//  through v_video.c is scaled up to it.
 #define SCREENWIDTH  320
 //SCREEN_MUL*BASE_WIDTH //320
 #define SCREENHEIGHT 200
@@ -257,6 +257,9 @@ extern  int             mouseSensitivity;
 // debug flag to cancel adaptiveness
 extern  boolean         singletics;	
 
+// draw frames between tics, -uncapped
+extern  boolean         uncapped;
+
 extern  int             bodyqueslot;
 
 
@@ -138,6 +138,10 @@ wipe_exitColorXForm
 
 static int*	y;
 
+// Rows the melt moves for each one of the 320x200 screen,
+//  so it looks and lasts the same at any resolution.
+static int	meltscale;
+
 int
 wipe_initMelt
 ( int	width,
@@ -154,18 +158,32 @@ wipe_initMelt
     wipe_shittyColMajorXform((short*)wipe_scr_start, width/2, height);
     wipe_shittyColMajorXform((short*)wipe_scr_end, width/2, height);
     
+    meltscale = height/SCREENHEIGHT;
+    if (meltscale < 1)
+	meltscale = 1;
+
     // setup initial column positions
     // (y<0 => not ready to scroll yet)
+    // Columns that are one column of the 320x200
+    //  screen start together.
     y = (int *) Z_Malloc(width*sizeof(int), PU_STATIC, 0);
     y[0] = -(M_Random()%16);
     for (i=1;i<width;i++)
     {
+	if (i*SCREENWIDTH/width == (i-1)*SCREENWIDTH/width)
+	{
+	    y[i] = y[i-1];
+	    continue;
+	}
 	r = (M_Random()%3) - 1;
 	y[i] = y[i-1] + r;
 	if (y[i] > 0) y[i] = 0;
 	else if (y[i] == -16) y[i] = -15;
     }
 
+    for (i=0;i<width;i++)
+	y[i] *= meltscale;
+
     return 0;
 }
 
@@ -192,11 +210,11 @@ wipe_doMelt
 	{
 	    if (y[i]<0)
 	    {
-		y[i]++; done = false;
+		y[i] += meltscale; done = false;
 	    }
 	    else if (y[i] < height)
 	    {
-		dy = (y[i] < 16) ? y[i]+1 : 8;
+		dy = (y[i] < 16*meltscale) ? y[i]+meltscale : 8*meltscale;
 		if (y[i]+dy >= height) dy = height - y[i];
 		s = &((short *)wipe_scr_end)[i*height+y[i]];
 		d = &((short *)wipe_scr)[y[i]*width+i];
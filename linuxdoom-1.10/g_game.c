@@ -31,6 +31,7 @@ rcsid[] = "$Id: g_game.c,v 1.8 1997/02/03 22:45:09 b1 Exp $";
 #include "doomstat.h"
 
 #include "z_zone.h"
+#include "z_stats.h"
 #include "f_finale.h"
 #include "m_argv.h"
 #include "m_misc.h"
@@ -48,6 +49,7 @@ rcsid[] = "$Id: g_game.c,v 1.8 1997/02/03 22:45:09 b1 Exp $";
 #include "hu_stuff.h"
 #include "st_stuff.h"
 #include "am_map.h"
+#include "r_interp.h"
 
 // Needs access to LFB.
 #include "v_video.h"
@@ -616,6 +618,8 @@ void G_Ticker (void)
     int		i;
     int		buf; 
     ticcmd_t*	cmd;
+
+    Z_StatsTicker ();
     
     // do player reborns if needed
     for (i=0 ; i<MAXPLAYERS ; i++) 
@@ -1031,6 +1035,9 @@ void G_DoCompleted (void)
     int             i; 
 	 
     gameaction = ga_nothing; 
+
+    // before the intermission frees and caches
+    Z_LevelStats ();
  
     for (i=0 ; i<MAXPLAYERS ; i++) 
 	if (playeringame[i]) 
@@ -1249,6 +1256,8 @@ void G_DoLoadGame (void)
  
     if (*save_p != 0x1d) 
 	I_Error ("Bad savegame");
+
+    R_SnapInterpolation ();
     
     // done 
     Z_Free (savebuffer); 
@@ -1619,8 +1628,9 @@ void G_DoPlayDemo (void)
 	netdemo = true; 
     }
 
-    // don't spend a lot of time in loadlevel 
-    precache = false;
+    // don't spend a lot of time in loadlevel,
+    //  unless the lumps are read in the background
+    precache = prefetch;
     G_InitNew (skill, episode, map); 
     precache = true; 
 
@@ -144,6 +144,7 @@ void HUlib_eraseTextLine(hu_textline_t* l)
 {
     int			lh;
     int			y;
+    int			yh;
     int			yoffset;
     //static boolean	lastautomapactive = true; // FIX: unused
 
@@ -154,15 +155,18 @@ void HUlib_eraseTextLine(hu_textline_t* l)
     if (!automapactive &&
 	viewwindowx && l->needsupdate)
     {
+	// the text is on the 320x200 screen, the view on the real one
 	lh = SHORT(l->f[0]->height) + 1;
-	for (y=l->y,yoffset=y*SCREENWIDTH ; y<l->y+lh ; y++,yoffset+=SCREENWIDTH)
+	yh = SCALEY(l->y+lh);
+	for (y=SCALEY(l->y),yoffset=y*screenwidth ; y<yh ; y++,yoffset+=screenwidth)
 	{
 	    if (y < viewwindowy || y >= viewwindowy + viewheight)
-		R_VideoErase(yoffset, SCREENWIDTH); // erase entire line
+		R_VideoErase(yoffset, screenwidth); // erase entire line
 	    else
 	    {
 		R_VideoErase(yoffset, viewwindowx); // erase left border
-		R_VideoErase(yoffset + viewwindowx + viewwidth, viewwindowx);
+		R_VideoErase(yoffset + viewwindowx + scaledviewwidth,
+			     screenwidth - viewwindowx - scaledviewwidth);
 		// erase right border
 	    }
 	}
@@ -0,0 +1,564 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Music rendered to PCM once, and kept on disk.
+//	The first time a MUS lump plays it is synthesized live,
+//	 while a second OPL3 emulator renders all of it on the
+//	 job thread, a slice each frame, into a file keyed by
+//	 hashes of the lump and the GENMIDI instruments. After
+//	 that the song is mapped and streamed from the file,
+//	 which costs the music thread little more than a copy.
+//	A song is about 10 MB a minute at 44.1 kHz, the cache
+//	 is off unless snd_musiccache is set.
+//
+//-----------------------------------------------------------------------------
+
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef NORMALUNIX
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "i_system.h"
+#include "i_thread.h"
+#include "m_argv.h"
+
+#include "musdriver.h"
+
+#ifdef __GNUG__
+#pragma implementation "i_muscache.h"
+#endif
+#include "i_muscache.h"
+
+
+// Bump when the driver or the emulator sound different.
+#define MUSCACHEVERSION	1
+
+// Stereo.
+#define MUSCHANNELS	2
+
+// Frames the driver renders at a time, less than
+//  a tick of the 140 Hz score.
+#define MUSCHUNK	256
+
+// Of the song rendered each time the job runs, the
+//  lump reads queued behind it wait no longer.
+#define MUSSLICEMS	250
+
+// Longer than any song, one that never ends plays live.
+#define MUSMAXSECONDS	1200
+
+#define MAXCACHEDSONGS	64
+
+typedef struct
+{
+    char		identification[8];	// "DOOMPCM"
+    int			version;
+    int			headersize;	// sizeof(muscacheheader_t)
+    unsigned long long	songkey;
+    unsigned long long	bankkey;
+    int			samplerate;
+    int			frames;
+    int			loopstart;
+    int			pad;
+
+} muscacheheader_t;
+
+
+//
+// Songs looked up this run, mapped, or
+//  ones that could not be rendered.
+//
+typedef struct
+{
+    unsigned long long	key;
+    muspcm_t		pcm;
+    void*		base;		// NULL if the song plays live
+    int			length;
+
+} cachedsong_t;
+
+
+// The cache directory, and the name of a song in it.
+#define MUSDIRLENGTH	1024
+#define MUSNAMELENGTH	(MUSDIRLENGTH+48)
+
+//
+// The song being rendered, one at a time.
+//
+typedef struct
+{
+    job_t		job;		// first, the job is the render
+    unsigned long long	key;
+    byte*		song;		// malloced, NULL if idle
+    mus_driver_t	driver;
+    int16_t*		chunk;
+    FILE*		file;
+    char		tempname[MUSNAMELENGTH+4];
+    int			frames;
+    boolean		finished;
+    boolean		failed;
+
+} musrender_t;
+
+
+int			snd_musiccache;
+
+static char		cachedir[MUSDIRLENGTH];
+static boolean		usecache;
+
+static unsigned long long	bankkey;
+static int		musrate;
+
+static cachedsong_t	cachedsongs[MAXCACHEDSONGS];
+static int		numcachedsongs;
+
+static musrender_t	render;
+
+
+
+//
+// I_MusicKey
+// FNV-1a of a lump.
+//
+static unsigned long long
+I_MusicKey
+( byte*		data,
+  int		length )
+{
+    unsigned long long	key;
+    int			i;
+
+    key = 0xcbf29ce484222325ULL;
+    for (i=0 ; i<length ; i++)
+	key = (key ^ data[i]) * 0x100000001b3ULL;
+
+    return key;
+}
+
+
+//
+// I_MusicLength
+// From the MUS header, the score follows the
+//  header and instrument list. 0 if not MUS.
+//
+static int I_MusicLength (byte* data, int lumplength)
+{
+    if (lumplength < 8 || memcmp (data, "MUS\x1a", 4))
+	return 0;
+
+    return (data[4] | (data[5]<<8)) + (data[6] | (data[7]<<8));
+}
+
+
+static void I_MusicFileName (char* name, unsigned long long key)
+{
+    snprintf (name, MUSNAMELENGTH, "%s/%016llx-%016llx.pcm",
+	      cachedir, key, bankkey);
+}
+
+
+//
+// I_AddCachedSong
+//
+static cachedsong_t* I_AddCachedSong (unsigned long long key)
+{
+    cachedsong_t*	song;
+
+    if (numcachedsongs == MAXCACHEDSONGS)
+	return NULL;
+
+    song = &cachedsongs[numcachedsongs++];
+    memset (song, 0, sizeof(*song));
+    song->key = key;
+
+    return song;
+}
+
+
+//
+// I_MapSong
+// The song from its file, NULL if there is none,
+//  or it was made for other instruments or rate.
+//
+static muspcm_t* I_MapSong (unsigned long long key)
+{
+#ifdef NORMALUNIX
+    muscacheheader_t*	header;
+    cachedsong_t*	song;
+    struct stat		st;
+    char		name[MUSNAMELENGTH];
+    void*		base;
+    int			handle;
+
+    I_MusicFileName (name, key);
+
+    handle = open (name, O_RDONLY);
+    if (handle == -1)
+	return NULL;
+
+    if (fstat (handle, &st) == -1
+	|| st.st_size < sizeof(muscacheheader_t))
+    {
+	close (handle);
+	return NULL;
+    }
+
+    base = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
+    close (handle);
+
+    if (base == MAP_FAILED)
+	return NULL;
+
+    header = base;
+    if (memcmp (header->identification, "DOOMPCM", 8)
+	|| header->version != MUSCACHEVERSION
+	|| header->headersize != sizeof(muscacheheader_t)
+	|| header->songkey != key
+	|| header->bankkey != bankkey
+	|| header->samplerate != musrate
+	|| header->frames <= 0
+	|| header->loopstart < 0
+	|| header->loopstart >= header->frames
+	|| st.st_size != sizeof(muscacheheader_t)
+	   + (off_t)header->frames*MUSCHANNELS*sizeof(int16_t))
+    {
+	munmap (base, st.st_size);
+	return NULL;
+    }
+
+    song = I_AddCachedSong (key);
+    if (!song)
+    {
+	munmap (base, st.st_size);
+	return NULL;
+    }
+
+    // read by the music thread, a little ahead of the mixer
+    madvise (base, st.st_size, MADV_SEQUENTIAL);
+
+    song->base = base;
+    song->length = st.st_size;
+    song->pcm.data = (int16_t *)(header+1);
+    song->pcm.frames = header->frames;
+    song->pcm.loopstart = header->loopstart;
+
+    return &song->pcm;
+#else
+    return NULL;
+#endif
+}
+
+
+
+//
+// I_RenderJob
+// A slice of the song into the file, from the start
+//  to where the score ends, without looping.
+// On the job thread.
+//
+static void I_RenderJob (job_t* job)
+{
+    musrender_t*	r = (musrender_t *)job;
+    int16_t*		end;
+    int			frames;
+    int			length;
+
+    for (frames=0 ; frames<musrate*MUSSLICEMS/1000 ; frames+=MUSCHUNK)
+    {
+	// at the volume the mixer scales from
+	if (!musdriver_generate (&r->driver, r->chunk, MUSCHUNK, 1.0f))
+	{
+	    r->failed = true;
+	    return;
+	}
+
+	// the silence after the score would be a
+	//  gap where a looping song comes round
+	length = MUSCHUNK;
+	if (!r->driver.playing)
+	{
+	    for (end = r->chunk + length*MUSCHANNELS ;
+		 length && !end[-1] && !end[-2] ;
+		 end -= MUSCHANNELS)
+	    {
+		length--;
+	    }
+	}
+
+	if (fwrite (r->chunk, MUSCHANNELS*sizeof(int16_t), length,
+		    r->file) != length
+	    || r->frames >= musrate*MUSMAXSECONDS)
+	{
+	    r->failed = true;
+	    return;
+	}
+
+	r->frames += length;
+
+	if (!r->driver.playing)
+	{
+	    r->finished = true;
+	    return;
+	}
+    }
+}
+
+
+//
+// I_StartRender
+//
+static void
+I_StartRender
+( unsigned long long	key,
+  void*			data,
+  int			length )
+{
+    muscacheheader_t	header;
+    char		name[MUSNAMELENGTH];
+
+    I_MusicFileName (name, key);
+    snprintf (render.tempname, sizeof(render.tempname), "%s.new", name);
+
+    render.file = fopen (render.tempname, "wb");
+    if (!render.file)
+    {
+	printf ("I_CacheSong: couldn't write %s\n", render.tempname);
+	return;
+    }
+
+    render.song = malloc (length);
+    if (!render.song)
+	I_Error ("I_CacheSong: out of memory");
+    memcpy (render.song, data, length);
+
+    // the header is written last, with the length
+    memset (&header, 0, sizeof(header));
+    fwrite (&header, sizeof(header), 1, render.file);
+
+    render.key = key;
+    render.frames = 0;
+    render.finished = false;
+    render.failed = false;
+
+    musdriver_start (&render.driver, render.song, 0);
+    I_QueueJob (&render.job);
+}
+
+
+//
+// I_EndRender
+// Writes the file if all of the song is in it,
+//  or drops it. The job is done.
+//
+static void I_EndRender (void)
+{
+    muscacheheader_t	header;
+    char		name[MUSNAMELENGTH];
+    boolean		written;
+
+    if (render.driver.playing)
+	musdriver_stop (&render.driver);
+
+    memset (&header, 0, sizeof(header));
+    memcpy (header.identification, "DOOMPCM", 8);
+    header.version = MUSCACHEVERSION;
+    header.headersize = sizeof(header);
+    header.songkey = render.key;
+    header.bankkey = bankkey;
+    header.samplerate = musrate;
+    header.frames = render.frames;
+    header.loopstart = 0;
+
+    written = render.finished
+	&& render.frames
+	&& !fseek (render.file, 0, SEEK_SET)
+	&& fwrite (&header, sizeof(header), 1, render.file) == 1;
+    if (fclose (render.file))
+	written = false;
+
+    I_MusicFileName (name, render.key);
+    if (!written || rename (render.tempname, name))
+    {
+	remove (render.tempname);
+
+	// plays live from now on
+	I_AddCachedSong (render.key);
+	if (render.finished)
+	    printf ("I_UpdateMusicCache: couldn't write %s\n", name);
+    }
+
+    free (render.song);
+    render.song = NULL;
+}
+
+
+
+//
+// I_InitMusicCache
+//
+void
+I_InitMusicCache
+( byte*		op2,
+  int		op2length,
+  int		samplerate,
+  int		cutoff )
+{
+    void*	oplbuf;
+    int		length;
+    int		p;
+
+    usecache = snd_musiccache;
+
+    p = M_CheckParm ("-musiccache");
+    if (p && p < myargc-1)
+    {
+	length = snprintf (cachedir, sizeof(cachedir), "%s", myargv[p+1]);
+	usecache = true;
+    }
+    else
+	length = snprintf (cachedir, sizeof(cachedir), "%s.music", basedefault);
+
+    if (usecache && length >= sizeof(cachedir))
+    {
+	printf ("I_InitMusicCache: the cache directory name is too long\n");
+	usecache = false;
+    }
+
+#ifdef NORMALUNIX
+    if (usecache && mkdir (cachedir, 0755) == -1 && errno != EEXIST)
+    {
+	printf ("I_InitMusicCache: couldn't make %s\n", cachedir);
+	usecache = false;
+    }
+#else
+    usecache = false;
+#endif
+
+    if (!usecache)
+	return;
+
+    bankkey = I_MusicKey (op2, op2length);
+    musrate = samplerate;
+
+    render.chunk = malloc (MUSCHUNK*MUSCHANNELS*sizeof(int16_t));
+    if (!render.chunk)
+	I_Error ("I_InitMusicCache: out of memory");
+
+    oplbuf = malloc (musdriver_opl_buf_size (samplerate, MUSCHUNK));
+    if (!oplbuf)
+	I_Error ("I_InitMusicCache: out of memory");
+
+    musdriver_init (&render.driver, oplbuf, samplerate, MUSCHUNK, cutoff);
+    // skip "#OPL_II#"
+    musplay_op2bank (&render.driver.player, (char *)op2+8);
+
+    render.job.func = I_RenderJob;
+}
+
+
+//
+// I_CacheSong
+//
+muspcm_t* I_CacheSong (void* data, int lumplength)
+{
+    unsigned long long	key;
+    muspcm_t*		pcm;
+    int			length;
+    int			i;
+
+    if (!usecache || !data)
+	return NULL;
+
+    length = I_MusicLength (data, lumplength);
+    if (!length || length > lumplength)
+	return NULL;
+
+    key = I_MusicKey (data, length);
+
+    for (i=0 ; i<numcachedsongs ; i++)
+    {
+	if (cachedsongs[i].key == key)
+	    return cachedsongs[i].base ? &cachedsongs[i].pcm : NULL;
+    }
+
+    pcm = I_MapSong (key);
+    if (pcm)
+	return pcm;
+
+    // another one is still rendering, this
+    //  one has its turn when it plays again
+    if (!render.song)
+	I_StartRender (key, data, length);
+
+    return NULL;
+}
+
+
+//
+// I_UpdateMusicCache
+//
+void I_UpdateMusicCache (void)
+{
+    if (!render.song || !I_JobDone (&render.job))
+	return;
+
+    if (render.finished || render.failed)
+	I_EndRender ();
+    else
+	I_QueueJob (&render.job);
+}
+
+
+//
+// I_ShutdownMusicCache
+//
+void I_ShutdownMusicCache (void)
+{
+    int		i;
+
+    if (render.song)
+    {
+	// kept if that was the last slice
+	I_FinishJob (&render.job);
+	I_EndRender ();
+    }
+
+#ifdef NORMALUNIX
+    for (i=0 ; i<numcachedsongs ; i++)
+    {
+	if (cachedsongs[i].base)
+	    munmap (cachedsongs[i].base, cachedsongs[i].length);
+    }
+#endif
+    numcachedsongs = 0;
+}
@@ -0,0 +1,86 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// DESCRIPTION:
+//	Music rendered to PCM once, and kept on disk.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __I_MUSCACHE__
+#define __I_MUSCACHE__
+
+
+#ifdef __GNUG__
+#pragma interface
+#endif
+
+
+#include <stdint.h>
+
+#include "doomtype.h"
+
+
+// Set in the config file, or by -musiccache <dir>.
+extern int	snd_musiccache;
+
+//
+// A song as stereo frames at the rate of the mixer,
+//  mapped read only from its file.
+//
+typedef struct
+{
+    int16_t*	data;
+    int		frames;
+    int		loopstart;	// where a looping song goes back to
+
+} muspcm_t;
+
+
+// Keeps the instruments, and makes the directory.
+// op2 is the GENMIDI lump, samplerate and cutoff are
+//  those of the music driver.
+// On the main thread, before I_CacheSong.
+void
+I_InitMusicCache
+( byte*		op2,
+  int		op2length,
+  int		samplerate,
+  int		cutoff );
+
+// The song as PCM if it was rendered before. If not, it
+//  is rendered in the background for the next time it
+//  plays, and NULL returned.
+// data is the MUS lump, length its size. NULL for
+//  anything else too, or if the header says the score
+//  is longer, such a song is only played live.
+// On the main thread, the PCM stays mapped until
+//  I_ShutdownMusicCache.
+muspcm_t* I_CacheSong (void* data, int lumplength);
+
+// Renders the next slice of a song, and writes its
+//  file when it is done. Once a frame.
+void I_UpdateMusicCache (void);
+
+// Drops a render that is not done, and the mapped songs.
+// After the music thread has stopped.
+void I_ShutdownMusicCache (void);
+
+
+#endif
+//-----------------------------------------------------------------------------
+//
+// $Log:$
+//
+//-----------------------------------------------------------------------------
@@ -41,6 +41,8 @@ rcsid[] = "$Id: i_unix.c,v 1.5 1997/02/03 22:45:10 b1 Exp $";
 
 #include "i_system.h"
 #include "i_sound.h"
+#include "i_muscache.h"
+#include "i_thread.h"
 #include "m_argv.h"
 #include "m_misc.h"
 #include "w_wad.h"
@@ -48,21 +50,35 @@ rcsid[] = "$Id: i_unix.c,v 1.5 1997/02/03 22:45:10 b1 Exp $";
 #include "doomdef.h"
 #include "i_device.h"
 
+#include "r_simd.h"
+
 #include "musdriver.h"
 
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
 
 // The number of internal mixing channels,
 //  the samples calculated for each mixing step,
 //  the size of the 16bit, 2 hardware channel (stereo)
 //  mixing buffer, and the samplerate of the raw data.
 
-// Number of mixer channels.
-#define NUM_CHANNELS		8
+// Number of mixer channels, every sound that is playing has one.
+// Only the snd_voices most important ones are heard, the rest
+//  step along silently until they finish or are heard again.
+#define NUM_CHANNELS		64
 // Power of two >= the number of mixer channels (bitmasks)
-#define NUM_CHANNELS_POW2	8
+#define NUM_CHANNELS_POW2	64
 // Number of output channels. 2 for Stereo (OPL3 requires 2)
 #define MIX_CHANNELS		2
 
+// Channels heard at once, from the config file.
+int			snd_voices;
+
+// Milliseconds of music rendered ahead, from the config file.
+int			snd_musicahead;
+
 // Prefer 44100 because it's exactly 4x the sfx recordings
 #define MIX_SAMPLERATE		44100
 
@@ -72,9 +88,15 @@ rcsid[] = "$Id: i_unix.c,v 1.5 1997/02/03 22:45:10 b1 Exp $";
 // 44100 / 140 = 315.0                    [384]
 #define MIX_CHUNK_SIZE		512
 
-// Sfx step shift (rate divider) 0=11025 1=22050 2=44100
-// Must match the MIX_CHUNK_SIZE above
-#define SFX_STEP_SHIFT		2
+// Sound effects are resampled to MIX_SAMPLERATE once, with a
+//  windowed sinc that has SFX_ZEROS zero crossings on each
+//  side, at up to SFX_PHASES positions between two samples.
+#define SFX_ZEROS		8
+#define SFX_PHASES		256
+
+// DMX sound lumps start with the format, the sample rate
+//  and the sample count.
+#define SFX_HEADER		8
 
 // SB Pro used a fixed 12dB/oct LPF @ 3.2kHz (2-pole Butterworth biquad)
 // Tweaking this a little.. things sounded better in the past
@@ -89,13 +111,11 @@ rcsid[] = "$Id: i_unix.c,v 1.5 1997/02/03 22:45:10 b1 Exp $";
 // --------------------------------------------------------------------------
 // MIXER THREAD BEGINS
 
-// All code must LOCK `mix_mutex` to access the data in this zone.
-// XXX move towards queued commands into the mixer.
-
-static mutex_t mix_mutex = {0};
-
-static void* sfx_data[NUMSFX] = {0};
-static int sfx_length[NUMSFX] = {0};
+// The data in this zone belongs to the mixer thread.
+// The game sends it commands through mix_queue, a ring with
+//  one writer and one reader, and the mixer hands back the
+//  handles of sounds that are done in channelfinished.
+// Neither side ever waits for the other.
 
 // Basically, samples from all active internal channels
 //  are modifed and added, and stored in the buffer
@@ -103,52 +123,138 @@ static int sfx_length[NUMSFX] = {0};
 
 static size_t           mix_max_frames = 0;
 
-// The channel step amount...
+// The channel step amount, 1.0 at normal pitch...
 static unsigned int	channelstep[NUM_CHANNELS];
 // ... and a 0.16 bit remainder of last step.
 static unsigned int	channelstepremainder[NUM_CHANNELS];
 
-// The channel data pointers, start and end.
-static unsigned char*	channels[NUM_CHANNELS];
-static unsigned char*	channelsend[NUM_CHANNELS];
-
-// Time/gametic that the channel started playing,
-//  used to determine oldest, which automatically
-//  has lowest priority.
-// In case number of active sounds exceeds
-//  available channels.
-static int		channelstart[NUM_CHANNELS];
+// The channel data pointers, start and end, into
+//  the resampled sound, see sfxcache_t.
+static int16_t*		channels[NUM_CHANNELS];
+static int16_t*		channelsend[NUM_CHANNELS];
 
-// The channel handle, assigned when the sound starts.
+// The channel handle, from the command that started it,
 //  used to stop/modify the sound.
 static unsigned int 	channelhandles[NUM_CHANNELS];
 
-// SFX id of the playing sound effect.
-// Used to catch duplicates (like chainsaw).
-static int		channelids[NUM_CHANNELS];			
+// Handle of the last sound to finish or be stopped
+//  on each channel, written by the mixer only.
+static Atomic_Int	channelfinished[NUM_CHANNELS];
 
 // Pitch to stepping lookup, unused.
 static int		steptable[256];
 
-// Volume lookups.
-static int		vol_lookup[128*256];
+// Volume to the gain of a sample, at most 254, so the
+//  sums of all the channels still fit in 32 bits.
+static int		vol_gain[128];
+
+// Hardware left and right channel gains.
+static int		channelleftgain[NUM_CHANNELS];
+static int		channelrightgain[NUM_CHANNELS];
+
+// Priority of the sfx, lower is more important.
+static int		channelpriority[NUM_CHANNELS];
+
+// Channels mixed, from snd_voices, set before the mixer starts.
+static int		mix_voices;
+
+// Left and right sums of the chunk, 8 bits above the
+//  output, and one pitched channel, mix_max_frames long.
+static int32_t*		mix_accum;
+static int16_t*		mix_voicebuf;
+
+// Adds count samples of mix_voicebuf to mix_accum,
+//  with the left and right gains.
+typedef void (*mixaccumfunc_t) (int32_t* accum, int16_t* src, int count,
+				int leftgain, int rightgain);
+
+static mixaccumfunc_t	mix_accumulate;
+
+// Load, for I_GetMixStats.
+static Atomic_Int	mix_chunkus;
+static Atomic_Int	mix_peakus;
+static Atomic_Int	mix_heard;
+static Atomic_Int	mix_virtual;
+
+// Chunks mixed, the game frees no sound data the
+//  mixer may still read until this has moved on.
+static Atomic_Int	mix_chunks;
+
+
+typedef enum
+{
+    mix_start,
+    mix_stop,
+    mix_params
+
+} mixcmdtype_t;
+
+typedef struct
+{
+    mixcmdtype_t	type;
+    unsigned int	handle;		// slot in the low bits
+    int16_t*		data;		// mix_start only
+    int			length;		// mix_start only
+    int			priority;	// mix_start only
+    int			step;
+    int			leftvol;	// 0-127
+    int			rightvol;
 
-// Hardware left and right channel volume lookup.
-static int*		channelleftvol_lookup[NUM_CHANNELS];
-static int*		channelrightvol_lookup[NUM_CHANNELS];
+} mixcmd_t;
 
-static unsigned int     nexthandle = 0;
+// A frame sends at most a command for each channel,
+//  the mixer reads them all before every chunk.
+// Must hold more than NUM_CHANNELS, see queue_mix.
+#define MIX_QUEUE_SIZE		256
+
+static mixcmd_t		mix_queue[MIX_QUEUE_SIZE];
+
+// Next command to write, moved by the game only, and
+//  next to read, moved by the mixer only.
+// Each side releases its own after the command is
+//  written or read, and acquires the other one.
+static Atomic_Ptr	mix_queue_write = {0};
+static Atomic_Ptr	mix_queue_read = {0};
 
 
 // OPL3 generates a stereo pair for each sample.
 static int16_t*         music_downmix = 0;         // downmix buffer at MIX_SAMPLERATE
 
+// The music thread renders ahead into a ring of
+//  music_ringframes stereo frames, whole chunks of
+//  mix_max_frames, and the mixer copies it out.
+// The music thread moves the write position and the
+//  mixer the read one, released and acquired as in
+//  mix_queue.
+static int16_t*		music_ring;
+static int		music_ringframes;
+static Atomic_Ptr	music_ringwrite = {0};
+static Atomic_Ptr	music_ringread = {0};
+
+// The song the music thread last started, or stopped at,
+//  and where in the ring, so the mixer can drop what is
+//  left of the one before. Released with the song.
+static Atomic_Ptr	music_ringsong = {0};
+static Atomic_Ptr	music_songstart = {0};
+
+static service_t	music_service;
+
+// Set by the music thread while it has something to
+//  play, the ring running dry is only an underrun then.
+static Atomic_Int	music_rendering;
+
+// Chunks the ring ran dry on, and frames it held
+//  at the last chunk, for I_GetMixStats.
+static Atomic_Int	music_underruns;
+static Atomic_Int	music_ahead;
+
 // Derived 0-127 volume used in mixing.
 static Atomic_Int 	music_volume = {127};
 
 // Game has started the music playing.
 static Atomic_Int       music_loop = {0};
 static Atomic_Ptr       music_songptr = {0};
+static Atomic_Ptr       music_songpcm = {0};     // NULL to play it live
 static Atomic_Ptr 	music_finished = {0};
 
 // Game has paused music (network stall?)
@@ -200,11 +306,126 @@ static inline int biquadlp_step(BiquadLP *b, float x) {
     return (int)y;              // quantize the sample
 }
 
+// With no input the state decays into denormals, and can
+//  stay there, which makes each step many times slower.
+// Far below a quantization step, so it is just cleared.
+static inline void biquadlp_flush(BiquadLP *b) {
+    if (fabsf(b->z1) < 1e-10f && fabsf(b->z2) < 1e-10f) {
+        b->z1 = b->z2 = 0.0f;
+    }
+}
+
+//
+// Takes the parameters of a start or params command.
+// On the mixer thread.
+//
+static void mix_set_params( int slot, mixcmd_t* cmd )
+{
+    channelstep[slot] = cmd->step;
+    channelleftgain[slot] = vol_gain[cmd->leftvol];
+    channelrightgain[slot] = vol_gain[cmd->rightvol];
+}
+
+//
+// Runs the commands the game has sent since the last chunk.
+// On the mixer thread.
+//
+static void mix_commands( void )
+{
+    mixcmd_t*	cmd;
+    mixcmd_t*	end;
+    int		slot;
+
+    // only this thread moves the read position
+    cmd = Atomic_Get_Ptr(&mix_queue_read);
+    end = Atomic_Get_Ptr_Acquire(&mix_queue_write);
+
+    while (cmd != end)
+    {
+	slot = cmd->handle & (NUM_CHANNELS_POW2-1);
+
+	switch (cmd->type)
+	{
+	  case mix_start:
+	    // Set pointer to raw data, and to the end of it.
+	    channels[slot] = cmd->data;
+	    channelsend[slot] = cmd->data + cmd->length;
+	    channelstepremainder[slot] = 0;
+	    channelhandles[slot] = cmd->handle;
+	    channelpriority[slot] = cmd->priority;
+	    mix_set_params(slot, cmd);
+	    break;
+
+	  case mix_stop:
+	    if (channels[slot] && channelhandles[slot] == cmd->handle)
+	    {
+		channels[slot] = 0;
+		Atomic_Set_Int(&channelfinished[slot], cmd->handle);
+	    }
+	    break;
+
+	  case mix_params:
+	    if (channels[slot] && channelhandles[slot] == cmd->handle)
+		mix_set_params(slot, cmd);
+	    break;
+	}
+
+	if (++cmd == mix_queue + MIX_QUEUE_SIZE)
+	    cmd = mix_queue;
+    }
+
+    Atomic_Set_Ptr_Release(&mix_queue_read, cmd);
+}
+
+
 static void* mixer_last_song = 0;     // last song ptr we received
 static mus_driver_t music_driver = {0};
 
-// On the music thread, no LOCK held.
-static void mix_music( int mix_frames_needed ) {
+// The song from the music cache, if it has one.
+static muspcm_t* music_pcm = 0;
+static int music_pcmpos;
+static int music_pcmloop;
+
+// Copies a chunk of the song from the music cache into
+//  dest, at the volume the driver would have played it.
+// On the music thread.
+static void mix_pcmmusic( int16_t* dest, int mix_frames_needed, float volume ) {
+	int gain = (int)(volume*256); // rendered at 1.0
+	int frames = mix_frames_needed;
+	int16_t* src;
+	int i, n, s;
+
+	while (frames) {
+		n = music_pcm->frames - music_pcmpos;
+		if (n > frames) {
+			n = frames;
+		}
+		src = music_pcm->data + music_pcmpos*MIX_CHANNELS;
+		for (i=0 ; i<n*MIX_CHANNELS ; i++) {
+			s = (src[i]*gain) >> 8;
+			if (s > 32767) {
+				s = 32767;
+			} else if (s < -32768) {
+				s = -32768;
+			}
+			*dest++ = s;
+		}
+		frames -= n;
+		music_pcmpos += n;
+		if (music_pcmpos == music_pcm->frames) {
+			if (!music_pcmloop) {
+				memset(dest, 0, frames*sizeof(int16_t)*MIX_CHANNELS);
+				return;
+			}
+			music_pcmpos = music_pcm->loopstart;
+		}
+	}
+}
+
+// Renders a chunk of music into dest.
+// Returns 0 if there is nothing to play.
+// On the music thread.
+static int mix_music( int16_t* dest, int mix_frames_needed ) {
 	int musvol = Atomic_Get_Int(&music_volume);
 	void* song = Atomic_Get_Ptr_Acquire(&music_songptr);
 	int loop = Atomic_Get_Int(&music_loop); // after acquire
@@ -213,122 +434,387 @@ static void mix_music( int mix_frames_needed ) {
 		if (music_driver.playing) {
 			musdriver_stop(&music_driver);
 		}
+		music_pcm = 0;
 		if (song) {
-			musdriver_start(&music_driver, song, loop);
+			music_pcm = Atomic_Get_Ptr(&music_songpcm); // after acquire
+			if (music_pcm) {
+				music_pcmpos = 0;
+				music_pcmloop = loop;
+			} else {
+				musdriver_start(&music_driver, song, loop);
+			}
 		}
 		mixer_last_song = song;
+		Atomic_Set_Ptr(&music_songstart, dest);
+		Atomic_Set_Ptr_Release(&music_ringsong, song);
 	}
 
-	int need_mix = musvol && music_driver.playing && !Atomic_Get_Int(&music_paused);
+	int playing = music_pcm ? music_pcmpos < music_pcm->frames : music_driver.playing;
+	int need_mix = musvol && playing && !Atomic_Get_Int(&music_paused);
+	Atomic_Set_Int(&music_rendering, need_mix);
 	if (!need_mix) {
-		memset(music_downmix, 0, mix_frames_needed*sizeof(int16_t)*MIX_CHANNELS);
-		return;
+		return 0;
 	}
 
 	// generate OPL samples, tick the music player
 	float volume = (float)(musvol) * 2.0f / 127.0f;
-	if (!musdriver_generate(&music_driver, music_downmix, mix_frames_needed, volume)) {
-		return; // buffer overflow
+	if (music_pcm) {
+		mix_pcmmusic(dest, mix_frames_needed, volume);
+		playing = music_pcmpos < music_pcm->frames;
+	} else {
+		if (!musdriver_generate(&music_driver, dest, mix_frames_needed, volume)) {
+			return 0; // buffer overflow
+		}
+		playing = music_driver.playing;
 	}
-	if (!music_driver.playing) {
+	if (!playing) {
 		// finished playing
 		Atomic_Set_Ptr(&music_finished, mixer_last_song);
 	}
+	return 1;
+}
+
+// Renders music until the ring is full or there is nothing
+//  to play, the mixer wakes it after every chunk.
+// On the music thread.
+static void music_render( service_t* service ) {
+	int16_t* write = Atomic_Get_Ptr(&music_ringwrite);
+	int16_t* end = music_ring + music_ringframes*MIX_CHANNELS;
+
+	for (;;) {
+		// one frame is left free, so full and empty differ
+		int16_t* read = Atomic_Get_Ptr_Acquire(&music_ringread);
+		int space = (read - write)/MIX_CHANNELS - 1;
+		if (space < 0) {
+			space += music_ringframes;
+		}
+		if (space < mix_max_frames) {
+			return;
+		}
+		if (!mix_music(write, mix_max_frames)) {
+			return;
+		}
+		write += mix_max_frames*MIX_CHANNELS;
+		if (write == end) {
+			write = music_ring;
+		}
+		Atomic_Set_Ptr_Release(&music_ringwrite, write);
+	}
 }
 
 
+static void* mixer_heard_song = 0;    // song the mixer plays
+
+// Frames from one ring position to another.
+// On the mixer thread.
+static int mix_ringdistance( int16_t* from, int16_t* to ) {
+	int frames = (to - from)/MIX_CHANNELS;
+	if (frames < 0) {
+		frames += music_ringframes;
+	}
+	return frames;
+}
+
+// Copies the music rendered ahead into music_downmix,
+//  with silence for what is not there yet.
+// On the mixer thread.
+static void mix_copymusic( int mix_frames_needed ) {
+	void* song = Atomic_Get_Ptr(&music_songptr);
+	void* ringsong = Atomic_Get_Ptr_Acquire(&music_ringsong);
+	int16_t* songstart = Atomic_Get_Ptr(&music_songstart); // not past write
+	int16_t* read = Atomic_Get_Ptr(&music_ringread);
+	int16_t* write = Atomic_Get_Ptr_Acquire(&music_ringwrite);
+	int16_t* end = music_ring + music_ringframes*MIX_CHANNELS;
+	int16_t* out = music_downmix;
+	int ahead = mix_ringdistance(read, write);
+	int changed = 0;
+
+	if (song != mixer_heard_song) {
+		// Stopped, or a new track. What is left of the old
+		//  one is dropped, up to where the new one starts,
+		//  or all of it if the music thread is not there yet.
+		int skip = ahead;
+		if (ringsong == song) {
+			skip = mix_ringdistance(read, songstart);
+			if (skip > ahead) {
+				skip = 0; // already playing it
+			}
+		}
+		read += skip*MIX_CHANNELS;
+		if (read >= end) {
+			read -= music_ringframes*MIX_CHANNELS;
+		}
+		ahead -= skip;
+		mixer_heard_song = song;
+		changed = 1;
+	}
+	Atomic_Set_Int(&music_ahead, ahead);
+
+	// paused, the music thread waits for it as well
+	int count = mix_frames_needed;
+	if (Atomic_Get_Int(&music_paused)) {
+		count = 0;
+	} else if (ahead < count) {
+		if (!changed && Atomic_Get_Int(&music_rendering)) {
+			Atomic_Set_Int(&music_underruns, Atomic_Get_Int(&music_underruns) + 1);
+		}
+		count = ahead;
+	}
+
+	memset(out + count*MIX_CHANNELS, 0, (mix_frames_needed-count)*sizeof(int16_t)*MIX_CHANNELS);
+	while (count) {
+		int n = (end - read)/MIX_CHANNELS;
+		if (n > count) {
+			n = count;
+		}
+		memcpy(out, read, n*sizeof(int16_t)*MIX_CHANNELS);
+		out += n*MIX_CHANNELS;
+		read += n*MIX_CHANNELS;
+		count -= n;
+		if (read == end) {
+			read = music_ring;
+		}
+	}
+
+	Atomic_Set_Ptr_Release(&music_ringread, read);
+	I_WakeService(&music_service);
+}
+
+
+
+//
+// Adds count samples to the left and right sums.
+// The C version, see mix_accumulate_sse2.
+// On the mixer thread.
+//
+static void
+mix_accumulate_c
+( int32_t*	accum,
+  int16_t*	src,
+  int		count,
+  int		leftgain,
+  int		rightgain )
+{
+    int		n;
+
+    for (n=0 ; n<count ; n++)
+    {
+	accum[0] += src[n]*leftgain;
+	accum[1] += src[n]*rightgain;
+	accum += MIX_CHANNELS;
+    }
+}
+
 
+#ifdef SIMD_X86
 //
-// This function loops all active (internal) sound
-//  channels, retrieves a given number of samples
-//  from the raw sound data, modifies it according
-//  to the current (internal) channel parameters,
-//  mixes the per channel samples into the global
-//  mixbuffer, clamping it to the allowed range,
-//  and sets up everything for transferring the
-//  contents of the mixbuffer to the (two)
-//  hardware channels (left and right, that is).
+// Eight samples at a time. Each is doubled up to a left,
+//  right pair and multiplied by the gains, the low and
+//  high halves of the products are put back together
+//  in 32 bits and added to the sums.
+// Same sums as mix_accumulate_c.
+//
+__attribute__((target("sse2")))
+static void
+mix_accumulate_sse2
+( int32_t*	accum,
+  int16_t*	src,
+  int		count,
+  int		leftgain,
+  int		rightgain )
+{
+    __m128i	gains;
+    __m128i	s;
+    __m128i	pairs;
+    __m128i	lo;
+    __m128i	hi;
+    __m128i*	out;
+    int		n;
+
+    gains = _mm_set_epi16 (rightgain, leftgain, rightgain, leftgain,
+			   rightgain, leftgain, rightgain, leftgain);
+
+    for (n=0 ; n+8<=count ; n+=8)
+    {
+	s = _mm_loadu_si128 ((__m128i *)(src+n));
+	out = (__m128i *)(accum + n*MIX_CHANNELS);
+
+	pairs = _mm_unpacklo_epi16 (s, s);
+	lo = _mm_mullo_epi16 (pairs, gains);
+	hi = _mm_mulhi_epi16 (pairs, gains);
+	_mm_storeu_si128 (out+0, _mm_add_epi32 (_mm_loadu_si128 (out+0),
+		_mm_unpacklo_epi16 (lo, hi)));
+	_mm_storeu_si128 (out+1, _mm_add_epi32 (_mm_loadu_si128 (out+1),
+		_mm_unpackhi_epi16 (lo, hi)));
+
+	pairs = _mm_unpackhi_epi16 (s, s);
+	lo = _mm_mullo_epi16 (pairs, gains);
+	hi = _mm_mulhi_epi16 (pairs, gains);
+	_mm_storeu_si128 (out+2, _mm_add_epi32 (_mm_loadu_si128 (out+2),
+		_mm_unpacklo_epi16 (lo, hi)));
+	_mm_storeu_si128 (out+3, _mm_add_epi32 (_mm_loadu_si128 (out+3),
+		_mm_unpackhi_epi16 (lo, hi)));
+    }
+
+    mix_accumulate_c (accum + n*MIX_CHANNELS, src+n, count-n,
+		      leftgain, rightgain);
+}
+#endif
+
+
+//
+// Steps a channel over the chunk, and if it is heard,
+//  adds it to the sums. The sound is already at the
+//  output rate, so at normal pitch that is a plain add,
+//  otherwise it is stepped through into mix_voicebuf.
+// The step is the same for the whole chunk, params only
+//  change between chunks.
+// On the mixer thread.
+//
+static void mix_channel( int chan, int frames, int heard )
+{
+    int16_t*		data;
+    unsigned int	remainder;
+    unsigned int	step;
+    long long		total;
+    int			count;
+    int			n;
+
+    data = channels[chan];
+    remainder = channelstepremainder[chan];
+    step = channelstep[chan];
+
+    // Samples left before the end, the n-th sample
+    //  is at (remainder + n*step) >> 16.
+    // The end is only checked after a sample,
+    //  so there is always one.
+    count = frames;
+    if (step)
+    {
+	total = ((long long)(channelsend[chan] - data) << 16) - remainder;
+	total = (total + step - 1) / step;
+	if (total < 1)
+	    total = 1;
+	if (total < count)
+	    count = total;
+    }
+
+    if (heard)
+    {
+	if (step == 1<<16 && !remainder)
+	{
+	    mix_accumulate (mix_accum, data, count,
+			    channelleftgain[chan], channelrightgain[chan]);
+	}
+	else
+	{
+	    // Offset from data, 16.16 fixed point.
+	    // Lands where stepping and keeping the remainder
+	    //  one sample at a time would, without the dependency.
+	    total = remainder;
+	    for (n=0 ; n<count ; n++)
+	    {
+		mix_voicebuf[n] = data[total >> 16];
+		total += step;
+	    }
+
+	    mix_accumulate (mix_accum, mix_voicebuf, count,
+			    channelleftgain[chan], channelrightgain[chan]);
+	}
+    }
+
+    total = remainder + (long long)step*count;
+    data += total >> 16;
+    remainder = total & 0xffff;
+
+    channels[chan] = data;
+    channelstepremainder[chan] = remainder;
+
+    // Check whether we are done.
+    if (data >= channelsend[chan])
+    {
+	channels[chan] = 0;
+	Atomic_Set_Int(&channelfinished[chan], channelhandles[chan]);
+    }
+}
+
+
+//
+// Lower is mixed first, by the sfx priority,
+//  then the louder one.
+// On the mixer thread.
+//
+static int mix_rank( int chan )
+{
+    return channelpriority[chan]*1024
+	- channelleftgain[chan] - channelrightgain[chan];
+}
+
+
+//
+// Mixes the active channels one at a time over the
+//  whole chunk, into mix_accum. Only the mix_voices
+//  most important ones are heard.
+// Then the sums are filtered, the music added, and
+//  they are clamped and interleaved into mixbuffer.
 //
 // This function currently supports only 16bit.
 //
-// On the mixer thread. Acquires LOCK.
+// On the mixer thread, after mix_commands.
 //
-static void mix_samples( int16_t* mixbuffer, int samples_needed )
+static void mix_samples( int16_t* mixbuffer, int frames )
 {
-    // Mix current sound data.
-    // Data, from raw sound, for right and left.
-    register unsigned int	sample;
+    int		order[NUM_CHANNELS];
+    int		active;
+    int		heard;
+    int		chan;
+    int		rank;
+    int		i;
+    int		n;
+
     register int		dl;
     register int		dr;
-  
-    // Pointers in mixbuffer, left, right, end.
-    int16_t*			leftout;
-    int16_t*			rightout;
-    int16_t*			leftend;
+
+    int32_t*			accum;
+    int16_t*			out;
     int16_t*                    musicbuf;
 
-    // Mixing channel index.
-    int				chan;
+    // Active channels, most important first.
+    active = 0;
+    for (chan=0 ; chan<NUM_CHANNELS ; chan++)
+    {
+	if (!channels[chan])
+	    continue;
+
+	rank = mix_rank(chan);
+	for (i=active ; i>0 && mix_rank(order[i-1]) > rank ; i--)
+	    order[i] = order[i-1];
+	order[i] = chan;
+	active++;
+    }
 
-    // Left and right channel
-    //  are in mixbuffer, alternating.
-    leftout = mixbuffer;
-    rightout = mixbuffer+1;
+    heard = active < mix_voices ? active : mix_voices;
 
-    // Determine end, for left channel only
-    //  (right channel is implicit).
-    leftend = mixbuffer + samples_needed;
+    memset(mix_accum, 0, frames*MIX_CHANNELS*sizeof(*mix_accum));
 
-    // Also mix in the music buffer.
-    musicbuf = music_downmix;
+    for (i=0 ; i<active ; i++)
+	mix_channel(order[i], frames, i < heard);
 
-    // Need to hold this to access `channels`, `channelstep` etc
-    Mutex_Lock(&mix_mutex);
+    Atomic_Set_Int(&mix_heard, heard);
+    Atomic_Set_Int(&mix_virtual, active - heard);
 
-    // Mix sounds into the mixing buffer.
-    // Loop over step*samplecount,
-    //  that is 512 values for two channels.
-    while (leftout != leftend)
-    {
-	// Reset left/right value. 
-	dl = 0;
-	dr = 0;
-
-	// Love thy L2 chache - made this a loop.
-	// Now more channels could be set at compile time
-	//  as well. Thus loop those  channels.
-	for ( chan = 0; chan < NUM_CHANNELS; chan++ )
-	{
-	    // Check channel, if active.
-	    if (channels[ chan ])
-	    {
-		// Get the raw data from the channel. 
-		sample = *channels[ chan ];
-		// Add left and right part
-		//  for this channel (sound)
-		//  to the current data.
-		// Adjust volume accordingly.
-		dl += channelleftvol_lookup[ chan ][sample];
-		dr += channelrightvol_lookup[ chan ][sample];
-		// Apply pitch step to offset, 16.16 fixed point.
-		channelstepremainder[ chan ] += channelstep[ chan ];
-		// Advance by integer part in high 16 bits.
-		// To quadruple the sample-rate, we must slow down
-		// the stepping speed by 4x (add 1/4 of the actual step)
-		channels[ chan ] += channelstepremainder[ chan ] >> (16+SFX_STEP_SHIFT);
-		// Keep remainder in low 16 bits.
-		// As above, we need to keep an extra *4 (2 bits)
-		channelstepremainder[ chan ] &= (1<<(16+SFX_STEP_SHIFT))-1;
-
-		// Check whether we are done.
-		if (channels[ chan ] >= channelsend[ chan ])
-		    channels[ chan ] = 0;
-	    }
-	}
+    // Filter, add the music, clamp and interleave.
+    biquadlp_flush(&pcm_lpf_left);
+    biquadlp_flush(&pcm_lpf_right);
+
+    accum = mix_accum;
+    out = mixbuffer;
+    musicbuf = music_downmix;
 
-	// Write interleaved samples (left, right)
-	dl = biquadlp_step(&pcm_lpf_left, dl);  // left channel
-	dr = biquadlp_step(&pcm_lpf_right, dr);  // right channel
+    for (n=0 ; n<frames ; n++)
+    {
+	dl = biquadlp_step(&pcm_lpf_left, accum[0] * (1.0f/256));  // left channel
+	dr = biquadlp_step(&pcm_lpf_right, accum[1] * (1.0f/256));  // right channel
 
 	dl += musicbuf[0];
 	dr += musicbuf[1];
@@ -344,16 +830,13 @@ static void mix_samples( int16_t* mixbuffer, int samples_needed )
 		dr = -0x8000;
 	}
 
-	*leftout = dl;
-	*rightout = dr;
+	out[0] = dl;
+	out[1] = dr;
 
-	// Increment current pointers in mixbuffer.
-	leftout += MIX_CHANNELS;
-	rightout += MIX_CHANNELS;
+	accum += MIX_CHANNELS;
+	out += MIX_CHANNELS;
 	musicbuf += MIX_CHANNELS;
     }
-
-    Mutex_Unlock(&mix_mutex);
 }
 
 static void mix_callback( void* userdata, uint8_t* buffer, int buffer_size ) {
@@ -363,8 +846,20 @@ static void mix_callback( void* userdata, uint8_t* buffer, int buffer_size ) {
 	if (frames_needed > mix_max_frames) {
 		return; // overflows buffer
 	}
-	mix_music( frames_needed );
-	mix_samples( mixbuf, samples_needed );
+	unsigned start = I_GetTimeUS();
+	mix_copymusic( frames_needed );
+	mix_commands();
+	mix_samples( mixbuf, frames_needed );
+
+	// the game resets the peak when it reads it
+	int us = I_GetTimeUS() - start;
+	Atomic_Set_Int(&mix_chunkus, us);
+	if (us > Atomic_Get_Int(&mix_peakus)) {
+		Atomic_Set_Int(&mix_peakus, us);
+	}
+
+	// done with the data of every sound stopped before this chunk
+	Atomic_Set_Int(&mix_chunks, Atomic_Get_Int(&mix_chunks) + 1);
 }
 
 
@@ -372,28 +867,181 @@ static void mix_callback( void* userdata, uint8_t* buffer, int buffer_size ) {
 // MIXER THREAD ENDS
 
 
+// What the game knows of each channel, enough to pick one
+//  for a new sound without asking the mixer.
+// On the main thread only.
+
+// Handle last started on the channel, 0 once stopped.
+static unsigned int	sfxhandles[NUM_CHANNELS];
+
+// Time/gametic that the channel started playing,
+//  used to determine oldest, which automatically
+//  has lowest priority.
+// In case number of active sounds exceeds
+//  available channels.
+static int		sfxstart[NUM_CHANNELS];
+
+// SFX id of the playing sound effect.
+// Used to catch duplicates (like chainsaw).
+static int		sfxids[NUM_CHANNELS];
+
+// High bits of the next handle, the slot goes in the low bits.
+// Starts above 0, so 0 is never a handle.
+static unsigned int     nexthandle = NUM_CHANNELS_POW2;
+
 
 //
-// This function loads the sound data from the WAD lump,
-//  for single sound.
+// A sound effect, resampled to MIX_SAMPLERATE when it
+//  first plays. Purgeable once the mixer is done with
+//  it, and made again from the lump if it plays after.
+//
+typedef struct
+{
+    int16_t*	data;		// NULL once purged
+    int		length;		// samples
+    int		lumpnum;
+
+    // PU_STATIC since it was started, until the mixer
+    //  has moved past idlechunk.
+    boolean	locked;
+    boolean	idle;
+    int		idlechunk;
+
+} sfxcache_t;
+
+static sfxcache_t	sfxcache[NUMSFX];
+
+// Resampling kernel for sfx_kernelrate, sfx_taps weights
+//  for each of sfx_phases, 16.16 fixed point.
+static int*		sfx_kernel;
+static int		sfx_kernelrate;
+static int		sfx_taps;
+static int		sfx_phases;
+
+
+//
+// Sends a command to the mixer.
+// Returns 0 if the mixer is too far behind, and the
+//  command is dropped.
+// The last NUM_CHANNELS entries are kept for stops, which
+//  must never be dropped. Starts and updates leave them
+//  free, and until another start gets in each channel
+//  can only be stopped once.
 // On the main thread.
 //
-static void*
-getsfx
-( char*         sfxname,
-  int*          len )
+static int queue_mix( mixcmd_t* cmd )
 {
-    unsigned char*      sfx;
-    unsigned char*      paddedsfx;
-    int                 i;
-    int                 size;
-    int                 paddedsize;
-    char                name[20];
-    int                 sfxlump;
+    mixcmd_t*	write;
+    mixcmd_t*	read;
+    int		free;
+
+    // only this thread moves the write position
+    write = Atomic_Get_Ptr(&mix_queue_write);
+    read = Atomic_Get_Ptr_Acquire(&mix_queue_read);
+
+    free = read - write - 1;
+    if (free < 0)
+	free += MIX_QUEUE_SIZE;
+
+    if (free == 0
+	|| (cmd->type != mix_stop && free <= NUM_CHANNELS))
+	return 0;
+
+    *write = *cmd;
+    if (++write == mix_queue + MIX_QUEUE_SIZE)
+	write = mix_queue;
+    Atomic_Set_Ptr_Release(&mix_queue_write, write);
+    return 1;
+}
+
+
+//
+// True from the start of a sound until it finishes in
+//  the mixer or is stopped, including before the mixer
+//  has seen the start.
+// On the main thread.
+//
+static int sfx_playing( int slot )
+{
+    return sfxhandles[slot]
+	&& (unsigned int)Atomic_Get_Int(&channelfinished[slot]) != sfxhandles[slot];
+}
+
+
+//
+// Stops the slot at once as far as the game is concerned,
+//  the mixer follows with the next chunk.
+// On the main thread.
+//
+static void sfx_stop( int slot )
+{
+    mixcmd_t	cmd;
+
+    cmd.type = mix_stop;
+    cmd.handle = sfxhandles[slot];
+
+    // There is always room for a stop, see queue_mix.
+    if (!queue_mix(&cmd))
+	I_Error ("sfx_stop: mixer queue full");
+
+    sfxhandles[slot] = 0;
+}
+
+
+//
+// Fills in the step and the left and right volumes.
+// On the main thread.
+//
+static void
+sfx_params
+( mixcmd_t*	cmd,
+  int		volume,
+  int		seperation,
+  int		pitch )
+{
+    int		rightvol;
+    int		leftvol;
+
+    // Set stepping (pitch)
+    cmd->step = steptable[pitch];
+
+    // Separation, that is, orientation/stereo.
+    //  range is: 1 - 256
+    seperation += 1;
 
+    // Per left/right channel.
+    //  x^2 seperation,
+    //  adjust volume properly.
+    leftvol =
+	volume - ((volume*seperation*seperation) >> 16); ///(256*256);
+    seperation = seperation - 257;
+    rightvol =
+	volume - ((volume*seperation*seperation) >> 16);	
+
+    // Sanity check, clamp volume.
+    if (rightvol < 0 || rightvol > 127)
+	I_Error("rightvol out of bounds");
     
-    // Get the sound data from the WAD, allocate lump
-    //  in zone memory.
+    if (leftvol < 0 || leftvol > 127)
+	I_Error("leftvol out of bounds");
+
+    cmd->leftvol = leftvol;
+    cmd->rightvol = rightvol;
+}
+
+
+
+//
+// This function finds the sound data in the WAD,
+//  for a single sound.
+// On the main thread.
+//
+static int
+getsfxlump
+( char*         sfxname )
+{
+    char                name[20];
+
     sprintf(name, "ds%s", sfxname);
 
     // Now, there is a severe problem with the
@@ -407,43 +1055,231 @@ getsfx
     //  variable. Instead, we will use a
     //  default sound for replacement.
     if ( W_CheckNumForName(name) == -1 )
-      sfxlump = W_GetNumForName("dspistol");
+      return W_GetNumForName("dspistol");
     else
-      sfxlump = W_GetNumForName(name);
-    
-    size = W_LumpLength( sfxlump );
+      return W_GetNumForName(name);
+}
 
-    // Debug.
-    // fprintf( stderr, "." );
-    //fprintf( stderr, " -loading  %s (lump %d, %d bytes)\n",
-    //	     sfxname, sfxlump, size );
-    //fflush( stderr );
-    
-    sfx = (unsigned char*)W_CacheLumpNum( sfxlump, PU_STATIC );
 
-    // Pads the sound effect out to the mixing buffer size.
-    // The original realloc would interfere with zone memory.
-    paddedsize = ((size-8 + (mix_max_frames-1)) / mix_max_frames) * mix_max_frames;
+//
+// Works out the resampling kernel for a sample rate,
+//  a sinc with a Blackman window, cut off at the lower
+//  of the two Nyquist frequencies.
+// On the main thread.
+//
+static void sfx_makekernel( int rate )
+{
+    double	scale;
+    double	x;
+    double	w;
+    int		half;
+    int		phase;
+    int		tap;
+    int		a;
+    int		b;
+    int		c;
+
+    if (rate == sfx_kernelrate)
+	return;
+
+    // Every position between two samples, 4 of them
+    //  for 11025, if there are not too many.
+    for (a=MIX_SAMPLERATE, b=rate ; b ; a=b, b=c)
+	c = a % b;
+    sfx_phases = MIX_SAMPLERATE / a;
+    if (sfx_phases > SFX_PHASES)
+	sfx_phases = SFX_PHASES;
+
+    // Going down, the sinc is stretched to filter
+    //  out what the output rate can not carry.
+    scale = rate > MIX_SAMPLERATE ? (double)MIX_SAMPLERATE/rate : 1.0;
+    half = (int)ceil(SFX_ZEROS/scale);
+    sfx_taps = 2*half;
+
+    free(sfx_kernel);
+    sfx_kernel = malloc(sfx_phases*sfx_taps*sizeof(*sfx_kernel));
+    if (!sfx_kernel)
+	I_Error("sfx_makekernel: out of memory");
+
+    for (phase=0 ; phase<sfx_phases ; phase++)
+    {
+	for (tap=0 ; tap<sfx_taps ; tap++)
+	{
+	    // From the input sample to the output one,
+	    //  in zero crossings.
+	    x = ((double)phase/sfx_phases + half-1 - tap) * scale;
+
+	    w = 0;
+	    if (fabs(x) < SFX_ZEROS)
+	    {
+		w = x ? sin(M_PI*x)/(M_PI*x) : 1.0;
+		w *= 0.42 + 0.5*cos(M_PI*x/SFX_ZEROS)
+		    + 0.08*cos(2*M_PI*x/SFX_ZEROS);
+		w *= scale;
+	    }
+	    sfx_kernel[phase*sfx_taps + tap] = (int)floor(w*65536 + 0.5);
+	}
+    }
+
+    sfx_kernelrate = rate;
+}
 
-    // Allocate from zone memory.
-    paddedsfx = (unsigned char*)Z_Malloc( paddedsize+8, PU_STATIC, 0 );
-    // ddt: (unsigned char *) realloc(sfx, paddedsize+8);
-    // This should interfere with zone memory handling,
-    //  which does not kick in in the soundserver.
 
-    // Now copy and pad.
-    memcpy(  paddedsfx, sfx, size );
-    for (i=size ; i<paddedsize+8 ; i++)
-        paddedsfx[i] = 128;
+//
+// Resamples the sound data from the WAD lump, 8 bit
+//  unsigned at its own rate, into a new zone block,
+//  PU_STATIC, 16 bit signed at MIX_SAMPLERATE.
+// On the main thread.
+//
+static void sfx_resample( sfxcache_t* sfx )
+{
+    byte*	lump;
+    int*	in;
+    int*	kernel;
+    int		size;
+    int		rate;
+    int		count;
+    int		length;
+    int		half;
+    long long	pos;
+    int		sum;
+    int		i;
+    int		j;
+    int		tap;
+
+    lump = W_CacheLumpNum(sfx->lumpnum, PU_STATIC);
+    size = W_LumpLength(sfx->lumpnum);
+
+    rate = 11025;
+    count = 0;
+    if (size > SFX_HEADER)
+    {
+	rate = lump[2] | (lump[3]<<8);
+	if (rate < 4000 || rate > 96000)
+	    rate = 11025;
+	count = size - SFX_HEADER;
+    }
+
+    sfx_makekernel(rate);
+    half = sfx_taps/2;
+
+    // Signed, with silence on both sides for the kernel.
+    in = calloc(count + sfx_taps, sizeof(*in));
+    if (!in)
+	I_Error("sfx_resample: out of memory");
+    for (i=0 ; i<count ; i++)
+	in[half-1 + i] = lump[SFX_HEADER + i] - 128;
 
     // Remove the cached lump.
-    Z_Free( sfx );
-    
-    // Preserve padded length.
-    *len = paddedsize;
+    Z_Free(lump);
+
+    // The mixer always plays one sample.
+    length = ((long long)count*MIX_SAMPLERATE + rate-1) / rate;
+    if (length < 1)
+	length = 1;
+
+    Z_Malloc(length*sizeof(*sfx->data), PU_STATIC, &sfx->data);
+    sfx->length = length;
+
+    for (j=0 ; j<length ; j++)
+    {
+	// The first input sample under the kernel is
+	//  at in[i], and the phase picks the weights.
+	pos = (long long)j*rate;
+	i = pos / MIX_SAMPLERATE;
+	kernel = sfx_kernel
+	    + (pos % MIX_SAMPLERATE)*sfx_phases/MIX_SAMPLERATE*sfx_taps;
+
+	sum = 0;
+	for (tap=0 ; tap<sfx_taps ; tap++)
+	    sum += in[i+tap]*kernel[tap];
+
+	// 16.16 at 8 bits, to 16 bits.
+	sum = (sum + 128) >> 8;
+	if (sum > 0x7fff)
+	    sum = 0x7fff;
+	else if (sum < -0x8000)
+	    sum = -0x8000;
+	sfx->data[j] = sum;
+    }
 
-    // Return allocated padded data.
-    return (void *) (paddedsfx + 8);
+    free(in);
+}
+
+
+//
+// The cache entry of a sound, linked sounds share one.
+//
+static sfxcache_t* sfx_entry( int sfxid )
+{
+    if (S_sfx[sfxid].link)
+	sfxid = S_sfx[sfxid].link - S_sfx;
+
+    return &sfxcache[sfxid];
+}
+
+
+//
+// Keeps the data of a sound that is starting, and
+//  makes it if it is the first time or it was purged.
+// On the main thread.
+//
+static sfxcache_t* sfx_lock( int sfxid )
+{
+    sfxcache_t*	sfx;
+
+    sfx = sfx_entry(sfxid);
+
+    if (!sfx->data)
+	sfx_resample(sfx);
+    else if (!sfx->locked)
+	Z_ChangeTag(sfx->data, PU_STATIC);
+
+    sfx->locked = true;
+    sfx->idle = false;
+
+    return sfx;
+}
+
+
+//
+// Lets the zone purge the sounds the mixer is done with.
+// A sound is idle once no channel plays it as far as the
+//  game knows, but the mixer may still be reading it in
+//  the chunk it is on, so it is kept until the next one.
+// On the main thread.
+//
+static void sfx_unlock( void )
+{
+    boolean	playing[NUMSFX];
+    sfxcache_t*	sfx;
+    int		chunk;
+    int		i;
+
+    memset(playing, 0, sizeof(playing));
+    for (i=0 ; i<NUM_CHANNELS ; i++)
+	if (sfx_playing(i))
+	    playing[sfx_entry(sfxids[i]) - sfxcache] = true;
+
+    chunk = Atomic_Get_Int(&mix_chunks);
+
+    for (i=1 ; i<NUMSFX ; i++)
+    {
+	sfx = &sfxcache[i];
+	if (!sfx->locked || playing[i])
+	    continue;
+
+	if (!sfx->idle)
+	{
+	    sfx->idle = true;
+	    sfx->idlechunk = chunk;
+	}
+	else if (chunk != sfx->idlechunk)
+	{
+	    Z_ChangeTag(sfx->data, PU_CACHE);
+	    sfx->locked = false;
+	}
+    }
 }
 
 
@@ -453,23 +1289,22 @@ getsfx
 //  which is maintained as a given number
 //  (eight, usually) of internal channels.
 // Returns a handle.
-// On the main thread with LOCK held.
+// On the main thread.
 //
-static int addsfx_with_lock
+static int addsfx
 ( int		sfxid,
   int		volume,
-  int		step,
+  int		pitch,
   int		seperation )
 {
     int		i;
-    int         handle;
     
     int		oldest = gametic;
     int		oldestnum = 0;
     int		slot;
 
-    int		rightvol;
-    int		leftvol;
+    mixcmd_t	cmd;
+    sfxcache_t*	sfx;
 
     // Chainsaw troubles.
     // Play these sound effects only one at a time.
@@ -484,11 +1319,11 @@ static int addsfx_with_lock
 	for (i=0 ; i<NUM_CHANNELS ; i++)
 	{
 	    // Active, and using the same SFX?
-	    if ( (channels[i])
-		 && (channelids[i] == sfxid) )
+	    if ( sfx_playing(i)
+		 && (sfxids[i] == sfxid) )
 	    {
 		// Reset.
-		channels[i] = 0;
+		sfx_stop(i);
 		// We are sure that iff,
 		//  there will only be one.
 		break;
@@ -497,12 +1332,12 @@ static int addsfx_with_lock
     }
 
     // Loop all channels to find oldest SFX.
-    for (i=0; (i<NUM_CHANNELS) && (channels[i]); i++)
+    for (i=0; (i<NUM_CHANNELS) && sfx_playing(i); i++)
     {
-	if (channelstart[i] < oldest)
+	if (sfxstart[i] < oldest)
 	{
 	    oldestnum = i;
-	    oldest = channelstart[i];
+	    oldest = sfxstart[i];
 	}
     }
 
@@ -516,52 +1351,27 @@ static int addsfx_with_lock
 
     // Okay, in the less recent channel,
     //  we will handle the new SFX.
-    // Set pointer to raw data.
-    channels[slot] = (unsigned char *) sfx_data[sfxid];
-    // Set pointer to end of raw data.
-    channelsend[slot] = channels[slot] + sfx_length[sfxid];
+    // Handle is next handle number combined with slot index.
+    cmd.type = mix_start;
+    cmd.handle = nexthandle | (unsigned int)slot;
+    sfx = sfx_lock(sfxid);
+    cmd.data = sfx->data;
+    cmd.length = sfx->length;
+    cmd.priority = S_sfx[sfxid].priority;
+    sfx_params(&cmd, volume, seperation, pitch);
+    nexthandle += NUM_CHANNELS_POW2; // inc high bits above slot.
 
-    // Set stepping (pitch)
-    channelstep[slot] = step;
-    // Initial offset in sample.
-    channelstepremainder[slot] = 0;
     // Should be gametic, I presume.
-    channelstart[slot] = gametic;
-
-    // Separation, that is, orientation/stereo.
-    //  range is: 1 - 256
-    seperation += 1;
-
-    // Per left/right channel.
-    //  x^2 seperation,
-    //  adjust volume properly.
-    leftvol =
-	volume - ((volume*seperation*seperation) >> 16); ///(256*256);
-    seperation = seperation - 257;
-    rightvol =
-	volume - ((volume*seperation*seperation) >> 16);	
-
-    // Sanity check, clamp volume.
-    if (rightvol < 0 || rightvol > 127)
-	I_Error("rightvol out of bounds");
-    
-    if (leftvol < 0 || leftvol > 127)
-	I_Error("leftvol out of bounds");
-    
-    // Get the proper lookup table piece
-    //  for this volume level.
-    channelleftvol_lookup[slot] = &vol_lookup[leftvol*256];
-    channelrightvol_lookup[slot] = &vol_lookup[rightvol*256];
+    sfxstart[slot] = gametic;
 
     // Preserve sound SFX id,
     //  e.g. for avoiding duplicates of chainsaw.
-    channelids[slot] = sfxid;
+    sfxids[slot] = sfxid;
 
-    // Handle is next handle number combined with slot index.
-    channelhandles[slot] = nexthandle;
-    handle = nexthandle | (unsigned int)slot;
-    nexthandle += NUM_CHANNELS_POW2; // inc high bits above slot.
-    return handle;
+    // A dropped start never plays.
+    sfxhandles[slot] = queue_mix(&cmd) ? cmd.handle : 0;
+
+    return cmd.handle;
 }
 
 
@@ -580,7 +1390,6 @@ void I_SetChannels()
   // This function sets up internal lookups used during
   //  the mixing process. 
   int		i;
-  int		j;
   int		v;
     
   int*	steptablemid = steptable + 128;
@@ -591,33 +1400,61 @@ void I_SetChannels()
     channels[i] = 0;
   }
 
+  // Empty command queue.
+  Atomic_Set_Ptr(&mix_queue_write, mix_queue);
+  Atomic_Set_Ptr(&mix_queue_read, mix_queue);
+
   // This table provides step widths for pitch parameters.
   // I fail to see that this is currently used.
   for (i=-128 ; i<128 ; i++)
     steptablemid[i] = (int)(pow(2.0, (i/64.0))*65536.0);
   
   
-  // Generates volume lookup tables
-  //  which also turn the unsigned samples
-  //  into signed samples.
+  // Generates the volume gains, the samples
+  //  are made signed as they are resampled.
+  // Rounded, the old lookup tables had
+  //  (v*(j-128)*256)/127.
   for (i=0 ; i<128 ; i++) {
     v = (i*i)>>7; // log curve
-    for (j=0 ; j<256 ; j++)
-      vol_lookup[i*256+j] = (v*(j-128)*256)/127;
+    vol_gain[i] = (v*256 + 63)/127;
   }
 
+  mix_voices = snd_voices;
+  if (mix_voices < 1)
+    mix_voices = 1;
+  if (mix_voices > NUM_CHANNELS)
+    mix_voices = NUM_CHANNELS;
+
+  mix_accumulate = mix_accumulate_c;
+#ifdef SIMD_X86
+  __builtin_cpu_init ();
+  if (!M_CheckParm ("-nosimd") && __builtin_cpu_supports ("sse2"))
+    mix_accumulate = mix_accumulate_sse2;
+#endif
+
   // Find the GENMIDI lump and register instruments.
   int op2lump = W_CheckNumForName("GENMIDI.OP2");
   if ( op2lump == -1 )
     op2lump = W_GetNumForName("GENMIDI");
   char *op2 = W_CacheLumpNum( op2lump, PU_STATIC );
   musplay_op2bank(&music_driver.player, op2+8); // skip "#OPL_II#" to get BYTE[175][36] instrument data
+  I_InitMusicCache( (byte*)op2, W_LumpLength(op2lump), MIX_SAMPLERATE, OPL_CUTOFF_HZ );
   Z_Free( op2 );
 
   // Initialise audio.
   biquadlp_init(&pcm_lpf_left, MIX_SAMPLERATE, PCM_CUTOFF_HZ, PCM_Q_FACTOR);
   biquadlp_init(&pcm_lpf_right, MIX_SAMPLERATE, PCM_CUTOFF_HZ, PCM_Q_FACTOR);
 
+  // Start rendering music ahead, woken by the mixer,
+  //  or after a chunk's time.
+  // CONCURRENCY: starts music thread, full memory barrier.
+  Atomic_Set_Ptr(&music_ringwrite, music_ring);
+  Atomic_Set_Ptr(&music_ringread, music_ring);
+  Atomic_Set_Ptr(&music_songstart, music_ring);
+  music_service.func = music_render;
+  music_service.interval = mix_max_frames*1000000/MIX_SAMPLERATE;
+  I_StartService(&music_service);
+
   // Start audio.
   // CONCURRENCY: starts mixer thread, full memory barrier.
   Audio_Start(ddev_sound);
@@ -639,14 +1476,14 @@ void I_SetSfxVolume(int volume) // 0-127
 
 
 // MUSIC API. Some code from DOS version.
-// On the main thread. Acquires LOCK.
+// On the main thread.
 void I_SetMusicVolume(int volume) // 0-127
 {
     if (volume < 0 || volume > 127)
 	I_Error("Attempt to set music volume at %d", volume);
 
   // apply log-scaling to the requested volume.
-  // we can't use vol_lookup with 16-bit samples so this will do.
+  // we can't use vol_gain with 16-bit samples so this will do.
   volume += 2; // a bit of boost at max volume
   volume = (volume * volume) >> 7;
 
@@ -679,7 +1516,7 @@ int I_GetSfxLumpNum(sfxinfo_t* sfx)
 // Pitching (that is, increased speed of playback)
 //  is set, but currently not used by mixing.
 //
-// On the main thread. Acquires LOCK.
+// On the main thread.
 //
 int
 I_StartSound
@@ -691,16 +1528,12 @@ I_StartSound
 {
   int           handle;
 
-	Mutex_Lock(&mix_mutex);
-
 	// Returns a handle, later used for I_UpdateSoundParams
 	// Assumes volume in 0..127
-	handle = addsfx_with_lock( id, vol, steptable[pitch], sep );
+	handle = addsfx( id, vol, pitch, sep );
 
 	// fprintf( stderr, "/handle is %d\n", id );
 
-	Mutex_Unlock(&mix_mutex);
-
   // UNUSED
   priority = 0;
     
@@ -708,55 +1541,41 @@ I_StartSound
 }
 
 
-// On the main thread. Acquires LOCK.
+// On the main thread.
 void I_StopSound (int handle)
 {
   unsigned int h = handle; // modern UB.
 
   // You need the handle returned by StartSound.
-  // Would be looping all channels,
-  //  tracking down the handle,
-  //  an setting the channel to zero.
   
   int slot = h & (NUM_CHANNELS_POW2-1);
 
-  Mutex_Lock(&mix_mutex);
-
   // Check if the slot is still playing the same handle.
-  if (channels[slot] && channelhandles[slot] == (h & ~(NUM_CHANNELS_POW2-1))) {
+  if (sfxhandles[slot] == h && sfx_playing(slot)) {
 	// Reset.
-	channels[slot] = 0;
+	sfx_stop(slot);
   }
-
-  Mutex_Unlock(&mix_mutex);
 }
 
 
-// On the main thread. Acquires LOCK.
+// On the main thread, never waits for the mixer.
 int I_SoundIsPlaying(int handle)
 {
-  int playing = 0;
   unsigned int h = handle; // modern UB.
 
   int slot = h & (NUM_CHANNELS_POW2-1);
 
-  Mutex_Lock(&mix_mutex);
-
   // Check if the slot is still playing the same handle.
-  if (channels[slot] && channelhandles[slot] == (h & ~(NUM_CHANNELS_POW2-1))) {
-	playing = 1;
-  }
-
-  Mutex_Unlock(&mix_mutex);
-
-  return playing;
+  return sfxhandles[slot] == h && sfx_playing(slot);
 }
 
 
-// Not used.
+// On the main thread, once a frame.
 void I_UpdateSound( void )
 {
-  // Moved to mixer thread.
+  // Mixing moved to mixer thread.
+  sfx_unlock();
+  I_UpdateMusicCache();
 }
 
 
@@ -774,7 +1593,7 @@ I_SubmitSound(void)
 }
 
 
-// On the main thread. Acquires LOCK.
+// On the main thread.
 void
 I_UpdateSoundParams
 ( int	handle,
@@ -782,8 +1601,7 @@ I_UpdateSoundParams
   int	seperation,
   int	pitch)
 {
-  int		rightvol;
-  int		leftvol;
+  mixcmd_t	cmd;
 
   unsigned int h = handle; // modern UB.
 
@@ -793,42 +1611,14 @@ I_UpdateSoundParams
 
   int slot = h & (NUM_CHANNELS_POW2-1);
 
-  Mutex_Lock(&mix_mutex);
-
   // Check if the slot is still playing the same handle.
-  if (channels[slot] && channelhandles[slot] == (h & ~(NUM_CHANNELS_POW2-1))) {
-	
-    // Set stepping (pitch)
-    channelstep[slot] = steptable[pitch];
-
-    // Separation, that is, orientation/stereo.
-    //  range is: 1 - 256
-    seperation += 1;
-
-    // Per left/right channel.
-    //  x^2 seperation,
-    //  adjust volume properly.
-    leftvol =
-	volume - ((volume*seperation*seperation) >> 16); ///(256*256);
-    seperation = seperation - 257;
-    rightvol =
-	volume - ((volume*seperation*seperation) >> 16);	
-
-    // Sanity check, clamp volume.
-    if (rightvol < 0 || rightvol > 127)
-	I_Error("rightvol out of bounds");
-    
-    if (leftvol < 0 || leftvol > 127)
-	I_Error("leftvol out of bounds");
-    
-    // Get the proper lookup table piece
-    //  for this volume level.
-    channelleftvol_lookup[slot] = &vol_lookup[leftvol*256];
-    channelrightvol_lookup[slot] = &vol_lookup[rightvol*256];
-
+  // A dropped update is made up for by the next one.
+  if (sfxhandles[slot] == h && sfx_playing(slot)) {
+    cmd.type = mix_params;
+    cmd.handle = h;
+    sfx_params(&cmd, volume, seperation, pitch);
+    queue_mix(&cmd);
   }
-
-   Mutex_Unlock(&mix_mutex);
 }
 
 
@@ -858,6 +1648,10 @@ void I_ShutdownSound(void)
   // Stop the audio mixer and mixer thread.  
   Audio_Stop(ddev_sound);
 
+  // Then the music thread it wakes.
+  I_StopService(&music_service);
+  I_ShutdownMusicCache();
+
   // Release the Audio device.
   System_DropCapability(ddev_sound);
 
@@ -871,12 +1665,11 @@ void
 I_InitSound()
 { 
   int i;
+  int chunks;
   
   // Secure and configure sound device first.
   fprintf( stderr, "I_InitSound: ");
 
-  Mutex_Init(&mix_mutex);
-
   Audio_CreateStream(ddev_sound, mix_callback, Audio_Fmt_S16, MIX_CHANNELS, MIX_SAMPLERATE, MIX_CHUNK_SIZE);
   mix_max_frames = Audio_FrameCount(ddev_sound); // init once
 
@@ -885,26 +1678,34 @@ I_InitSound()
   musdriver_init(&music_driver, oplbuf, MIX_SAMPLERATE, mix_max_frames, OPL_CUTOFF_HZ);
   music_downmix = Buffer_Create(ddev_musicmix, mix_max_frames*sizeof(int16_t)*MIX_CHANNELS, 0);
 
-  // Initialize external data (all sounds) at start, keep static.
+  // At least snd_musicahead ms of music in whole chunks, and
+  //  a chunk more, as the ring is never filled to the end.
+  chunks = (snd_musicahead*MIX_SAMPLERATE/1000 + mix_max_frames-1) / mix_max_frames;
+  if (chunks < 1)
+    chunks = 1;
+  music_ringframes = (chunks+1)*mix_max_frames;
+
+  mix_accum = malloc(mix_max_frames*sizeof(*mix_accum)*MIX_CHANNELS);
+  mix_voicebuf = malloc(mix_max_frames*sizeof(*mix_voicebuf));
+  music_ring = malloc(music_ringframes*sizeof(*music_ring)*MIX_CHANNELS);
+  if (!mix_accum || !mix_voicebuf || !music_ring)
+    I_Error("I_InitSound: out of memory");
+
+  // Find external data (all sounds) at start, each is
+  //  resampled when it first plays, see sfx_lock.
   fprintf( stderr, "I_InitSound: sfx_max=%d opl_max=%d\n", (int)mix_max_frames, (int)music_driver.opl_max_frames);
 
   for (i=1 ; i<NUMSFX ; i++)
   { 
     // Alias? Example is the chaingun sound linked to pistol.
     if (!S_sfx[i].link)
-    {
-      // Load data from WAD file.
-      S_sfx[i].data = sfx_data[i] = getsfx( S_sfx[i].name, &sfx_length[i] );
-    }	
-    else
-    {
-      // Previously loaded already?
-      S_sfx[i].data = sfx_data[i] = S_sfx[i].link->data;
-      sfx_length[i] = sfx_length[(S_sfx[i].link - S_sfx)/sizeof(sfxinfo_t)];
-    }
+      sfxcache[i].lumpnum = getsfxlump( S_sfx[i].name );
+
+    // Only checked for, the data is in sfxcache.
+    S_sfx[i].data = sfx_entry(i);
   }
 
-  fprintf( stderr, " pre-cached all sound data\n");
+  fprintf( stderr, " found all sound data\n");
 
   // Finished initialization.
   fprintf(stderr, "I_InitSound: sound module ready\n");
@@ -921,6 +1722,7 @@ void I_ShutdownMusic(void)	{ }
 
 // Only used here to communicate between I_RegisterSong and I_PlaySong
 static void*    last_registered_song = 0;
+static muspcm_t* last_registered_pcm = 0;
 static int      started_playing = 0;
 
 void I_PlaySong(int handle, int loop)
@@ -931,6 +1733,7 @@ void I_PlaySong(int handle, int loop)
   if (last_registered_song) {
 	started_playing = 1;
 	Atomic_Set_Int(&music_loop, loop); // prior to release
+	Atomic_Set_Ptr(&music_songpcm, last_registered_pcm);
 	Atomic_Set_Ptr_Release(&music_songptr, last_registered_song);
   }
 }
@@ -966,15 +1769,40 @@ void I_UnRegisterSong(int handle)
   handle = 0;
 }
 
-int I_RegisterSong(void* data)
+int I_RegisterSong(void* data, int length)
 {
   // Always registered just before I_PlaySong.
   // Always unregistered just after I_StopSong.
   // Music lump data. Returns handle.
   last_registered_song = data;
+  last_registered_pcm = I_CacheSong(data, length);
   return 1;
 }
 
+//
+// Mixer load, the peak and the underruns
+//  are since the last call.
+// On the main thread.
+//
+void I_GetMixStats (mixstats_t* stats)
+{
+  static int	lastunderruns;
+  int		underruns;
+
+  stats->chunkus = Atomic_Get_Int(&mix_chunkus);
+  stats->peakus = Atomic_Get_Int(&mix_peakus);
+  stats->heard = Atomic_Get_Int(&mix_heard);
+  stats->virtualvoices = Atomic_Get_Int(&mix_virtual);
+
+  Atomic_Set_Int(&mix_peakus, 0);
+
+  underruns = Atomic_Get_Int(&music_underruns);
+  stats->musicunderruns = underruns - lastunderruns;
+  lastunderruns = underruns;
+  stats->musicaheadms = Atomic_Get_Int(&music_ahead)*1000/MIX_SAMPLERATE;
+}
+
+
 // Is the song playing?
 int I_QrySongPlaying(int handle)
 {
@@ -87,6 +87,31 @@ I_UpdateSoundParams
   int		pitch );
 
 
+// Channels heard at once, the others step along
+//  silently, from the config file.
+extern int snd_voices;
+
+// Milliseconds of music rendered ahead of the mixer,
+//  from the config file.
+extern int snd_musicahead;
+
+//
+// Mixer load, see -rstats.
+//
+typedef struct
+{
+    int		chunkus;	// time to mix the last chunk
+    int		peakus;		// longest since the last call
+    int		heard;		// channels mixed in the last chunk
+    int		virtualvoices;	// playing but not mixed
+    int		musicunderruns;	// chunks the music was late for
+    int		musicaheadms;	// music rendered ahead
+
+} mixstats_t;
+
+void I_GetMixStats (mixstats_t* stats);
+
+
 //
 //  MUSIC I/O
 //
@@ -97,8 +122,9 @@ void I_SetMusicVolume(int volume);
 // PAUSE game handling.
 void I_PauseSong(int handle);
 void I_ResumeSong(int handle);
-// Registers a song handle to song data.
-int I_RegisterSong(void *data);
+// Registers a song handle to song data,
+//  length bytes of it, the size of the lump.
+int I_RegisterSong(void *data, int length);
 // Called by anything that wishes to start music.
 //  plays a song, and when the song is done,
 //  starts playing it again in an endless loop.
@@ -30,9 +30,11 @@ rcsid[] = "$Id: m_bbox.c,v 1.1 1997/02/03 22:45:10 b1 Exp $";
 
 #include <stdarg.h>
 #include <sys/time.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "doomdef.h"
+#include "m_argv.h"
 #include "m_misc.h"
 #include "i_video.h"
 #include "i_sound.h"
@@ -48,7 +50,17 @@ rcsid[] = "$Id: m_bbox.c,v 1.1 1997/02/03 22:45:10 b1 Exp $";
 
 
 
-int	mb_used = 50; // 6;
+// The zone starts with mb_used megabytes, -heapmin,
+//  and adds regions as it runs out, up to mb_max
+//  megabytes in all, -heapmax.
+int	mb_used = 16; // 6;
+int	mb_max = 512;
+
+// The zone counts bytes in an int.
+#define MAXHEAPMB	2047
+
+// bytes from I_ZoneBase and I_ZoneGrow
+static int	zoneheap;
 
 
 void
@@ -75,8 +87,75 @@ int  I_GetHeapSize (void)
 
 byte* I_ZoneBase (int*	size)
 {
+    byte*	base;
+    int		p;
+
+    p = M_CheckParm ("-heapmin");
+    if (p && p < myargc-1)
+	mb_used = atoi (myargv[p+1]);
+
+    p = M_CheckParm ("-heapmax");
+    if (p && p < myargc-1)
+	mb_max = atoi (myargv[p+1]);
+
+    if (mb_used < 1)
+	mb_used = 1;
+    if (mb_used > MAXHEAPMB)
+	mb_used = MAXHEAPMB;
+    if (mb_max > MAXHEAPMB)
+	mb_max = MAXHEAPMB;
+    if (mb_max < mb_used)
+	mb_max = mb_used;
+
     *size = mb_used*1024*1024;
-    return (byte *) malloc (*size);
+    base = (byte *) malloc (*size);
+    if (!base)
+	I_Error ("I_ZoneBase: couldn't get %i MB", mb_used);
+
+    zoneheap = *size;
+    return base;
+}
+
+
+//
+// I_ZoneGrow
+// Regions are at least mb_used big, so a long session
+//  does not end up with many small ones.
+//
+byte* I_ZoneGrow (int*	size)
+{
+    byte*	base;
+    int		mb;
+
+    mb = (*size + 1024*1024-1) / (1024*1024);
+    if (mb < mb_used)
+	mb = mb_used;
+
+    if (zoneheap/(1024*1024) + mb > mb_max)
+    {
+	// take what is left, if it is enough
+	mb = mb_max - zoneheap/(1024*1024);
+	if (mb*1024*1024 < *size)
+	    return NULL;
+    }
+
+    base = (byte *) malloc (mb*1024*1024);
+    if (!base)
+	return NULL;
+
+    *size = mb*1024*1024;
+    zoneheap += *size;
+    return base;
+}
+
+
+//
+// I_ZoneRelease
+//
+void I_ZoneRelease (byte* base, int size)
+{
+    free (base);
+    zoneheap -= size;
 }
 
 
@@ -100,6 +179,37 @@ int  I_GetTime (void)
 }
 
 
+//
+// I_GetTimeUS
+// returns a monotonic time in microseconds,
+//  only the difference of two calls means anything
+//
+unsigned I_GetTimeUS (void)
+{
+    struct timespec	ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (unsigned)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+
+//
+// I_GetTimeFrac
+// returns how far into the current tic it is,
+//  0 to FRACUNIT-1, in step with I_GetTime
+//
+fixed_t I_GetTimeFrac (void)
+{
+    struct timeval	tp;
+    struct timezone	tzp;
+    int			usec;
+
+    gettimeofday(&tp, &tzp);
+    usec = tp.tv_usec*TICRATE % 1000000;
+    return (fixed_t)((long long)usec*FRACUNIT/1000000);
+}
+
+
 //
 // I_Init
 //
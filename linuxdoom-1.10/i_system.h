@@ -25,6 +25,7 @@
 
 #include "d_ticcmd.h"
 #include "d_event.h"
+#include "m_fixed.h"
 
 #ifdef __GNUG__
 #pragma interface
@@ -39,11 +40,25 @@ void I_Init (void);
 // for the zone management.
 byte*	I_ZoneBase (int *size);
 
+// More memory for the zone, at least *size bytes,
+//  *size is set to what was given.
+// NULL when the zone would pass -heapmax.
+byte*	I_ZoneGrow (int *size);
+
+// Gives back a region from I_ZoneGrow.
+void	I_ZoneRelease (byte* base, int size);
+
 
 // Called by D_DoomLoop,
 // returns current time in tics.
 int I_GetTime (void);
 
+// How far into the current tic it is, 0 to FRACUNIT-1.
+fixed_t I_GetTimeFrac (void);
+
+// Microseconds, for timing, wraps around.
+unsigned I_GetTimeUS (void);
+
 
 //
 // Called by D_DoomLoop,
@@ -0,0 +1,410 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Worker threads, POSIX version.
+//
+//-----------------------------------------------------------------------------
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "i_system.h"
+
+#ifdef __GNUG__
+#pragma implementation "i_thread.h"
+#endif
+#include "i_thread.h"
+
+
+#define MAXWORKERS		64
+
+
+//
+// I_NumProcessors
+//
+int I_NumProcessors (void)
+{
+    long	n;
+
+    n = sysconf (_SC_NPROCESSORS_ONLN);
+
+    if (n < 1)
+	return 1;
+    if (n > MAXWORKERS)
+	return MAXWORKERS;
+    return (int)n;
+}
+
+
+
+//
+// WORKER POOL
+// Workers sleep on pool_wake until the generation changes,
+//  run their index of the current job, and the last one
+//  to finish signals pool_done.
+//
+static pthread_mutex_t	pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	pool_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	pool_done = PTHREAD_COND_INITIALIZER;
+
+static int		numworkers;
+static pthread_t	workers[MAXWORKERS];
+static unsigned		workergen[MAXWORKERS];
+
+static unsigned		generation;
+static int		jobcount;
+static int		pending;
+static parallelfunc_t	jobfunc;
+static void*		jobarg;
+
+
+static void* I_WorkerThread (void* arg)
+{
+    int		index = (int)(size_t)arg;
+    unsigned	seen = workergen[index];
+
+    pthread_mutex_lock (&pool_lock);
+
+    while (1)
+    {
+	while (generation == seen)
+	    pthread_cond_wait (&pool_wake, &pool_lock);
+
+	seen = generation;
+
+	if (index >= jobcount)
+	    continue;
+
+	pthread_mutex_unlock (&pool_lock);
+	jobfunc (index, jobarg);
+	pthread_mutex_lock (&pool_lock);
+
+	if (--pending == 0)
+	    pthread_cond_signal (&pool_done);
+    }
+
+    return NULL;
+}
+
+
+//
+// I_RunParallel
+//
+void
+I_RunParallel
+( int		count,
+  parallelfunc_t func,
+  void*		arg )
+{
+    if (count > MAXWORKERS)
+	I_Error ("I_RunParallel: %i > MAXWORKERS", count);
+
+    if (count <= 1)
+    {
+	func (0, arg);
+	return;
+    }
+
+    // spawn missing workers, worker N runs index N
+    while (numworkers < count-1)
+    {
+	// start out having seen every job so far
+	workergen[numworkers+1] = generation;
+	if (pthread_create (&workers[numworkers], NULL,
+			    I_WorkerThread, (void *)(size_t)(numworkers+1)))
+	    I_Error ("I_RunParallel: could not create a worker thread");
+	numworkers++;
+    }
+
+    pthread_mutex_lock (&pool_lock);
+    jobfunc = func;
+    jobarg = arg;
+    jobcount = count;
+    pending = count-1;
+    generation++;
+    pthread_cond_broadcast (&pool_wake);
+    pthread_mutex_unlock (&pool_lock);
+
+    // the calling thread takes the first share
+    func (0, arg);
+
+    pthread_mutex_lock (&pool_lock);
+    while (pending)
+	pthread_cond_wait (&pool_done, &pool_lock);
+    pthread_mutex_unlock (&pool_lock);
+}
+
+
+
+//
+// BACKGROUND JOBS
+// The job thread takes jobs off the head of the queue,
+//  jobdone is signalled whenever one has run.
+//
+enum
+{
+    js_queued = 1,
+    js_running,
+    js_done
+};
+
+static pthread_mutex_t	job_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	job_wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t	job_done = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t	io_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_t	jobthread;
+static int		jobthreadstarted;
+
+static job_t*		jobhead;
+static job_t*		jobtail;
+
+
+//
+// I_RunJob
+// With job_lock held, which is let go while it runs.
+//
+static void I_RunJob (job_t* job)
+{
+    job->state = js_running;
+    pthread_mutex_unlock (&job_lock);
+    job->func (job);
+    pthread_mutex_lock (&job_lock);
+    job->state = js_done;
+    pthread_cond_broadcast (&job_done);
+}
+
+
+static void* I_JobThread (void* arg)
+{
+    job_t*	job;
+
+    pthread_mutex_lock (&job_lock);
+
+    while (1)
+    {
+	while (!jobhead)
+	    pthread_cond_wait (&job_wake, &job_lock);
+
+	job = jobhead;
+	jobhead = job->next;
+	if (!jobhead)
+	    jobtail = NULL;
+
+	I_RunJob (job);
+    }
+
+    return NULL;
+}
+
+
+//
+// I_QueueJob
+//
+void I_QueueJob (job_t* job)
+{
+    if (!jobthreadstarted)
+    {
+	if (pthread_create (&jobthread, NULL, I_JobThread, NULL))
+	    I_Error ("I_QueueJob: could not create the job thread");
+	jobthreadstarted = 1;
+    }
+
+    pthread_mutex_lock (&job_lock);
+
+    job->next = NULL;
+    job->state = js_queued;
+    if (jobtail)
+	jobtail->next = job;
+    else
+	jobhead = job;
+    jobtail = job;
+
+    pthread_cond_signal (&job_wake);
+    pthread_mutex_unlock (&job_lock);
+}
+
+
+//
+// I_JobDone
+//
+int I_JobDone (job_t* job)
+{
+    int		done;
+
+    pthread_mutex_lock (&job_lock);
+    done = job->state == js_done;
+    pthread_mutex_unlock (&job_lock);
+
+    return done;
+}
+
+
+//
+// I_FinishJob
+//
+void I_FinishJob (job_t* job)
+{
+    job_t*	prev;
+
+    pthread_mutex_lock (&job_lock);
+
+    if (job->state == js_queued)
+    {
+	// take it off the queue and run it here
+	if (jobhead == job)
+	{
+	    prev = NULL;
+	    jobhead = job->next;
+	}
+	else
+	{
+	    for (prev = jobhead ; prev->next != job ; prev = prev->next)
+		;
+	    prev->next = job->next;
+	}
+	if (jobtail == job)
+	    jobtail = prev;
+
+	I_RunJob (job);
+    }
+
+    while (job->state != js_done)
+	pthread_cond_wait (&job_done, &job_lock);
+
+    pthread_mutex_unlock (&job_lock);
+}
+
+
+//
+// I_LockIO
+//
+void I_LockIO (void)
+{
+    pthread_mutex_lock (&io_lock);
+}
+
+void I_UnlockIO (void)
+{
+    pthread_mutex_unlock (&io_lock);
+}
+
+
+
+//
+// SERVICE THREADS
+// Each one has a semaphore to sleep on, posting it is
+//  all I_WakeService does. Extra posts only cost an
+//  extra call. stop is under service_lock.
+//
+typedef struct
+{
+    pthread_t	thread;
+    sem_t	wake;
+
+} servicesys_t;
+
+static pthread_mutex_t	service_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+static void* I_ServiceThread (void* arg)
+{
+    service_t*		service = arg;
+    servicesys_t*	sys = service->sys;
+    struct timespec	until;
+    int			stop;
+
+    while (1)
+    {
+	pthread_mutex_lock (&service_lock);
+	stop = service->stop;
+	pthread_mutex_unlock (&service_lock);
+
+	if (stop)
+	    break;
+
+	service->func (service);
+
+	clock_gettime (CLOCK_REALTIME, &until);
+	until.tv_nsec += (long)service->interval*1000;
+	until.tv_sec += until.tv_nsec / 1000000000;
+	until.tv_nsec %= 1000000000;
+
+	while (sem_timedwait (&sys->wake, &until) && errno == EINTR)
+	    ;
+    }
+
+    return NULL;
+}
+
+
+//
+// I_StartService
+//
+void I_StartService (service_t* service)
+{
+    servicesys_t*	sys;
+
+    sys = malloc (sizeof(*sys));
+    if (!sys || sem_init (&sys->wake, 0, 0))
+	I_Error ("I_StartService: could not make the semaphore");
+
+    service->sys = sys;
+    service->stop = 0;
+
+    if (pthread_create (&sys->thread, NULL, I_ServiceThread, service))
+	I_Error ("I_StartService: could not create the thread");
+}
+
+
+//
+// I_WakeService
+//
+void I_WakeService (service_t* service)
+{
+    servicesys_t*	sys = service->sys;
+
+    sem_post (&sys->wake);
+}
+
+
+//
+// I_StopService
+//
+void I_StopService (service_t* service)
+{
+    servicesys_t*	sys = service->sys;
+
+    pthread_mutex_lock (&service_lock);
+    service->stop = 1;
+    pthread_mutex_unlock (&service_lock);
+
+    sem_post (&sys->wake);
+    pthread_join (sys->thread, NULL);
+
+    sem_destroy (&sys->wake);
+    free (sys);
+    service->sys = NULL;
+}
@@ -0,0 +1,107 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// DESCRIPTION:
+//	System specific worker threads.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __I_THREAD__
+#define __I_THREAD__
+
+
+#ifdef __GNUG__
+#pragma interface
+#endif
+
+
+// Number of hardware threads, at least 1.
+int I_NumProcessors (void);
+
+
+//
+// Worker pool.
+// Runs func(0) .. func(count-1), one index per thread,
+//  with index 0 on the calling thread.
+// Returns when all of them have finished.
+// The pool grows on first use to count-1 workers.
+//
+typedef void (*parallelfunc_t) (int index, void* arg);
+
+void I_RunParallel (int count, parallelfunc_t func, void* arg);
+
+
+//
+// Background jobs.
+// One thread of their own runs them in the order they
+//  were queued, while the game goes on, e.g. to read
+//  lumps ahead of their use.
+// The job is owned by i_thread.c until it is done.
+//
+typedef struct job_s
+{
+    struct job_s*	next;
+    void		(*func) (struct job_s* job);
+    int			state;
+
+} job_t;
+
+void I_QueueJob (job_t* job);
+
+// True once the job has run.
+int I_JobDone (job_t* job);
+
+// Runs the job on the calling thread if it has not
+//  started yet, waits for it if it has.
+void I_FinishJob (job_t* job);
+
+// Around reads from files a job may read as well.
+void I_LockIO (void);
+void I_UnlockIO (void);
+
+
+//
+// Service threads.
+// A thread of its own that calls func over and over,
+//  sleeping in between until I_WakeService, or until
+//  interval microseconds have passed, e.g. to render
+//  music ahead of the audio device.
+// I_WakeService never blocks, so the audio callback
+//  may call it.
+//
+typedef struct service_s
+{
+    void		(*func) (struct service_s* service);
+    int			interval;	// microseconds
+
+    // i_thread.c
+    void*		sys;
+    int			stop;
+
+} service_t;
+
+void I_StartService (service_t* service);
+void I_WakeService (service_t* service);
+
+// Returns once func has returned for the last time.
+void I_StopService (service_t* service);
+
+
+#endif
+//-----------------------------------------------------------------------------
+//
+// $Log:$
+//
+//-----------------------------------------------------------------------------
@@ -332,9 +332,9 @@ void I_FinishUpdate (void)
 		if (tics > 20) tics = 20;
 
 		for (i=0 ; i<tics*2 ; i+=2)
-			screens[0][ (SCREENHEIGHT-1)*SCREENWIDTH + i] = 0xff;
+			screens[0][ (screenheight-1)*screenwidth + i] = 0xff;
 		for ( ; i<20*2 ; i+=2)
-			screens[0][ (SCREENHEIGHT-1)*SCREENWIDTH + i] = 0x0;
+			screens[0][ (screenheight-1)*screenwidth + i] = 0x0;
     }
 
 	// draw the image
@@ -344,7 +344,7 @@ void I_FinishUpdate (void)
 		// at the end of each frame; this fixes the melt effect
 		// which otherwise stalls after 1-2 frames.
 		// CANNOT change screens[0], see R_InitBuffer.
-		memcpy(Buffer_Address(VFrameCap), screens[0], SCREENWIDTH*SCREENHEIGHT);
+		memcpy(Buffer_Address(VFrameCap), screens[0], screenwidth*screenheight);
 
 		// Transfer the render buffer to the framebuffer service.
 		// this means we no longer have access to the buffer,
@@ -365,7 +365,7 @@ void I_FinishUpdate (void)
 //
 void I_ReadScreen (byte* scr)
 {
-    memcpy (scr, screens[0], SCREENWIDTH*SCREENHEIGHT);
+    memcpy (scr, screens[0], screenwidth*screenheight);
 }
 
 //
@@ -467,8 +467,8 @@ void I_InitGraphics(void)
     // setup attributes for main window
 	Input_Subscribe(ddev_input, InputOpt_Key|InputOpt_Button|InputOpt_Pointer, ddev_main_q);
 
-    // create the main window
-	FrameBuffer_Create(ddev_fb, FrameBuffer_DoubleBuffer|FrameBuffer_Palette|FrameBuffer_NoSmooth, SCREENWIDTH, SCREENHEIGHT, 8, ddev_main_q);
+    // create the main window, -width by -height, see V_Init
+	FrameBuffer_Create(ddev_fb, FrameBuffer_DoubleBuffer|FrameBuffer_Palette|FrameBuffer_NoSmooth, screenwidth, screenheight, 8, ddev_main_q);
 	FrameBuffer_SetTitle(ddev_fb, "the OG, DOOM");
 
 	// create palette
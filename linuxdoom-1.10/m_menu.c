@@ -172,7 +172,7 @@ short		whichSkull;		// which skull to draw
 
 // graphic name of skulls
 // warning: initializer-string for array of chars is too long
-char    skullName[2][/*8*/9] = {"M_SKULL1","M_SKULL2"};
+lumphandle_t	skullName[2] = {LUMPHANDLE("M_SKULL1"),LUMPHANDLE("M_SKULL2")};
 
 // current menudef
 menu_t*	currentMenu;                          
@@ -1186,21 +1186,25 @@ M_DrawThermo
   int	thermWidth,
   int	thermDot )
 {
+    static lumphandle_t	therml = LUMPHANDLE("M_THERML");
+    static lumphandle_t	thermm = LUMPHANDLE("M_THERMM");
+    static lumphandle_t	thermr = LUMPHANDLE("M_THERMR");
+    static lumphandle_t	thermo = LUMPHANDLE("M_THERMO");
     int		xx;
     int		i;
 
     xx = x;
-    V_DrawPatchDirect (xx,y,0,W_CacheLumpName("M_THERML",PU_CACHE));
+    V_DrawPatchDirect (xx,y,0,W_CacheLumpHandle(&therml,PU_CACHE));
     xx += 8;
     for (i=0;i<thermWidth;i++)
     {
-	V_DrawPatchDirect (xx,y,0,W_CacheLumpName("M_THERMM",PU_CACHE));
+	V_DrawPatchDirect (xx,y,0,W_CacheLumpHandle(&thermm,PU_CACHE));
 	xx += 8;
     }
-    V_DrawPatchDirect (xx,y,0,W_CacheLumpName("M_THERMR",PU_CACHE));
+    V_DrawPatchDirect (xx,y,0,W_CacheLumpHandle(&thermr,PU_CACHE));
 
     V_DrawPatchDirect ((x+8) + thermDot*8,y,
-		       0,W_CacheLumpName("M_THERMO",PU_CACHE));
+		       0,W_CacheLumpHandle(&thermo,PU_CACHE));
 }
 
 
@@ -1210,8 +1214,10 @@ M_DrawEmptyCell
 ( menu_t*	menu,
   int		item )
 {
+    static lumphandle_t	cell = LUMPHANDLE("M_CELL1");
+
     V_DrawPatchDirect (menu->x - 10,        menu->y+item*LINEHEIGHT - 1, 0,
-		       W_CacheLumpName("M_CELL1",PU_CACHE));
+		       W_CacheLumpHandle(&cell,PU_CACHE));
 }
 
 void
@@ -1219,8 +1225,10 @@ M_DrawSelCell
 ( menu_t*	menu,
   int		item )
 {
+    static lumphandle_t	cell = LUMPHANDLE("M_CELL2");
+
     V_DrawPatchDirect (menu->x - 10,        menu->y+item*LINEHEIGHT - 1, 0,
-		       W_CacheLumpName("M_CELL2",PU_CACHE));
+		       W_CacheLumpHandle(&cell,PU_CACHE));
 }
 
 
@@ -1800,7 +1808,7 @@ void M_Drawer (void)
     
     // DRAW SKULL
     V_DrawPatchDirect(x + SKULLXOFF,currentMenu->y - 5 + itemOn*LINEHEIGHT, 0,
-		      W_CacheLumpName(skullName[whichSkull],PU_CACHE));
+		      W_CacheLumpHandle(&skullName[whichSkull],PU_CACHE));
 
 }
 
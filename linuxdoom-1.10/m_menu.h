@@ -54,6 +54,10 @@ void M_Init (void);
 // does nothing if menu is already up.
 void M_StartControlPanel (void);
 
+// Writes a string using the hu_font,
+//  at 320x200 coordinates.
+void M_WriteText (int x, int y, char* string);
+
 
 
 
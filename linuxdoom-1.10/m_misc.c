@@ -195,6 +195,9 @@ extern int	showMessages;
 
 // machine-independent sound params
 extern	int	numChannels;
+extern	int	snd_voices;
+extern	int	snd_musicahead;
+extern	int	snd_musiccache;
 
 extern char*	chat_macros[];
 
@@ -258,7 +261,10 @@ default_t	defaults[] =
     {"screenblocks",&screenblocks, 10},
     {"detaillevel",&detailLevel, 0},
 
-    {"snd_channels",&numChannels, 8},
+    {"snd_channels",&numChannels, 32},
+    {"snd_voices",&snd_voices, 16},
+    {"snd_musicahead",&snd_musicahead, 50},
+    {"snd_musiccache",&snd_musiccache, 0},
 
 
 
@@ -509,7 +515,7 @@ void M_ScreenShot (void)
     
     // save the pcx file
     WritePCXfile (lbmname, linear,
-		  SCREENWIDTH, SCREENHEIGHT,
+		  screenwidth, screenheight,
 		  W_CacheLumpName ("PLAYPAL",PU_CACHE));
 	
     players[consoleplayer].message = "screen shot";
@@ -37,6 +37,8 @@ rcsid[] = "$Id: p_mobj.c,v 1.5 1997/02/03 22:45:12 b1 Exp $";
 
 #include "s_sound.h"
 
+#include "r_interp.h"
+
 #include "doomstat.h"
 
 
@@ -530,6 +532,8 @@ P_SpawnMobj
 	
     P_AddThinker (&mobj->thinker);
 
+    R_SnapMobj (mobj);
+
     return mobj;
 }
 
@@ -682,6 +686,8 @@ void P_SpawnPlayer (mapthing_t* mthing)
     p->fixedcolormap = 0;
     p->viewheight = VIEWHEIGHT;
 
+    R_SnapMobj (mobj);
+
     // setup gun psprite
     P_SetupPsprites (p);
     
@@ -282,6 +282,14 @@ typedef struct mobj_s
 
     // Thing being chased/attacked for tracers.
     struct mobj_s*	tracer;	
+
+    // Where it was at the start of the tic,
+    //  for drawing between tics, see r_interp.c.
+    // Last, savegames stop at oldx.
+    fixed_t		oldx;
+    fixed_t		oldy;
+    fixed_t		oldz;
+    angle_t		oldangle;
     
 } mobj_t;
 
@@ -24,6 +24,8 @@
 static const char __attribute__((unused))
 rcsid[] = "$Id: p_tick.c,v 1.4 1997/02/03 16:47:55 b1 Exp $";
 
+#include <stddef.h>
+
 #include "i_system.h"
 #include "z_zone.h"
 #include "p_local.h"
@@ -31,6 +33,7 @@ rcsid[] = "$Id: p_tick.c,v 1.4 1997/02/03 16:47:55 b1 Exp $";
 // State.
 #include "doomstat.h"
 #include "r_state.h"
+#include "r_interp.h"
 
 byte*		save_p;
 
@@ -39,6 +42,10 @@ byte*		save_p;
 //  so that the load/save works on SGI&Gecko.
 #define PADSAVEP()	save_p += (4 - ((size_t) save_p & 3)) & 3
 
+// mobj_t as it was before the interpolation state,
+//  which is not saved, so old savegames still load.
+#define SAVEMOBJSIZE	offsetof(mobj_t, oldx)
+
 
 
 //
@@ -242,8 +249,8 @@ void P_ArchiveThinkers (void)
 	    *save_p++ = tc_mobj;
 	    PADSAVEP();
 	    mobj = (mobj_t *)save_p;
-	    memcpy (mobj, th, sizeof(*mobj));
-	    save_p += sizeof(*mobj);
+	    memcpy (mobj, th, SAVEMOBJSIZE);
+	    save_p += SAVEMOBJSIZE;
 	    mobj->state = (state_t *)(mobj->state - states);
 	    
 	    if (mobj->player)
@@ -297,8 +304,8 @@ void P_UnArchiveThinkers (void)
 	  case tc_mobj:
 	    PADSAVEP();
 	    mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
-	    memcpy (mobj, save_p, sizeof(*mobj));
-	    save_p += sizeof(*mobj);
+	    memcpy (mobj, save_p, SAVEMOBJSIZE);
+	    save_p += SAVEMOBJSIZE;
 	    mobj->state = &states[(size_t)mobj->state];
 	    mobj->target = NULL;
 	    if (mobj->player)
@@ -307,6 +314,7 @@ void P_UnArchiveThinkers (void)
 		mobj->player->mo = mobj;
 	    }
 	    P_SetThingPosition (mobj);
+	    R_SnapMobj (mobj);
 	    mobj->info = &mobjinfo[mobj->type];
 	    mobj->floorz = mobj->subsector->sector->floorheight;
 	    mobj->ceilingz = mobj->subsector->sector->ceilingheight;
@@ -43,6 +43,8 @@ rcsid[] = "$Id: p_setup.c,v 1.5 1997/02/03 22:45:12 b1 Exp $";
 
 #include "s_sound.h"
 
+#include "r_interp.h"
+
 #include "doomstat.h"
 
 
@@ -312,6 +314,7 @@ void P_LoadThings (int lump)
     byte*		data;
     int			i;
     mapthing_t*		mt;
+    mapthing_t		spawnthing;
     int			numthings;
     boolean		spawn;
 	
@@ -346,13 +349,14 @@ void P_LoadThings (int lump)
 	    break;
 
 	// Do spawn all other stuff. 
-	mt->x = SHORT(mt->x);
-	mt->y = SHORT(mt->y);
-	mt->angle = SHORT(mt->angle);
-	mt->type = SHORT(mt->type);
-	mt->options = SHORT(mt->options);
-	
-	P_SpawnMapThing (mt);
+	// The lump may be mapped read only, swap a copy.
+	spawnthing.x = SHORT(mt->x);
+	spawnthing.y = SHORT(mt->y);
+	spawnthing.angle = SHORT(mt->angle);
+	spawnthing.type = SHORT(mt->type);
+	spawnthing.options = SHORT(mt->options);
+	
+	P_SpawnMapThing (&spawnthing);
     }
 	
     Z_Free (data);
@@ -486,10 +490,13 @@ void P_LoadBlockMap (int lump)
 {
     int		i;
     int		count;
-	
-    blockmaplump = W_CacheLumpNum (lump,PU_LEVEL);
+
+    // swapped in place, so not the cached lump
+    count = W_LumpLength (lump);
+    blockmaplump = Z_Malloc (count, PU_LEVEL, 0);
+    W_ReadLump (lump, blockmaplump);
     blockmap = blockmaplump+4;
-    count = W_LumpLength (lump)/2;
+    count /= 2;
 
     for (i=0 ; i<count ; i++)
 	blockmaplump[i] = SHORT(blockmaplump[i]);
@@ -622,6 +629,9 @@ P_SetupLevel
     // Make sure all sounds are stopped before Z_FreeTags.
     S_Start ();			
 
+    // nothing is read ahead for the last level
+    W_StopPrefetch ();
+
     
 #if 0 // UNUSED
     if (debugfile)
@@ -633,8 +643,10 @@ P_SetupLevel
 #endif
 	Z_FreeTags (PU_LEVEL, PU_PURGELEVEL-1);
 
+    // the last level may have grown the zone
+    Z_ReleaseRegions ();
+
 
-    // UNUSED W_Profile ();
     P_InitThinkers ();
 
     // if working with a devlopment map, reload it
@@ -704,6 +716,9 @@ P_SetupLevel
     if (precache)
 	R_PrecacheLevel ();
 
+    // nothing to draw between yet
+    R_SnapInterpolation ();
+
     //printf ("free memory: 0x%x\n", Z_FreeMemory());
 
 }
@@ -38,6 +38,7 @@ rcsid[] = "$Id: p_telept.c,v 1.3 1997/01/28 22:08:29 b1 Exp $";
 
 // State.
 #include "r_state.h"
+#include "r_interp.h"
 
 
 
@@ -123,6 +124,9 @@ EV_Teleport
 
 		thing->angle = m->angle;
 		thing->momx = thing->momy = thing->momz = 0;
+
+		// don't draw it sliding across the map
+		R_SnapMobj (thing);
 		return 1;
 	    }	
 	}
@@ -30,6 +30,8 @@ rcsid[] = "$Id: p_tick.c,v 1.4 1997/02/03 16:47:55 b1 Exp $";
 
 #include "doomstat.h"
 
+#include "r_interp.h"
+
 
 int	leveltime;
 
@@ -130,6 +132,10 @@ void P_RunThinkers (void)
 void P_Ticker (void)
 {
     int		i;
+
+    // start of the tic, for drawing between tics
+    if (uncapped)
+	R_SnapInterpolation ();
     
     // run the tic
     if (paused)
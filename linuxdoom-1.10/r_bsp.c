@@ -31,6 +31,7 @@ rcsid[] = "$Id: r_bsp.c,v 1.4 1997/02/03 22:45:12 b1 Exp $";
 #include "m_bbox.h"
 
 #include "i_system.h"
+#include "z_zone.h"
 
 #include "r_main.h"
 #include "r_plane.h"
@@ -40,6 +41,8 @@ rcsid[] = "$Id: r_bsp.c,v 1.4 1997/02/03 22:45:12 b1 Exp $";
 #include "doomstat.h"
 #include "r_state.h"
 
+#include "v_video.h"
+
 //#include "r_local.h"
 
 
@@ -85,11 +88,13 @@ typedef	struct
 } cliprange_t;
 
 
-#define MAXSEGS		32
+// Ranges are merged when they touch, so there is
+//  at most one per two columns, plus the two ends.
+#define MAXSEGS		(screenwidth/2+3)
 
 // newend is one past the last valid seg
 cliprange_t*	newend;
-cliprange_t	solidsegs[MAXSEGS];
+cliprange_t*	solidsegs;
 
 
 
@@ -239,6 +244,16 @@ R_ClipPassWallSegment
 
 
 
+//
+// R_InitClipSegs
+// Only at game startup.
+//
+void R_InitClipSegs (void)
+{
+    solidsegs = Z_Malloc (MAXSEGS*sizeof(*solidsegs), PU_STATIC, NULL);
+}
+
+
 //
 // R_ClearClipSegs
 //
@@ -266,6 +281,7 @@ void R_AddLine (seg_t*	line)
     angle_t		tspan;
     
     curline = line;
+    linecount++;
 
     // OPTIMIZE: quickly reject orthogonal back sides.
     angle1 = R_PointToAngle (line->v1->x, line->v1->y);
@@ -57,6 +57,7 @@ typedef void (*drawfunc_t) (int start, int stop);
 
 
 // BSP?
+void R_InitClipSegs (void);
 void R_ClearClipSegs (void);
 void R_ClearDrawSegs (void);
 
@@ -0,0 +1,363 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Cache file of what the renderer works out from the wads.
+//	The texture and sprite tables, and the composite
+//	 columns of multi patch textures, are written once and
+//	 mapped on later runs, instead of parsing TEXTURE1/2,
+//	 PNAMES and every sprite lump at each startup.
+//	The file is keyed by a hash of the lump directories
+//	 of all loaded wads, a different set of wads or a
+//	 changed wad builds it again.
+//
+//-----------------------------------------------------------------------------
+
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef NORMALUNIX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "d_main.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "z_zone.h"
+#include "w_wad.h"
+
+#ifdef __GNUG__
+#pragma implementation "r_cache.h"
+#endif
+#include "r_cache.h"
+
+
+// Bump when what any section holds changes.
+#define RCACHEVERSION	1
+
+// Sections start on this.
+#define RCACHEALIGN	16
+
+typedef struct
+{
+    char		identification[8];	// "DOOMRDC"
+    int			version;
+    int			headersize;	// sizeof(rcacheheader_t)
+    unsigned long long	key;
+
+    int			offset[NUMRSECTIONS];
+    int			length[NUMRSECTIONS];
+
+} rcacheheader_t;
+
+
+static char		cachename[1024];
+static char		tempname[1024+4];
+
+// the mapped file, if it matched the wads
+static byte*		cachedata;
+static int		cachelength;
+
+// built this run, if it did not match, for newfile
+static FILE*		newfile;
+static void*		newdata[NUMRSECTIONS];
+static int		newlength[NUMRSECTIONS];
+
+
+
+//
+// R_CacheKey
+// FNV-1a of the lump directory, names,
+//  positions and sizes, and of the size and
+//  time of every wad.
+//
+static unsigned long long R_CacheKey (void)
+{
+    unsigned long long	key;
+    byte*		p;
+    int			i;
+    int			j;
+    int			fields[3];
+#ifdef NORMALUNIX
+    long long		filefields[2];
+    struct stat		st;
+    char*		name;
+#endif
+
+    key = 0xcbf29ce484222325ULL;
+
+    for (i=0 ; i<numlumps ; i++)
+    {
+	fields[0] = lumpinfo[i].position;
+	fields[1] = lumpinfo[i].size;
+	fields[2] = i;
+
+	p = (byte *)lumpinfo[i].name;
+	for (j=0 ; j<8 ; j++)
+	    key = (key ^ p[j]) * 0x100000001b3ULL;
+
+	p = (byte *)fields;
+	for (j=0 ; j<sizeof(fields) ; j++)
+	    key = (key ^ p[j]) * 0x100000001b3ULL;
+    }
+
+    // sprite lumps are looked up by name when modified
+    key = (key ^ modifiedgame) * 0x100000001b3ULL;
+
+#ifdef NORMALUNIX
+    // a patch or TEXTUREx edited in place can keep
+    //  its size and position, not the file's time
+    for (i=0 ; wadfiles[i] ; i++)
+    {
+	name = wadfiles[i];
+	if (name[0] == '~')
+	    name++;
+
+	filefields[0] = filefields[1] = -1;
+	if (stat (name, &st) != -1)
+	{
+	    filefields[0] = st.st_size;
+	    filefields[1] = st.st_mtime;
+	}
+
+	p = (byte *)filefields;
+	for (j=0 ; j<sizeof(filefields) ; j++)
+	    key = (key ^ p[j]) * 0x100000001b3ULL;
+    }
+#endif
+
+    return key;
+}
+
+
+
+#ifdef NORMALUNIX
+//
+// R_MapCache
+// False if there is no cache file for these wads.
+//
+static boolean R_MapCache (void)
+{
+    rcacheheader_t*	header;
+    struct stat		st;
+    void*		base;
+    int			handle;
+    int			i;
+
+    handle = open (cachename, O_RDONLY);
+    if (handle == -1)
+	return false;
+
+    if (fstat (handle, &st) == -1
+	|| st.st_size < sizeof(rcacheheader_t))
+    {
+	close (handle);
+	return false;
+    }
+
+    base = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, handle, 0);
+    close (handle);
+
+    if (base == MAP_FAILED)
+	return false;
+
+    header = base;
+    if (memcmp (header->identification, "DOOMRDC", 8)
+	|| header->version != RCACHEVERSION
+	|| header->headersize != sizeof(rcacheheader_t)
+	|| header->key != R_CacheKey ())
+    {
+	munmap (base, st.st_size);
+	return false;
+    }
+
+    for (i=0 ; i<NUMRSECTIONS ; i++)
+    {
+	if (header->offset[i] < sizeof(rcacheheader_t)
+	    || header->length[i] < 0
+	    || header->offset[i] + header->length[i] > st.st_size)
+	{
+	    printf ("R_OpenCache: %s is damaged\n", cachename);
+	    munmap (base, st.st_size);
+	    return false;
+	}
+    }
+
+    cachedata = base;
+    cachelength = st.st_size;
+    Z_AddMapped (cachedata, cachelength);
+    return true;
+}
+#endif
+
+
+//
+// R_OpenCache
+// A new file is opened here rather than in R_SaveCache,
+//  so nothing is built for one that can't be written.
+//
+void R_OpenCache (void)
+{
+#ifdef NORMALUNIX
+    int			length;
+    int			p;
+
+    if (M_CheckParm ("-nodatacache"))
+	return;
+
+    p = M_CheckParm ("-datacache");
+    if (p && p < myargc-1)
+	length = snprintf (cachename, sizeof(cachename), "%s", myargv[p+1]);
+    else
+	length = snprintf (cachename, sizeof(cachename), "%s.cache", basedefault);
+
+    if (length >= sizeof(cachename))
+    {
+	printf ("R_OpenCache: the cache file name is too long\n");
+	return;
+    }
+
+    if (R_MapCache ())
+	return;
+
+    snprintf (tempname, sizeof(tempname), "%s.new", cachename);
+    newfile = fopen (tempname, "wb");
+    if (!newfile)
+	printf ("R_OpenCache: couldn't write %s\n", tempname);
+#endif
+}
+
+
+//
+// R_CacheEnabled
+//
+boolean R_CacheEnabled (void)
+{
+    return newfile != NULL;
+}
+
+
+//
+// R_CacheSection
+//
+void* R_CacheSection (rsection_t section, int* length)
+{
+    rcacheheader_t*	header;
+
+    if (!cachedata)
+	return NULL;
+
+    header = (rcacheheader_t *)cachedata;
+    *length = header->length[section];
+
+    return cachedata + header->offset[section];
+}
+
+
+//
+// R_AddSection
+//
+void
+R_AddSection
+( rsection_t	section,
+  void*		data,
+  int		length )
+{
+    if (newdata[section])
+	Z_Free (newdata[section]);
+
+    newdata[section] = data;
+    newlength[section] = length;
+}
+
+
+//
+// R_SaveCache
+// To a new file that is renamed over the old one,
+//  another copy of the game may have it mapped.
+//
+void R_SaveCache (void)
+{
+    rcacheheader_t	header;
+    FILE*		f;
+    static byte		pad[RCACHEALIGN];
+    int			offset;
+    int			i;
+
+    for (i=0 ; i<NUMRSECTIONS ; i++)
+	if (!newdata[i])
+	    break;
+
+    if (i < NUMRSECTIONS || !newfile)
+    {
+	for (i=0 ; i<NUMRSECTIONS ; i++)
+	    R_AddSection (i, NULL, 0);
+	if (newfile)
+	{
+	    fclose (newfile);
+	    remove (tempname);
+	    newfile = NULL;
+	}
+	return;
+    }
+
+    memset (&header, 0, sizeof(header));
+    memcpy (header.identification, "DOOMRDC", 8);
+    header.version = RCACHEVERSION;
+    header.headersize = sizeof(header);
+    header.key = R_CacheKey ();
+
+    offset = sizeof(header);
+    for (i=0 ; i<NUMRSECTIONS ; i++)
+    {
+	offset = (offset + RCACHEALIGN-1) & ~(RCACHEALIGN-1);
+	header.offset[i] = offset;
+	header.length[i] = newlength[i];
+	offset += newlength[i];
+    }
+
+    f = newfile;
+    newfile = NULL;
+
+    fwrite (&header, sizeof(header), 1, f);
+    offset = sizeof(header);
+    for (i=0 ; i<NUMRSECTIONS ; i++)
+    {
+	fwrite (pad, header.offset[i] - offset, 1, f);
+	fwrite (newdata[i], newlength[i], 1, f);
+	offset = header.offset[i] + newlength[i];
+
+	R_AddSection (i, NULL, 0);
+    }
+
+    if (fclose (f) || rename (tempname, cachename))
+    {
+	printf ("R_SaveCache: couldn't write %s\n", cachename);
+	remove (tempname);
+    }
+}
@@ -0,0 +1,77 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// DESCRIPTION:
+//	Cache file of what the renderer works out from the wads.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __R_CACHE__
+#define __R_CACHE__
+
+
+#ifdef __GNUG__
+#pragma interface
+#endif
+
+
+#include "doomtype.h"
+
+
+//
+// Sections of the cache file, each is written
+//  and read back by the module it belongs to.
+//
+typedef enum
+{
+    rs_textures,	// texture_t, column lumps and offsets
+    rs_composites,	// composite columns of every texture
+    rs_spritelumps,	// sprite widths and offsets
+    rs_spritedefs,	// sprite frames and rotations
+    NUMRSECTIONS
+
+} rsection_t;
+
+
+// Maps the cache file if it was made for the wads that
+//  are loaded. -datacache <file> names it, -nodatacache
+//  neither reads nor writes one.
+// After W_Init, before R_InitData.
+void R_OpenCache (void);
+
+// True if the sections are to be built, for a file
+//  that did not match the wads and can be written.
+// Nothing is added when it is false.
+boolean R_CacheEnabled (void);
+
+// The section from the file, NULL if there is none.
+// The memory is mapped read only and stays mapped.
+void* R_CacheSection (rsection_t section, int* length);
+
+// A section built this run, for R_SaveCache.
+// data is a PU_STATIC block, freed when it is written.
+void R_AddSection (rsection_t section, void* data, int length);
+
+// Writes the file when every section was built
+//  instead of read, after P_Init.
+void R_SaveCache (void);
+
+
+#endif
+//-----------------------------------------------------------------------------
+//
+// $Log:$
+//
+//-----------------------------------------------------------------------------
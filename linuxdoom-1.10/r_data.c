@@ -28,6 +28,7 @@ static const char __attribute__((unused))
 rcsid[] = "$Id: r_data.c,v 1.4 1997/02/03 16:47:55 b1 Exp $";
 
 #include "i_system.h"
+#include "m_argv.h"
 #include "z_zone.h"
 
 #include "m_swap.h"
@@ -48,6 +49,7 @@ rcsid[] = "$Id: r_data.c,v 1.4 1997/02/03 16:47:55 b1 Exp $";
 
 
 #include "r_data.h"
+#include "r_cache.h"
 
 //
 // Graphics.
@@ -129,6 +131,9 @@ typedef struct
     
 } texture_t;
 
+#define TEXTURESIZE(patchcount) \
+    (sizeof(texture_t) + sizeof(texpatch_t)*((patchcount)-1))
+
 
 
 int		firstflat;
@@ -401,6 +406,8 @@ R_GetColumn
 
     if (!texturecomposite[tex])
 	R_GenerateComposite (tex);
+    else
+	Z_ChangeTag (texturecomposite[tex], PU_CACHE);
 
     return texturecomposite[tex] + ofs;
 }
@@ -409,11 +416,46 @@ R_GetColumn
 
 
 //
-// R_InitTextures
-// Initializes the texture list
-//  with the textures from the world map.
+// R_AllocTextures
+// The tables by texture number, for numtextures.
 //
-void R_InitTextures (void)
+static void R_AllocTextures (void)
+{
+    // FIX: memory corruption due to using 4 instead of sizeof
+    textures = Z_Malloc (numtextures*sizeof(*textures), PU_STATIC, 0);
+    texturecolumnlump = Z_Malloc (numtextures*sizeof(*texturecolumnlump), PU_STATIC, 0);
+    texturecolumnofs = Z_Malloc (numtextures*sizeof(*texturecolumnofs), PU_STATIC, 0);
+    texturecomposite = Z_Malloc (numtextures*sizeof(*texturecomposite), PU_STATIC, 0);
+    texturecompositesize = Z_Malloc (numtextures*sizeof(*texturecompositesize), PU_STATIC, 0);
+    texturewidthmask = Z_Malloc (numtextures*sizeof(*texturewidthmask), PU_STATIC, 0);
+    textureheight = Z_Malloc (numtextures*sizeof(*textureheight), PU_STATIC, 0);
+}
+
+
+//
+// R_SetTextureSize
+//
+static void R_SetTextureSize (int texnum)
+{
+    texture_t*	texture;
+    int		j;
+
+    texture = textures[texnum];
+
+    j = 1;
+    while (j*2 <= texture->width)
+	j<<=1;
+
+    texturewidthmask[texnum] = j-1;
+    textureheight[texnum] = texture->height<<FRACBITS;
+}
+
+
+//
+// R_ParseTextures
+// Builds the texture list from TEXTURE1/2 and PNAMES.
+//
+static void R_ParseTextures (void)
 {
     maptexture_t*	mtexture;
     texture_t*		texture;
@@ -483,15 +525,7 @@ void R_InitTextures (void)
 	maxoff2 = 0;
     }
     numtextures = numtextures1 + numtextures2;
-	
-    // FIX: memory corruption due to using 4 instead of sizeof
-    textures = Z_Malloc (numtextures*sizeof(*textures), PU_STATIC, 0);
-    texturecolumnlump = Z_Malloc (numtextures*sizeof(*texturecolumnlump), PU_STATIC, 0);
-    texturecolumnofs = Z_Malloc (numtextures*sizeof(*texturecolumnofs), PU_STATIC, 0);
-    texturecomposite = Z_Malloc (numtextures*sizeof(*texturecomposite), PU_STATIC, 0);
-    texturecompositesize = Z_Malloc (numtextures*sizeof(*texturecompositesize), PU_STATIC, 0);
-    texturewidthmask = Z_Malloc (numtextures*sizeof(*texturewidthmask), PU_STATIC, 0);
-    textureheight = Z_Malloc (numtextures*sizeof(*textureheight), PU_STATIC, 0);
+    R_AllocTextures ();
 
     //totalwidth = 0;
     
@@ -528,8 +562,7 @@ void R_InitTextures (void)
 	mtexture = (maptexture_t *) ( (byte *)maptex + offset);
 
 	texture = textures[i] =
-	    Z_Malloc (sizeof(texture_t)
-		      + sizeof(texpatch_t)*(SHORT(mtexture->patchcount)-1),
+	    Z_Malloc (TEXTURESIZE(SHORT(mtexture->patchcount)),
 		      PU_STATIC, 0);
 	
 	texture->width = SHORT(mtexture->width);
@@ -554,12 +587,7 @@ void R_InitTextures (void)
 	texturecolumnlump[i] = Z_Malloc (texture->width*sizeof(short), PU_STATIC,0);
 	texturecolumnofs[i] = Z_Malloc (texture->width*sizeof(short), PU_STATIC,0);
 
-	j = 1;
-	while (j*2 <= texture->width)
-	    j<<=1;
-
-	texturewidthmask[i] = j-1;
-	textureheight[i] = texture->height<<FRACBITS;
+	R_SetTextureSize (i);
 		
 	//totalwidth += texture->width;
     }
@@ -571,6 +599,156 @@ void R_InitTextures (void)
     // Precalculate whatever possible.	
     for (i=0 ; i<numtextures ; i++)
 	R_GenerateLookup (i);
+}
+
+
+//
+// R_LoadTextures
+// The texture list from the cache file, used in place.
+// The composites are in it as well, none are made
+//  during play.
+//
+static boolean R_LoadTextures (void)
+{
+    texture_t*		texture;
+    byte*		start;
+    byte*		p;
+    byte*		end;
+    byte*		composite;
+    byte*		compositeend;
+    int			length;
+    int			i;
+
+    p = start = R_CacheSection (rs_textures, &length);
+    if (!p)
+	return false;
+    end = p + length;
+
+    composite = R_CacheSection (rs_composites, &length);
+    compositeend = composite + length;
+
+    numtextures = *(int *)p;
+    p += sizeof(int);
+
+    R_AllocTextures ();
+
+    for (i=0 ; i<numtextures && p < end ; i++)
+    {
+	texture = textures[i] = (texture_t *)p;
+	p += TEXTURESIZE(texture->patchcount);
+
+	texturecompositesize[i] = *(int *)p;
+	p += sizeof(int);
+
+	texturecolumnlump[i] = (short *)p;
+	p += texture->width*sizeof(short);
+	texturecolumnofs[i] = (unsigned short *)p;
+	p += texture->width*sizeof(short);
+	p = start + ((p - start + 3) & ~3);
+
+	texturecomposite[i] = 0;
+	if (texturecompositesize[i])
+	{
+	    texturecomposite[i] = composite;
+	    composite += texturecompositesize[i];
+	}
+
+	R_SetTextureSize (i);
+    }
+
+    if (i < numtextures || p != end || composite != compositeend)
+	I_Error ("R_LoadTextures: the texture cache is damaged, "
+		 "delete it or use -nodatacache");
+
+    return true;
+}
+
+
+//
+// R_SaveTextures
+// For the cache file. Every composite is made now,
+//  rather than the first time it is seen.
+//
+static void R_SaveTextures (void)
+{
+    texture_t*		texture;
+    byte*		data;
+    byte*		p;
+    int			length;
+    int			i;
+
+    length = sizeof(int);
+    for (i=0 ; i<numtextures ; i++)
+    {
+	texture = textures[i];
+	length += TEXTURESIZE(texture->patchcount) + sizeof(int)
+	    + texture->width*2*sizeof(short);
+	length = (length + 3) & ~3;
+    }
+
+    data = p = Z_Malloc (length, PU_STATIC, 0);
+
+    *(int *)p = numtextures;
+    p += sizeof(int);
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	texture = textures[i];
+	memcpy (p, texture, TEXTURESIZE(texture->patchcount));
+	p += TEXTURESIZE(texture->patchcount);
+
+	*(int *)p = texturecompositesize[i];
+	p += sizeof(int);
+
+	memcpy (p, texturecolumnlump[i], texture->width*sizeof(short));
+	p += texture->width*sizeof(short);
+	memcpy (p, texturecolumnofs[i], texture->width*sizeof(short));
+	p += texture->width*sizeof(short);
+
+	while ((p - data) & 3)
+	    *p++ = 0;
+    }
+
+    R_AddSection (rs_textures, data, length);
+
+    length = 0;
+    for (i=0 ; i<numtextures ; i++)
+	length += texturecompositesize[i];
+
+    data = p = Z_Malloc (length, PU_STATIC, 0);
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+	if (!texturecompositesize[i])
+	    continue;
+
+	// made one at a time, the last
+	//  one may be purged by the next
+	if (!texturecomposite[i])
+	    R_GenerateComposite (i);
+	memcpy (p, texturecomposite[i], texturecompositesize[i]);
+	p += texturecompositesize[i];
+    }
+
+    R_AddSection (rs_composites, data, length);
+}
+
+
+//
+// R_InitTextures
+// Initializes the texture list
+//  with the textures from the world map.
+//
+void R_InitTextures (void)
+{
+    int			i;
+
+    if (!R_LoadTextures ())
+    {
+	R_ParseTextures ();
+	if (R_CacheEnabled ())
+	    R_SaveTextures ();
+    }
     
     // Create translation table for global animation.
     texturetranslation = Z_Malloc ((numtextures+1)*sizeof(*texturetranslation), PU_STATIC, 0);
@@ -609,15 +787,31 @@ void R_InitFlats (void)
 void R_InitSpriteLumps (void)
 {
     int		i;
+    int		size;
+    int		length;
     patch_t	*patch;
 	
     firstspritelump = W_GetNumForName ("S_START") + 1;
     lastspritelump = W_GetNumForName ("S_END") - 1;
     
     numspritelumps = lastspritelump - firstspritelump + 1;
-    spritewidth = Z_Malloc (numspritelumps*sizeof(*spritewidth), PU_STATIC, 0);
-    spriteoffset = Z_Malloc (numspritelumps*sizeof(*spriteoffset), PU_STATIC, 0);
-    spritetopoffset = Z_Malloc (numspritelumps*sizeof(*spritetopoffset), PU_STATIC, 0);
+
+    // all three tables in one block, as in the cache file
+    size = 3*numspritelumps*sizeof(fixed_t);
+    spritewidth = R_CacheSection (rs_spritelumps, &length);
+    if (spritewidth)
+    {
+	if (length != size)
+	    I_Error ("R_InitSpriteLumps: the sprite cache is damaged, "
+		     "delete it or use -nodatacache");
+	spriteoffset = spritewidth + numspritelumps;
+	spritetopoffset = spriteoffset + numspritelumps;
+	return;
+    }
+
+    spritewidth = Z_Malloc (size, PU_STATIC, 0);
+    spriteoffset = spritewidth + numspritelumps;
+    spritetopoffset = spriteoffset + numspritelumps;
 	
     for (i=0 ; i< numspritelumps ; i++)
     {
@@ -629,6 +823,14 @@ void R_InitSpriteLumps (void)
 	spriteoffset[i] = SHORT(patch->leftoffset)<<FRACBITS;
 	spritetopoffset[i] = SHORT(patch->topoffset)<<FRACBITS;
     }
+
+    if (!R_CacheEnabled ())
+	return;
+
+    // the tables stay in use, the cache file gets a copy
+    patch = Z_Malloc (size, PU_STATIC, 0);
+    memcpy (patch, spritewidth, size);
+    R_AddSection (rs_spritelumps, patch, size);
 }
 
 
@@ -659,6 +861,10 @@ void R_InitColormaps (void)
 //
 void R_InitData (void)
 {
+    prefetch = !M_CheckParm ("-noprefetch");
+
+    R_OpenCache ();
+
     R_InitTextures ();
     printf ("\nInitTextures");
     R_InitFlats ();
@@ -741,60 +947,138 @@ int	R_TextureNumForName (char* name)
 //
 // R_PrecacheLevel
 // Preloads all relevant graphics for the level.
+// The lumps are read in the background, nearest to the
+//  player first, and the level starts right away.
+//  -noprefetch reads them all before it does.
 //
 int		flatmemory;
 int		texturememory;
 int		spritememory;
 
+boolean		prefetch;
+
+// distance from the player, by lump
+static int*	lumpdistance;
+
+
+static int R_ComparePrecache (const void* a, const void* b)
+{
+    return lumpdistance[*(int *)a] - lumpdistance[*(int *)b];
+}
+
+
+//
+// R_PrecacheDistance
+// From the player, in map units, 0 if there is none.
+//
+static int
+R_PrecacheDistance
+( fixed_t	x,
+  fixed_t	y )
+{
+    mobj_t*	mo;
+
+    mo = players[consoleplayer].mo;
+    if (!mo)
+	return 0;
+
+    return P_AproxDistance (x - mo->x, y - mo->y) >> FRACBITS;
+}
+
+
+//
+// R_PrecacheLump
+// Keeps the nearest distance the lump is used at.
+//
+static void
+R_PrecacheLump
+( int		lump,
+  int		distance,
+  int*		memory )
+{
+    if (lumpdistance[lump] == MAXINT)
+	*memory += lumpinfo[lump].size;
+
+    if (distance < lumpdistance[lump])
+	lumpdistance[lump] = distance;
+}
+
+
 void R_PrecacheLevel (void)
 {
-    char*		flatpresent;
-    char*		texturepresent;
-    char*		spritepresent;
+    int*		flatdistance;
+    int*		texturedistance;
+    int*		spritedistance;
+    int*		lumps;
+    int			numprecache;
 
     int			i;
     int			j;
     int			k;
+    int			d;
     int			lump;
     
     texture_t*		texture;
     thinker_t*		th;
+    mobj_t*		mo;
+    line_t*		li;
+    sector_t*		sec;
     spriteframe_t*	sf;
 
-    if (demoplayback)
+    if (demoplayback && !prefetch)
 	return;
-    
+
+    lumpdistance = Z_Malloc (numlumps*sizeof(*lumpdistance), PU_STATIC, 0);
+    for (i=0 ; i<numlumps ; i++)
+	lumpdistance[i] = MAXINT;
+
     // Precache flats.
-    flatpresent = alloca(numflats);
-    memset (flatpresent,0,numflats);	
+    flatdistance = alloca(numflats*sizeof(*flatdistance));
+    for (i=0 ; i<numflats ; i++)
+	flatdistance[i] = MAXINT;
 
-    for (i=0 ; i<numsectors ; i++)
+    for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
     {
-	flatpresent[sectors[i].floorpic] = 1;
-	flatpresent[sectors[i].ceilingpic] = 1;
+	d = R_PrecacheDistance (sec->soundorg.x, sec->soundorg.y);
+	if (d < flatdistance[sec->floorpic])
+	    flatdistance[sec->floorpic] = d;
+	if (d < flatdistance[sec->ceilingpic])
+	    flatdistance[sec->ceilingpic] = d;
     }
 	
     flatmemory = 0;
 
     for (i=0 ; i<numflats ; i++)
     {
-	if (flatpresent[i])
-	{
-	    lump = firstflat + i;
-	    flatmemory += lumpinfo[lump].size;
-	    W_CacheLumpNum(lump, PU_CACHE);
-	}
+	if (flatdistance[i] != MAXINT)
+	    R_PrecacheLump (firstflat + i, flatdistance[i], &flatmemory);
     }
     
     // Precache textures.
-    texturepresent = alloca(numtextures);
-    memset (texturepresent,0, numtextures);
+    texturedistance = alloca(numtextures*sizeof(*texturedistance));
+    for (i=0 ; i<numtextures ; i++)
+	texturedistance[i] = MAXINT;
 	
-    for (i=0 ; i<numsides ; i++)
+    for (i=0, li=lines ; i<numlines ; i++, li++)
     {
-	texturepresent[sides[i].toptexture] = 1;
-	texturepresent[sides[i].midtexture] = 1;
-	texturepresent[sides[i].bottomtexture] = 1;
+	d = R_PrecacheDistance (li->v1->x/2 + li->v2->x/2,
+				li->v1->y/2 + li->v2->y/2);
+
+	for (j=0 ; j<2 ; j++)
+	{
+	    if (li->sidenum[j] == -1)
+		continue;
+
+	    k = sides[li->sidenum[j]].toptexture;
+	    if (d < texturedistance[k])
+		texturedistance[k] = d;
+	    k = sides[li->sidenum[j]].midtexture;
+	    if (d < texturedistance[k])
+		texturedistance[k] = d;
+	    k = sides[li->sidenum[j]].bottomtexture;
+	    if (d < texturedistance[k])
+		texturedistance[k] = d;
+	}
     }
 
     // Sky texture is always present.
@@ -803,38 +1087,43 @@ void R_PrecacheLevel (void)
     //  while the sky texture is stored like
     //  a wall texture, with an episode dependend
     //  name.
-    texturepresent[skytexture] = 1;
+    texturedistance[skytexture] = 0;
 	
     texturememory = 0;
     for (i=0 ; i<numtextures ; i++)
     {
-	if (!texturepresent[i])
+	if (texturedistance[i] == MAXINT)
 	    continue;
 
 	texture = textures[i];
 	
 	for (j=0 ; j<texture->patchcount ; j++)
 	{
-	    lump = texture->patches[j].patch;
-	    texturememory += lumpinfo[lump].size;
-	    W_CacheLumpNum(lump , PU_CACHE);
+	    R_PrecacheLump (texture->patches[j].patch,
+			    texturedistance[i], &texturememory);
 	}
     }
     
     // Precache sprites.
-    spritepresent = alloca(numsprites);
-    memset (spritepresent,0, numsprites);
+    spritedistance = alloca(numsprites*sizeof(*spritedistance));
+    for (i=0 ; i<numsprites ; i++)
+	spritedistance[i] = MAXINT;
 	
     for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
     {
-	if (th->function.acp1 == (actionf_p1)P_MobjThinker)
-	    spritepresent[((mobj_t *)th)->sprite] = 1;
+	if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+	    continue;
+
+	mo = (mobj_t *)th;
+	d = R_PrecacheDistance (mo->x, mo->y);
+	if (d < spritedistance[mo->sprite])
+	    spritedistance[mo->sprite] = d;
     }
 	
     spritememory = 0;
     for (i=0 ; i<numsprites ; i++)
     {
-	if (!spritepresent[i])
+	if (spritedistance[i] == MAXINT)
 	    continue;
 
 	for (j=0 ; j<sprites[i].numframes ; j++)
@@ -843,11 +1132,33 @@ void R_PrecacheLevel (void)
 	    for (k=0 ; k<8 ; k++)
 	    {
 		lump = firstspritelump + sf->lump[k];
-		spritememory += lumpinfo[lump].size;
-		W_CacheLumpNum(lump , PU_CACHE);
+		R_PrecacheLump (lump, spritedistance[i], &spritememory);
 	    }
 	}
     }
+
+    // Nearest first.
+    lumps = Z_Malloc (numlumps*sizeof(*lumps), PU_STATIC, 0);
+    numprecache = 0;
+    for (i=0 ; i<numlumps ; i++)
+	if (lumpdistance[i] != MAXINT)
+	    lumps[numprecache++] = i;
+
+    qsort (lumps, numprecache, sizeof(*lumps), R_ComparePrecache);
+
+    for (i=0 ; i<numprecache ; i++)
+    {
+	if (prefetch)
+	    W_PrefetchLump (lumps[i]);
+	else
+	    W_CacheLumpNum (lumps[i], PU_CACHE);
+    }
+
+    if (prefetch)
+	W_UpdatePrefetch ();
+
+    Z_Free (lumps);
+    Z_Free (lumpdistance);
 }
 
 
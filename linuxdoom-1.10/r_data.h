@@ -42,6 +42,10 @@ R_GetColumn
 void R_InitData (void);
 void R_PrecacheLevel (void);
 
+// False with -noprefetch, R_PrecacheLevel then waits
+//  for every lump to be read.
+extern boolean	prefetch;
+
 
 // Retrieval.
 // Floor/ceiling opaque texture tiles,
@@ -131,6 +131,12 @@ typedef	struct
 
     int			linecount;
     struct line_s**	lines;	// [linecount] size
+
+    // for drawing between tics, see r_interp.c
+    fixed_t	oldfloorheight;
+    fixed_t	oldceilingheight;
+    fixed_t	realfloorheight;
+    fixed_t	realceilingheight;
     
 } sector_t;
 
@@ -376,10 +382,6 @@ typedef struct
 // I.e. a sprite object that is partly visible.
 typedef struct vissprite_s
 {
-    // Doubly linked list.
-    struct vissprite_s*	prev;
-    struct vissprite_s*	next;
-    
     int			x1;
     int			x2;
 
@@ -459,25 +461,23 @@ typedef struct
 //
 // Now what is a visplane, anyway?
 // 
-typedef struct
+typedef struct visplane_s
 {
   fixed_t		height;
   int			picnum;
   int			lightlevel;
+
+  // next plane in the same hash chain
+  struct visplane_s*	next;
+
   int			minx;
   int			maxx;
   
-  // leave pads for [minx-1]/[maxx+1]
-  
-  byte		pad1;
-  // Here lies the rub for all
-  //  dynamic resize/change of resolution.
-  byte		top[SCREENWIDTH];
-  byte		pad2;
-  byte		pad3;
-  // See above.
-  byte		bottom[SCREENWIDTH];
-  byte		pad4;
+  // screenwidth entries each, from the frame arena,
+  //  with pads for [minx-1]/[maxx+1].
+  // 0xffff in top is an unused column.
+  unsigned short*	top;
+  unsigned short*	bottom;
 
 } visplane_t;
 
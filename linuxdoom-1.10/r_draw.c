@@ -33,8 +33,10 @@ rcsid[] = "$Id: r_draw.c,v 1.4 1997/02/03 16:47:55 b1 Exp $";
 #include "i_system.h"
 #include "z_zone.h"
 #include "w_wad.h"
+#include "m_argv.h"
 
 #include "r_local.h"
+#include "r_simd.h"
 
 // Needs access to LFB (guess what).
 #include "v_video.h"
@@ -43,10 +45,6 @@ rcsid[] = "$Id: r_draw.c,v 1.4 1997/02/03 16:47:55 b1 Exp $";
 #include "doomstat.h"
 
 
-// ?
-#define MAXWIDTH			1120
-#define MAXHEIGHT			832
-
 // status bar height at bottom of screen
 #define SBARHEIGHT		32
 
@@ -66,8 +64,19 @@ int		scaledviewwidth;
 int		viewheight;
 int		viewwindowx;
 int		viewwindowy; 
-byte*		ylookup[MAXHEIGHT]; 
-int		columnofs[MAXWIDTH]; 
+byte**		ylookup; 
+int*		columnofs; 
+
+//
+// With -colmajor the view is drawn into viewbuffer
+//  one contiguous column after the other,
+//  and R_TransposeView copies it into screens[0].
+// The drawers step by rowstride and colstride.
+//
+boolean		colmajor;
+byte*		viewbuffer;
+int		rowstride;
+int		colstride;
 
 // Color tables for different players,
 //  translate a limited part to another
@@ -82,15 +91,15 @@ byte		translations[3][256];
 // R_DrawColumn
 // Source is the top of the column to scale.
 //
-lighttable_t*		dc_colormap; 
-int			dc_x; 
-int			dc_yl; 
-int			dc_yh; 
-fixed_t			dc_iscale; 
-fixed_t			dc_texturemid;
+_Thread_local lighttable_t*		dc_colormap; 
+_Thread_local int			dc_x; 
+_Thread_local int			dc_yl; 
+_Thread_local int			dc_yh; 
+_Thread_local fixed_t			dc_iscale; 
+_Thread_local fixed_t			dc_texturemid;
 
 // first pixel in a column (possibly virtual) 
-byte*			dc_source;		
+_Thread_local byte*			dc_source;		
 
 // just for profiling 
 int			dccount;
@@ -108,6 +117,7 @@ void R_DrawColumn (void)
     byte*		dest; 
     fixed_t		frac;
     fixed_t		fracstep;	 
+    int			stride;
  
     count = dc_yh - dc_yl; 
 
@@ -116,9 +126,9 @@ void R_DrawColumn (void)
 	return; 
 				 
 #ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
+    if ((unsigned)dc_x >= screenwidth
 	|| dc_yl < 0
-	|| dc_yh >= SCREENHEIGHT) 
+	|| dc_yh >= screenheight) 
 	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x); 
 #endif 
 
@@ -132,6 +142,9 @@ void R_DrawColumn (void)
     fracstep = dc_iscale; 
     frac = dc_texturemid + (dc_yl-centery)*fracstep; 
 
+    // Down one row, screenwidth unless column major.
+    stride = rowstride;
+
     // Inner loop that does the actual texture mapping,
     //  e.g. a DDA-lile scaling.
     // This is as fast as it gets.
@@ -141,7 +154,7 @@ void R_DrawColumn (void)
 	//  using a lighting/special effects LUT.
 	*dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
 	
-	dest += SCREENWIDTH; 
+	dest += stride; 
 	frac += fracstep;
 	
     } while (count--); 
@@ -181,26 +194,26 @@ void R_DrawColumn (void)
     while (count >= 8) 
     { 
 	dest[0] = colormap[source[frac>>25]]; 
-	dest[SCREENWIDTH] = colormap[source[(frac+fracstep)>>25]]; 
-	dest[SCREENWIDTH*2] = colormap[source[(frac+fracstep2)>>25]]; 
-	dest[SCREENWIDTH*3] = colormap[source[(frac+fracstep3)>>25]];
+	dest[screenwidth] = colormap[source[(frac+fracstep)>>25]]; 
+	dest[screenwidth*2] = colormap[source[(frac+fracstep2)>>25]]; 
+	dest[screenwidth*3] = colormap[source[(frac+fracstep3)>>25]];
 	
 	frac += fracstep4; 
 
-	dest[SCREENWIDTH*4] = colormap[source[frac>>25]]; 
-	dest[SCREENWIDTH*5] = colormap[source[(frac+fracstep)>>25]]; 
-	dest[SCREENWIDTH*6] = colormap[source[(frac+fracstep2)>>25]]; 
-	dest[SCREENWIDTH*7] = colormap[source[(frac+fracstep3)>>25]]; 
+	dest[screenwidth*4] = colormap[source[frac>>25]]; 
+	dest[screenwidth*5] = colormap[source[(frac+fracstep)>>25]]; 
+	dest[screenwidth*6] = colormap[source[(frac+fracstep2)>>25]]; 
+	dest[screenwidth*7] = colormap[source[(frac+fracstep3)>>25]]; 
 
 	frac += fracstep4; 
-	dest += SCREENWIDTH*8; 
+	dest += screenwidth*8; 
 	count -= 8;
     } 
 	
     while (count > 0)
     { 
 	*dest = colormap[source[frac>>25]]; 
-	dest += SCREENWIDTH; 
+	dest += screenwidth; 
 	frac += fracstep; 
 	count--;
     } 
@@ -215,6 +228,7 @@ void R_DrawColumnLow (void)
     byte*		dest2;
     fixed_t		frac;
     fixed_t		fracstep;	 
+    int			stride;
  
     count = dc_yh - dc_yl; 
 
@@ -223,9 +237,9 @@ void R_DrawColumnLow (void)
 	return; 
 				 
 #ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
+    if ((unsigned)dc_x >= screenwidth
 	|| dc_yl < 0
-	|| dc_yh >= SCREENHEIGHT)
+	|| dc_yh >= screenheight)
     {
 	
 	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x);
@@ -240,13 +254,14 @@ void R_DrawColumnLow (void)
     
     fracstep = dc_iscale; 
     frac = dc_texturemid + (dc_yl-centery)*fracstep;
+    stride = rowstride;
     
     do 
     {
 	// Hack. Does not work corretly.
 	*dest2 = *dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
-	dest += SCREENWIDTH;
-	dest2 += SCREENWIDTH;
+	dest += stride;
+	dest2 += stride;
 	frac += fracstep; 
 
     } while (count--);
@@ -259,6 +274,8 @@ void R_DrawColumnLow (void)
 #define FUZZTABLE		50 
 #define FUZZOFF	(SCREENWIDTH)
 
+// R_InitBuffer changes FUZZOFF to rowstride.
+
 
 int	fuzzoffset[FUZZTABLE] =
 {
@@ -271,7 +288,7 @@ int	fuzzoffset[FUZZTABLE] =
     FUZZOFF,FUZZOFF,-FUZZOFF,FUZZOFF,FUZZOFF,-FUZZOFF,FUZZOFF 
 }; 
 
-int	fuzzpos = 0; 
+_Thread_local int	fuzzpos = 0; 
 
 
 //
@@ -286,6 +303,7 @@ void R_DrawFuzzColumn (void)
 { 
     int			count; 
     byte*		dest; 
+    int			stride;
     //fixed_t		frac;      // FIX: unused (copied from R_DrawColumnLow)
     //fixed_t		fracstep;  // FIX: unused
 
@@ -305,8 +323,8 @@ void R_DrawFuzzColumn (void)
 
     
 #ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
-	|| dc_yl < 0 || dc_yh >= SCREENHEIGHT)
+    if ((unsigned)dc_x >= screenwidth
+	|| dc_yl < 0 || dc_yh >= screenheight)
     {
 	I_Error ("R_DrawFuzzColumn: %i to %i at %i",
 		 dc_yl, dc_yh, dc_x);
@@ -341,6 +359,7 @@ void R_DrawFuzzColumn (void)
     
     // Does not work with blocky mode.
     dest = ylookup[dc_yl] + columnofs[dc_x];
+    stride = rowstride;
 
     // Looks familiar.
     //fracstep = dc_iscale; 
@@ -361,7 +380,7 @@ void R_DrawFuzzColumn (void)
 	if (++fuzzpos == FUZZTABLE) 
 	    fuzzpos = 0;
 	
-	dest += SCREENWIDTH;
+	dest += stride;
 
 	//frac += fracstep; 
     } while (count--); 
@@ -370,6 +389,28 @@ void R_DrawFuzzColumn (void)
   
  
 
+//
+// R_SkipFuzzColumn
+// Same border adjustment and fuzz table
+//  stepping as R_DrawFuzzColumn, without the drawing.
+//
+void R_SkipFuzzColumn (void)
+{
+    if (!dc_yl)
+	dc_yl = 1;
+
+    if (dc_yh == viewheight-1)
+	dc_yh = viewheight - 2;
+
+    if (dc_yh < dc_yl)
+	return;
+
+    fuzzpos = (fuzzpos + dc_yh - dc_yl + 1) % FUZZTABLE;
+}
+
+
+
+
 //
 // R_DrawTranslatedColumn
 // Used to draw player sprites
@@ -379,7 +420,7 @@ void R_DrawFuzzColumn (void)
 //  of the BaronOfHell, the HellKnight, uses
 //  identical sprites, kinda brightened up.
 //
-byte*	dc_translation;
+_Thread_local byte*	dc_translation;
 byte*	translationtables;
 
 void R_DrawTranslatedColumn (void) 
@@ -388,15 +429,16 @@ void R_DrawTranslatedColumn (void)
     byte*		dest; 
     fixed_t		frac;
     fixed_t		fracstep;	 
+    int			stride;
  
     count = dc_yh - dc_yl; 
     if (count < 0) 
 	return; 
 				 
 #ifdef RANGECHECK 
-    if ((unsigned)dc_x >= SCREENWIDTH
+    if ((unsigned)dc_x >= screenwidth
 	|| dc_yl < 0
-	|| dc_yh >= SCREENHEIGHT)
+	|| dc_yh >= screenheight)
     {
 	I_Error ( "R_DrawColumn: %i to %i at %i",
 		  dc_yl, dc_yh, dc_x);
@@ -430,6 +472,7 @@ void R_DrawTranslatedColumn (void)
     // Looks familiar.
     fracstep = dc_iscale; 
     frac = dc_texturemid + (dc_yl-centery)*fracstep; 
+    stride = rowstride;
 
     // Here we do an additional index re-mapping.
     do 
@@ -440,7 +483,7 @@ void R_DrawTranslatedColumn (void)
 	// Thus the "green" ramp of the player 0 sprite
 	//  is mapped to gray, red, black/indigo. 
 	*dest = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
-	dest += SCREENWIDTH;
+	dest += stride;
 	
 	frac += fracstep; 
     } while (count--); 
@@ -497,19 +540,19 @@ void R_InitTranslationTables (void)
 // In consequence, flats are not stored by column (like walls),
 //  and the inner loop has to step in texture space u and v.
 //
-int			ds_y; 
-int			ds_x1; 
-int			ds_x2;
+_Thread_local int			ds_y; 
+_Thread_local int			ds_x1; 
+_Thread_local int			ds_x2;
 
-lighttable_t*		ds_colormap; 
+_Thread_local lighttable_t*		ds_colormap; 
 
-fixed_t			ds_xfrac; 
-fixed_t			ds_yfrac; 
-fixed_t			ds_xstep; 
-fixed_t			ds_ystep;
+_Thread_local fixed_t			ds_xfrac; 
+_Thread_local fixed_t			ds_yfrac; 
+_Thread_local fixed_t			ds_xstep; 
+_Thread_local fixed_t			ds_ystep;
 
 // start of a 64*64 tile image 
-byte*			ds_source;	
+_Thread_local byte*			ds_source;	
 
 // just for profiling
 int			dscount;
@@ -524,12 +567,13 @@ void R_DrawSpan (void)
     byte*		dest; 
     int			count;
     int			spot; 
+    int			stride;
 	 
 #ifdef RANGECHECK 
     if (ds_x2 < ds_x1
 	|| ds_x1<0
-	|| ds_x2>=SCREENWIDTH  
-	|| (unsigned)ds_y>SCREENHEIGHT)
+	|| ds_x2>=screenwidth  
+	|| (unsigned)ds_y>screenheight)
     {
 	I_Error( "R_DrawSpan: %i to %i at %i",
 		 ds_x1,ds_x2,ds_y);
@@ -543,6 +587,9 @@ void R_DrawSpan (void)
 	 
     dest = ylookup[ds_y] + columnofs[ds_x1];
 
+    // Right one pixel, 1 unless column major.
+    stride = colstride;
+
     // We do not check for zero spans here?
     count = ds_x2 - ds_x1; 
 
@@ -553,7 +600,8 @@ void R_DrawSpan (void)
 
 	// Lookup pixel from flat texture tile,
 	//  re-index using light/colormap.
-	*dest++ = ds_colormap[ds_source[spot]];
+	*dest = ds_colormap[ds_source[spot]];
+	dest += stride;
 
 	// Next step in u,v.
 	xfrac += ds_xstep; 
@@ -647,12 +695,13 @@ void R_DrawSpanLow (void)
     byte*		dest; 
     int			count;
     int			spot; 
+    int			stride;
 	 
 #ifdef RANGECHECK 
     if (ds_x2 < ds_x1
 	|| ds_x1<0
-	|| ds_x2>=SCREENWIDTH  
-	|| (unsigned)ds_y>SCREENHEIGHT)
+	|| ds_x2>=screenwidth  
+	|| (unsigned)ds_y>screenheight)
     {
 	I_Error( "R_DrawSpan: %i to %i at %i",
 		 ds_x1,ds_x2,ds_y);
@@ -668,6 +717,7 @@ void R_DrawSpanLow (void)
     ds_x2 <<= 1;
     
     dest = ylookup[ds_y] + columnofs[ds_x1];
+    stride = colstride;
   
     
     count = ds_x2 - ds_x1; 
@@ -676,8 +726,9 @@ void R_DrawSpanLow (void)
 	spot = ((yfrac>>(16-6))&(63*64)) + ((xfrac>>16)&63);
 	// Lowres/blocky mode does it twice,
 	//  while scale is adjusted appropriately.
-	*dest++ = ds_colormap[ds_source[spot]]; 
-	*dest++ = ds_colormap[ds_source[spot]];
+	dest[0] = ds_colormap[ds_source[spot]]; 
+	dest[stride] = ds_colormap[ds_source[spot]];
+	dest += 2*stride;
 	
 	xfrac += ds_xstep; 
 	yfrac += ds_ystep; 
@@ -702,24 +753,118 @@ R_InitBuffer
     // Handle resize,
     //  e.g. smaller view windows
     //  with border and/or status bar.
-    viewwindowx = (SCREENWIDTH-width) >> 1; 
-
-    // Column offset. For windows.
-    for (i=0 ; i<width ; i++) 
-	columnofs[i] = viewwindowx + i;
+    // Centered on the 320x200 screen first,
+    //  so the border patches line up.
+    viewwindowx = SCALEX((SCREENWIDTH-width*SCREENWIDTH/screenwidth) >> 1); 
 
     // Samw with base row offset.
-    if (width == SCREENWIDTH) 
+    if (width == screenwidth) 
 	viewwindowy = 0; 
     else 
-	viewwindowy = (SCREENHEIGHT-SBARHEIGHT-height) >> 1; 
+	viewwindowy = SCALEY((SCREENHEIGHT-SBARHEIGHT
+			      -height*SCREENHEIGHT/screenheight) >> 1); 
+
+    if (colmajor)
+    {
+	// Each column is screenheight long,
+	//  independent of the window.
+	rowstride = 1;
+	colstride = screenheight;
+
+	for (i=0 ; i<width ; i++) 
+	    columnofs[i] = i*screenheight;
+
+	for (i=0 ; i<height ; i++) 
+	    ylookup[i] = viewbuffer + i;
+    }
+    else
+    {
+	rowstride = screenwidth;
+	colstride = 1;
+
+	// Column offset. For windows.
+	for (i=0 ; i<width ; i++) 
+	    columnofs[i] = viewwindowx + i;
 
-    // Preclaculate all row offsets.
-    for (i=0 ; i<height ; i++) 
-	ylookup[i] = screens[0] + (i+viewwindowy)*SCREENWIDTH; 
+	// Preclaculate all row offsets.
+	for (i=0 ; i<height ; i++) 
+	    ylookup[i] = screens[0] + (i+viewwindowy)*screenwidth; 
+    }
+
+    // Fuzz reads the pixels above and below.
+    for (i=0 ; i<FUZZTABLE ; i++)
+	fuzzoffset[i] = fuzzoffset[i] > 0 ? rowstride : -rowstride;
 } 
- 
- 
+
+
+
+//
+// R_InitViewBuffer
+// Allocates the lookup tables for the screen size,
+//  and checks for -colmajor, before the first R_InitBuffer.
+//
+void R_InitViewBuffer (void)
+{
+    ylookup = Z_Malloc (screenheight*sizeof(*ylookup), PU_STATIC, NULL);
+    columnofs = Z_Malloc (screenwidth*sizeof(*columnofs), PU_STATIC, NULL);
+
+    colmajor = M_CheckParm ("-colmajor") != 0;
+
+    if (colmajor)
+	viewbuffer = Z_Malloc (screenwidth*screenheight, PU_STATIC, NULL);
+}
+
+
+
+//
+// R_TransposeView
+// Copies the column major view into screens[0],
+//  in 16x16 blocks, and what is left over a pixel at a time.
+//
+void R_TransposeView (void)
+{
+    byte*	src;
+    byte*	dest;
+    int		width;
+    int		height;
+    int		x;
+    int		y;
+    int		i;
+
+    if (!colmajor)
+	return;
+
+    width = scaledviewwidth;
+    height = viewheight;
+    dest = screens[0] + viewwindowy*screenwidth + viewwindowx;
+
+    for (x=0 ; x+16<=width ; x+=16)
+    {
+	for (y=0 ; y+16<=height ; y+=16)
+	{
+	    transposefunc (viewbuffer + x*screenheight + y, screenheight,
+			   dest + y*screenwidth + x, screenwidth);
+	}
+
+	// the rows below the last full block
+	for ( ; y<height ; y++)
+	{
+	    src = viewbuffer + x*screenheight + y;
+	    for (i=0 ; i<16 ; i++)
+		dest[y*screenwidth + x + i] = src[i*screenheight];
+	}
+    }
+
+    // the columns right of the last full block
+    for ( ; x<width ; x++)
+    {
+	src = viewbuffer + x*screenheight;
+	for (y=0 ; y<height ; y++)
+	    dest[y*screenwidth + x] = src[y];
+    }
+}
+
+
 
 
 //
@@ -730,10 +875,12 @@ R_InitBuffer
 //
 void R_FillBackScreen (void) 
 { 
-    byte*	src;
-    byte*	dest; 
     int		x;
     int		y; 
+    int		left;
+    int		top;
+    int		width;
+    int		height;
     patch_t*	patch;
 
     // DOOM border patch.
@@ -744,7 +891,7 @@ void R_FillBackScreen (void)
 
     char*	name;
 	
-    if (scaledviewwidth == 320)
+    if (scaledviewwidth == screenwidth)
 	return;
 	
     if ( gamemode == commercial)
@@ -752,60 +899,50 @@ void R_FillBackScreen (void)
     else
 	name = name1;
     
-    src = W_CacheLumpName (name, PU_CACHE); 
-    dest = screens[1]; 
-	 
-    for (y=0 ; y<SCREENHEIGHT-SBARHEIGHT ; y++) 
-    { 
-	for (x=0 ; x<SCREENWIDTH/64 ; x++) 
-	{ 
-	    memcpy (dest, src+((y&63)<<6), 64); 
-	    dest += 64; 
-	} 
-
-	if (SCREENWIDTH&63) 
-	{ 
-	    memcpy (dest, src+((y&63)<<6), SCREENWIDTH&63); 
-	    dest += (SCREENWIDTH&63); 
-	} 
-    } 
+    V_FillFlat (W_CacheLumpName (name, PU_CACHE), 1, SCREENHEIGHT-SBARHEIGHT);
+
+    // The patches go on the 320x200 screen.
+    width = scaledviewwidth*SCREENWIDTH/screenwidth;
+    height = viewheight*SCREENHEIGHT/screenheight;
+    left = (SCREENWIDTH-width) >> 1;
+    top = (SCREENHEIGHT-SBARHEIGHT-height) >> 1;
 	
     patch = W_CacheLumpName ("brdr_t",PU_CACHE);
 
-    for (x=0 ; x<scaledviewwidth ; x+=8)
-	V_DrawPatch (viewwindowx+x,viewwindowy-8,1,patch);
+    for (x=0 ; x<width ; x+=8)
+	V_DrawPatch (left+x,top-8,1,patch);
     patch = W_CacheLumpName ("brdr_b",PU_CACHE);
 
-    for (x=0 ; x<scaledviewwidth ; x+=8)
-	V_DrawPatch (viewwindowx+x,viewwindowy+viewheight,1,patch);
+    for (x=0 ; x<width ; x+=8)
+	V_DrawPatch (left+x,top+height,1,patch);
     patch = W_CacheLumpName ("brdr_l",PU_CACHE);
 
-    for (y=0 ; y<viewheight ; y+=8)
-	V_DrawPatch (viewwindowx-8,viewwindowy+y,1,patch);
+    for (y=0 ; y<height ; y+=8)
+	V_DrawPatch (left-8,top+y,1,patch);
     patch = W_CacheLumpName ("brdr_r",PU_CACHE);
 
-    for (y=0 ; y<viewheight ; y+=8)
-	V_DrawPatch (viewwindowx+scaledviewwidth,viewwindowy+y,1,patch);
+    for (y=0 ; y<height ; y+=8)
+	V_DrawPatch (left+width,top+y,1,patch);
 
 
     // Draw beveled edge. 
-    V_DrawPatch (viewwindowx-8,
-		 viewwindowy-8,
+    V_DrawPatch (left-8,
+		 top-8,
 		 1,
 		 W_CacheLumpName ("brdr_tl",PU_CACHE));
     
-    V_DrawPatch (viewwindowx+scaledviewwidth,
-		 viewwindowy-8,
+    V_DrawPatch (left+width,
+		 top-8,
 		 1,
 		 W_CacheLumpName ("brdr_tr",PU_CACHE));
     
-    V_DrawPatch (viewwindowx-8,
-		 viewwindowy+viewheight,
+    V_DrawPatch (left-8,
+		 top+height,
 		 1,
 		 W_CacheLumpName ("brdr_bl",PU_CACHE));
     
-    V_DrawPatch (viewwindowx+scaledviewwidth,
-		 viewwindowy+viewheight,
+    V_DrawPatch (left+width,
+		 top+height,
 		 1,
 		 W_CacheLumpName ("brdr_br",PU_CACHE));
 } 
@@ -844,30 +981,33 @@ void R_DrawViewBorder (void)
 { 
     int		top;
     int		side;
+    int		bottom;
     int		ofs;
     int		i; 
  
-    if (scaledviewwidth == SCREENWIDTH) 
+    if (scaledviewwidth == screenwidth) 
 	return; 
   
-    top = ((SCREENHEIGHT-SBARHEIGHT)-viewheight)/2; 
-    side = (SCREENWIDTH-scaledviewwidth)/2; 
+    // The sides can be a pixel apart when
+    //  the screen is not a multiple of 320x200.
+    top = viewwindowy; 
+    side = screenwidth-scaledviewwidth; 
+    bottom = SCALEY(SCREENHEIGHT-SBARHEIGHT)*screenwidth; 
  
     // copy top and one line of left side 
-    R_VideoErase (0, top*SCREENWIDTH+side); 
+    R_VideoErase (0, top*screenwidth+viewwindowx); 
  
     // copy one line of right side and bottom 
-    ofs = (viewheight+top)*SCREENWIDTH-side; 
-    R_VideoErase (ofs, top*SCREENWIDTH+side); 
+    ofs = (viewheight+top-1)*screenwidth+viewwindowx+scaledviewwidth; 
+    R_VideoErase (ofs, bottom-ofs); 
  
     // copy sides using wraparound 
-    ofs = top*SCREENWIDTH + SCREENWIDTH-side; 
-    side <<= 1;
+    ofs = top*screenwidth+viewwindowx+scaledviewwidth; 
     
     for (i=1 ; i<viewheight ; i++) 
     { 
 	R_VideoErase (ofs, side); 
-	ofs += SCREENWIDTH; 
+	ofs += screenwidth; 
     } 
 
     // ? 
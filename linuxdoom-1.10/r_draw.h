@@ -29,15 +29,28 @@
 #endif
 
 
-extern lighttable_t*	dc_colormap;
-extern int		dc_x;
-extern int		dc_yl;
-extern int		dc_yh;
-extern fixed_t		dc_iscale;
-extern fixed_t		dc_texturemid;
+// Framebuffer row and column offsets.
+extern byte**		ylookup;
+extern int*		columnofs;
+
+// Column major view buffer, see R_InitBuffer.
+extern boolean		colmajor;
+extern byte*		viewbuffer;
+extern int		rowstride;
+extern int		colstride;
+
+
+// The drawer parameters are per thread,
+//  see r_strip.c.
+extern _Thread_local lighttable_t*	dc_colormap;
+extern _Thread_local int		dc_x;
+extern _Thread_local int		dc_yl;
+extern _Thread_local int		dc_yh;
+extern _Thread_local fixed_t		dc_iscale;
+extern _Thread_local fixed_t		dc_texturemid;
 
 // first pixel in a column
-extern byte*		dc_source;		
+extern _Thread_local byte*		dc_source;		
 
 
 // The span blitting interface.
@@ -50,6 +63,10 @@ void 	R_DrawColumnLow (void);
 void 	R_DrawFuzzColumn (void);
 void 	R_DrawFuzzColumnLow (void);
 
+// Advances the fuzz table without drawing.
+void	R_SkipFuzzColumn (void);
+extern _Thread_local int	fuzzpos;
+
 // Draw with color translation tables,
 //  for player sprite rendering,
 //  Green/Red/Blue/Indigo shirts.
@@ -61,22 +78,22 @@ R_VideoErase
 ( unsigned	ofs,
   int		count );
 
-extern int		ds_y;
-extern int		ds_x1;
-extern int		ds_x2;
+extern _Thread_local int		ds_y;
+extern _Thread_local int		ds_x1;
+extern _Thread_local int		ds_x2;
 
-extern lighttable_t*	ds_colormap;
+extern _Thread_local lighttable_t*	ds_colormap;
 
-extern fixed_t		ds_xfrac;
-extern fixed_t		ds_yfrac;
-extern fixed_t		ds_xstep;
-extern fixed_t		ds_ystep;
+extern _Thread_local fixed_t		ds_xfrac;
+extern _Thread_local fixed_t		ds_yfrac;
+extern _Thread_local fixed_t		ds_xstep;
+extern _Thread_local fixed_t		ds_ystep;
 
 // start of a 64*64 tile image
-extern byte*		ds_source;		
+extern _Thread_local byte*		ds_source;		
 
 extern byte*		translationtables;
-extern byte*		dc_translation;
+extern _Thread_local byte*		dc_translation;
 
 
 // Span blitting for rows, floor/ceiling.
@@ -92,6 +109,13 @@ R_InitBuffer
 ( int		width,
   int		height );
 
+// Checks for -colmajor, once at startup.
+void	R_InitViewBuffer (void);
+
+// With -colmajor, copies the finished view
+//  into screens[0].
+void	R_TransposeView (void);
+
 
 // Initialize color translation tables,
 //  for player rendering etc.
@@ -0,0 +1,170 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Drawing frames between tics.
+//	The game still runs at TICRATE. With -uncapped, frames are
+//	 drawn as often as the display asks for them, and things,
+//	 the view and moving floors and ceilings are drawn between
+//	 where they were at the start of the last tic and now.
+//	This trails the game by up to one tic, like any
+//	 interpolation, but nothing in the game state changes.
+//
+//-----------------------------------------------------------------------------
+
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "p_local.h"
+
+#include "r_local.h"
+#include "r_interp.h"
+
+
+fixed_t		interpfrac = FRACUNIT;
+
+// viewz is in player_t, which is saved as is.
+static fixed_t	oldviewz[MAXPLAYERS];
+
+
+
+//
+// R_SnapMobj
+//
+void R_SnapMobj (mobj_t* mo)
+{
+    mo->oldx = mo->x;
+    mo->oldy = mo->y;
+    mo->oldz = mo->z;
+    mo->oldangle = mo->angle;
+
+    // viewz is not set yet for a new player
+    if (mo->player)
+	oldviewz[mo->player-players] = mo->z + mo->player->viewheight;
+}
+
+
+//
+// R_SnapInterpolation
+//
+void R_SnapInterpolation (void)
+{
+    thinker_t*	th;
+    sector_t*	sec;
+    int		i;
+
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    {
+	if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+	    R_SnapMobj ((mobj_t *)th);
+    }
+
+    for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
+    {
+	sec->oldfloorheight = sec->floorheight;
+	sec->oldceilingheight = sec->ceilingheight;
+    }
+
+    for (i=0 ; i<MAXPLAYERS ; i++)
+	oldviewz[i] = players[i].viewz;
+}
+
+
+
+//
+// R_LerpFixed
+//
+fixed_t R_LerpFixed (fixed_t oldval, fixed_t newval)
+{
+    if (interpfrac == FRACUNIT)
+	return newval;
+
+    return oldval + FixedMul (newval-oldval, interpfrac);
+}
+
+
+//
+// R_LerpAngle
+// Takes the short way around.
+//
+angle_t R_LerpAngle (angle_t oldval, angle_t newval)
+{
+    if (interpfrac == FRACUNIT)
+	return newval;
+
+    return oldval + FixedMul ((int)(newval-oldval), interpfrac);
+}
+
+
+//
+// R_LerpViewZ
+//
+fixed_t R_LerpViewZ (int playernum)
+{
+    return R_LerpFixed (oldviewz[playernum], players[playernum].viewz);
+}
+
+
+
+//
+// R_InterpolateSectors
+//
+void R_InterpolateSectors (void)
+{
+    sector_t*	sec;
+    int		i;
+
+    if (interpfrac == FRACUNIT)
+	return;
+
+    for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
+    {
+	sec->realfloorheight = sec->floorheight;
+	sec->realceilingheight = sec->ceilingheight;
+
+	// most sectors don't move
+	if (sec->oldfloorheight != sec->floorheight)
+	    sec->floorheight = R_LerpFixed (sec->oldfloorheight,
+					    sec->floorheight);
+	if (sec->oldceilingheight != sec->ceilingheight)
+	    sec->ceilingheight = R_LerpFixed (sec->oldceilingheight,
+					      sec->ceilingheight);
+    }
+}
+
+
+//
+// R_RestoreSectors
+//
+void R_RestoreSectors (void)
+{
+    sector_t*	sec;
+    int		i;
+
+    if (interpfrac == FRACUNIT)
+	return;
+
+    for (i=0, sec=sectors ; i<numsectors ; i++, sec++)
+    {
+	sec->floorheight = sec->realfloorheight;
+	sec->ceilingheight = sec->realceilingheight;
+    }
+}
@@ -0,0 +1,66 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// DESCRIPTION:
+//	Drawing frames between tics.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __R_INTERP__
+#define __R_INTERP__
+
+#include "m_fixed.h"
+#include "tables.h"
+#include "p_mobj.h"
+
+#ifdef __GNUG__
+#pragma interface
+#endif
+
+
+// How far the frame is from the previous tic to the
+//  current one, FRACUNIT draws the current tic as is.
+extern fixed_t		interpfrac;
+
+
+// Makes the current state the start of the next
+//  interpolation, everything is drawn where it is now.
+// Called at the start of each tic, and after a level
+//  is set up or loaded.
+void R_SnapInterpolation (void);
+
+// Same for one thing that just appeared or teleported,
+//  and the view of its player, if any.
+void R_SnapMobj (mobj_t* mo);
+
+// Called around R_RenderPlayerView.
+// Moves the sector heights between the two tics,
+//  and puts the real ones back.
+void R_InterpolateSectors (void);
+void R_RestoreSectors (void);
+
+fixed_t R_LerpFixed (fixed_t oldval, fixed_t newval);
+angle_t R_LerpAngle (angle_t oldval, angle_t newval);
+
+// View height of a player between the two tics.
+fixed_t R_LerpViewZ (int playernum);
+
+
+#endif
+//-----------------------------------------------------------------------------
+//
+// $Log:$
+//
+//-----------------------------------------------------------------------------
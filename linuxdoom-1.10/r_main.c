@@ -35,17 +35,25 @@ rcsid[] = "$Id: r_main.c,v 1.5 1997/02/03 22:45:12 b1 Exp $";
 
 #include "doomdef.h"
 #include "d_net.h"
+#include "doomstat.h"
 
 #include "m_bbox.h"
+#include "z_zone.h"
 
 #include "r_local.h"
 #include "r_sky.h"
+#include "r_strip.h"
+#include "r_simd.h"
+#include "r_interp.h"
+#include "r_stats.h"
 
+#include "v_video.h"
 
 
 
 
-// Fineangles in the SCREENWIDTH wide window.
+
+// Fineangles in the viewwidth wide window.
 #define FIELDOFVIEW		2048	
 
 
@@ -101,7 +109,8 @@ int			viewangletox[FINEANGLES/2];
 // The xtoviewangleangle[] table maps a screen pixel
 // to the lowest viewangle that maps back to x ranges
 // from clipangle to -clipangle.
-angle_t			xtoviewangle[SCREENWIDTH+1];
+// screenwidth+1 entries.
+angle_t*		xtoviewangle;
 
 
 // UNUSED.
@@ -554,7 +563,7 @@ void R_InitTextureMapping (void)
     //  after the view angle.
     //
     // Calc focallength
-    //  so FIELDOFVIEW angles covers SCREENWIDTH.
+    //  so FIELDOFVIEW angles covers viewwidth.
     focallength = FixedDiv (centerxfrac,
 			    finetangent[FINEANGLES/4+FIELDOFVIEW/2] );
 	
@@ -682,13 +691,15 @@ void R_ExecuteSetViewSize (void)
 
     if (setblocks == 11)
     {
-	scaledviewwidth = SCREENWIDTH;
-	viewheight = SCREENHEIGHT;
+	scaledviewwidth = screenwidth;
+	viewheight = screenheight;
     }
     else
     {
-	scaledviewwidth = setblocks*32;
-	viewheight = (setblocks*168/10)&~7;
+	// Same as setblocks*32 and setblocks*168/10
+	//  on a 320x200 screen.
+	scaledviewwidth = (setblocks*screenwidth/10)&~7;
+	viewheight = (setblocks*SCALEY(168)/10)&~7;
     }
     
     detailshift = setdetail;
@@ -702,10 +713,10 @@ void R_ExecuteSetViewSize (void)
 
     if (!detailshift)
     {
-	colfunc = basecolfunc = R_DrawColumn;
+	colfunc = basecolfunc = drawcolumnfunc;
 	fuzzcolfunc = R_DrawFuzzColumn;
 	transcolfunc = R_DrawTranslatedColumn;
-	spanfunc = R_DrawSpan;
+	spanfunc = drawspanfunc;
     }
     else
     {
@@ -773,6 +784,13 @@ extern int	screenblocks;
 
 void R_Init (void)
 {
+    xtoviewangle = Z_Malloc ((screenwidth+1)*sizeof(*xtoviewangle),
+			     PU_STATIC, NULL);
+
+    R_InitViewBuffer ();
+    printf ("\nR_InitViewBuffer");
+    R_InitSIMD ();
+    printf ("\nR_InitSIMD");
     R_InitData ();
     printf ("\nR_InitData");
     R_InitPointToAngle ();
@@ -784,12 +802,18 @@ void R_Init (void)
     R_SetViewSize (screenblocks, detailLevel);
     R_InitPlanes ();
     printf ("\nR_InitPlanes");
+    R_InitClipSegs ();
+    printf ("\nR_InitClipSegs");
     R_InitLightTables ();
     printf ("\nR_InitLightTables");
     R_InitSkyMap ();
     printf ("\nR_InitSkyMap");
     R_InitTranslationTables ();
     printf ("\nR_InitTranslationsTables");
+    R_InitStrips ();
+    printf ("\nR_InitStrips");
+    R_InitStats ();
+    printf ("\nR_InitStats");
 	
     framecount = 0;
 }
@@ -833,17 +857,19 @@ void R_SetupFrame (player_t* player)
     int		i;
     
     viewplayer = player;
-    viewx = player->mo->x;
-    viewy = player->mo->y;
-    viewangle = player->mo->angle + viewangleoffset;
+    viewx = R_LerpFixed (player->mo->oldx, player->mo->x);
+    viewy = R_LerpFixed (player->mo->oldy, player->mo->y);
+    viewangle = R_LerpAngle (player->mo->oldangle, player->mo->angle)
+	+ viewangleoffset;
     extralight = player->extralight;
 
-    viewz = player->viewz;
+    viewz = R_LerpViewZ (player-players);
     
     viewsin = finesine[viewangle>>ANGLETOFINESHIFT];
     viewcos = finecosine[viewangle>>ANGLETOFINESHIFT];
 	
     sscount = 0;
+    linecount = 0;
 	
     if (player->fixedcolormap)
     {
@@ -870,29 +896,57 @@ void R_SetupFrame (player_t* player)
 //
 void R_RenderPlayerView (player_t* player)
 {	
+    R_StartTimer (rt_setup);
     R_SetupFrame (player);
 
+    // Floors and ceilings between tics, if uncapped.
+    R_InterpolateSectors ();
+
+    // Record the drawing for the strip threads.
+    R_StartStrips ();
+
     // Clear buffers.
     R_ClearClipSegs ();
     R_ClearDrawSegs ();
     R_ClearPlanes ();
     R_ClearSprites ();
+    R_StopTimer (rt_setup);
     
     // check for new console commands.
     NetUpdate ();
 
     // The head node is the last node output.
+    R_StartTimer (rt_bsp);
     R_RenderBSPNode (numnodes-1);
+    R_StopTimer (rt_bsp);
     
     // Check for new console commands.
     NetUpdate ();
     
+    R_StartTimer (rt_planes);
     R_DrawPlanes ();
+    R_StopTimer (rt_planes);
     
     // Check for new console commands.
     NetUpdate ();
     
+    R_StartTimer (rt_masked);
     R_DrawMasked ();
+    R_StopTimer (rt_masked);
+
+    R_CountStats ();
+
+    // Done with the sectors, the strips only draw.
+    R_RestoreSectors ();
+
+    // Draw the strips and join.
+    R_StartTimer (rt_strips);
+    R_FinishStrips ();
+
+    // Column major view into screens[0],
+    //  before the status bar and menus go on top.
+    R_TransposeView ();
+    R_StopTimer (rt_strips);
 
     // Check for new console commands.
     NetUpdate ();				
@@ -39,6 +39,8 @@ rcsid[] = "$Id: r_plane.c,v 1.4 1997/02/03 16:47:55 b1 Exp $";
 #include "r_local.h"
 #include "r_sky.h"
 
+#include "v_video.h"
+
 
 
 planefunction_t		floorfunc;
@@ -49,33 +51,56 @@ planefunction_t		ceilingfunc;
 //
 
 // Here comes the obnoxious "visplane".
-#define MAXVISPLANES	128
-visplane_t		visplanes[MAXVISPLANES];
-visplane_t*		lastvisplane;
+// Visplanes come from the frame arena and are kept in
+//  creation order, plus hashed on height, picnum and light.
+#define VISPLANEHASH	256
+#define VISPLANEHASHKEY(height,picnum,lightlevel) \
+    ((((unsigned)(height)>>FRACBITS)*7 + (picnum)*3 + (lightlevel)) \
+     & (VISPLANEHASH-1))
+
+visplane_t**		visplanes;
+int			numvisplanes;
+int			maxvisplanes;
+visplane_t*		visplanehash[VISPLANEHASH];
 visplane_t*		floorplane;
 visplane_t*		ceilingplane;
 
-// ?
-#define MAXOPENINGS	SCREENWIDTH*64
-short			openings[MAXOPENINGS];
-short*			lastopening;
-short*			endofopenings;
+
+//
+// frame arena
+// A list of zone blocks kept for the whole game.
+// R_ClearPlanes rewinds it, so after the first few frames
+//  allocation is only a pointer bump.
+//
+#define FRAMEBLOCKSIZE	(256*1024)
+
+typedef struct frameblock_s
+{
+    struct frameblock_s*	next;
+    int				size;
+    int				used;
+
+} frameblock_t;
+
+frameblock_t*		frameblocks;
+frameblock_t*		curframeblock;
+
+int			numopenings;
 
 
 //
 // Clip values are the solid pixel bounding the range.
-//  floorclip starts out SCREENHEIGHT
+//  floorclip starts out viewheight
 //  ceilingclip starts out -1
 //
-short			floorclip[SCREENWIDTH];
-short			ceilingclip[SCREENWIDTH];
+short*			floorclip;
+short*			ceilingclip;
 
 //
 // spanstart holds the start of a plane span
 // initialized to 0 at start
 //
-int			spanstart[SCREENHEIGHT];
-int			spanstop[SCREENHEIGHT];
+int*			spanstart;
 
 //
 // texture mapping
@@ -83,25 +108,145 @@ int			spanstop[SCREENHEIGHT];
 lighttable_t**		planezlight;
 fixed_t			planeheight;
 
-fixed_t			yslope[SCREENHEIGHT];
-fixed_t			distscale[SCREENWIDTH];
+fixed_t*		yslope;
+fixed_t*		distscale;
 fixed_t			basexscale;
 fixed_t			baseyscale;
 
-fixed_t			cachedheight[SCREENHEIGHT];
-fixed_t			cacheddistance[SCREENHEIGHT];
-fixed_t			cachedxstep[SCREENHEIGHT];
-fixed_t			cachedystep[SCREENHEIGHT];
+fixed_t*		cachedheight;
+fixed_t*		cacheddistance;
+fixed_t*		cachedxstep;
+fixed_t*		cachedystep;
 
 
 
 //
 // R_InitPlanes
 // Only at game startup.
+// Sizes the tables for the screen, see V_Init.
 //
 void R_InitPlanes (void)
 {
-  // Doh!
+    floorclip = Z_Malloc (screenwidth*sizeof(*floorclip), PU_STATIC, NULL);
+    ceilingclip = Z_Malloc (screenwidth*sizeof(*ceilingclip), PU_STATIC, NULL);
+    distscale = Z_Malloc (screenwidth*sizeof(*distscale), PU_STATIC, NULL);
+
+    spanstart = Z_Malloc (screenheight*sizeof(*spanstart), PU_STATIC, NULL);
+    yslope = Z_Malloc (screenheight*sizeof(*yslope), PU_STATIC, NULL);
+    cachedheight = Z_Malloc (screenheight*sizeof(fixed_t), PU_STATIC, NULL);
+    cacheddistance = Z_Malloc (screenheight*sizeof(fixed_t), PU_STATIC, NULL);
+    cachedxstep = Z_Malloc (screenheight*sizeof(fixed_t), PU_STATIC, NULL);
+    cachedystep = Z_Malloc (screenheight*sizeof(fixed_t), PU_STATIC, NULL);
+}
+
+
+
+//
+// R_FrameAlloc
+// Returns size bytes that stay valid
+//  until the next R_ClearPlanes.
+//
+void* R_FrameAlloc (int size)
+{
+    frameblock_t*	block;
+    frameblock_t*	newblock;
+    int			blocksize;
+
+    // keep everything pointer aligned
+    size = (size + sizeof(void *)-1) & ~(sizeof(void *)-1);
+
+    block = curframeblock;
+
+    while (block && block->used + size > block->size)
+    {
+	// the rest of this block is wasted for this frame
+	block = block->next;
+    }
+
+    if (!block)
+    {
+	// add a new block to the end of the list
+	blocksize = FRAMEBLOCKSIZE;
+	if (blocksize < size)
+	    blocksize = size;
+
+	newblock = Z_Malloc (sizeof(frameblock_t)+blocksize, PU_STATIC, NULL);
+	newblock->next = NULL;
+	newblock->size = blocksize;
+	newblock->used = 0;
+
+	if (!frameblocks)
+	    frameblocks = newblock;
+	else
+	{
+	    for (block = curframeblock ; block->next ; block = block->next)
+		;
+	    block->next = newblock;
+	}
+	block = newblock;
+    }
+
+    curframeblock = block;
+    block->used += size;
+
+    return (byte *)(block+1) + block->used - size;
+}
+
+
+//
+// R_NewOpenings
+//
+short* R_NewOpenings (int count)
+{
+    numopenings += count;
+    return R_FrameAlloc (count*sizeof(short));
+}
+
+
+
+//
+// R_NewVisplane
+// Appends a plane to the draw order.
+//
+visplane_t*
+R_NewVisplane
+( fixed_t	height,
+  int		picnum,
+  int		lightlevel )
+{
+    visplane_t*		pl;
+    visplane_t**	newplanes;
+
+    if (numvisplanes == maxvisplanes)
+    {
+	// only grows, so this stops after a few frames
+	maxvisplanes = maxvisplanes ? maxvisplanes*2 : 128;
+	newplanes = Z_Malloc (maxvisplanes*sizeof(*newplanes), PU_STATIC, NULL);
+	if (visplanes)
+	{
+	    memcpy (newplanes, visplanes, numvisplanes*sizeof(*newplanes));
+	    Z_Free (visplanes);
+	}
+	visplanes = newplanes;
+    }
+
+    pl = R_FrameAlloc (sizeof(*pl));
+    visplanes[numvisplanes++] = pl;
+
+    // top and bottom, each with a pad at both ends
+    pl->top = (unsigned short *)R_FrameAlloc ((screenwidth+2)*2
+					      *sizeof(*pl->top)) + 1;
+    pl->bottom = pl->top + screenwidth+2;
+
+    // The arena is not cleared, and a stale 0xffff
+    //  in bottom would pass for a span in R_MakeSpans.
+    memset (pl->bottom-1, 0, (screenwidth+2)*sizeof(*pl->bottom));
+
+    pl->height = height;
+    pl->picnum = picnum;
+    pl->lightlevel = lightlevel;
+
+    return pl;
 }
 
 
@@ -185,8 +330,9 @@ R_MapPlane
 //
 void R_ClearPlanes (void)
 {
-    int		i;
-    angle_t	angle;
+    int			i;
+    angle_t		angle;
+    frameblock_t*	block;
     
     // opening / clipping determination
     for (i=0 ; i<viewwidth ; i++)
@@ -195,12 +341,17 @@ void R_ClearPlanes (void)
 	ceilingclip[i] = -1;
     }
 
-    lastvisplane = visplanes;
-    lastopening = openings;
-    endofopenings = openings + MAXOPENINGS;
+    // rewind the frame arena
+    for (block = frameblocks ; block ; block = block->next)
+	block->used = 0;
+    curframeblock = frameblocks;
+    numopenings = 0;
+
+    numvisplanes = 0;
+    memset (visplanehash, 0, sizeof(visplanehash));
     
     // texture calculation
-    memset (cachedheight, 0, sizeof(cachedheight));
+    memset (cachedheight, 0, screenheight*sizeof(*cachedheight));
 
     // left to right mapping
     angle = (viewangle-ANG90)>>ANGLETOFINESHIFT;
@@ -223,39 +374,36 @@ R_FindPlane
   int		lightlevel )
 {
     visplane_t*	check;
+    unsigned	key;
 	
     if (picnum == skyflatnum)
     {
 	height = 0;			// all skys map together
 	lightlevel = 0;
     }
-	
-    for (check=visplanes; check<lastvisplane; check++)
+
+    // The first plane made with a key stays ahead
+    //  of later ones in its chain, see R_CheckPlane.
+    key = VISPLANEHASHKEY (height, picnum, lightlevel);
+
+    for (check=visplanehash[key]; check; check=check->next)
     {
 	if (height == check->height
 	    && picnum == check->picnum
 	    && lightlevel == check->lightlevel)
 	{
-	    break;
+	    return check;
 	}
     }
-    
-			
-    if (check < lastvisplane)
-	return check;
-		
-    if (lastvisplane - visplanes == MAXVISPLANES)
-	I_Error ("R_FindPlane: no more visplanes");
 		
-    lastvisplane++;
+    check = R_NewVisplane (height, picnum, lightlevel);
+    check->next = visplanehash[key];
+    visplanehash[key] = check;
 
-    check->height = height;
-    check->picnum = picnum;
-    check->lightlevel = lightlevel;
-    check->minx = SCREENWIDTH;
+    check->minx = screenwidth;
     check->maxx = -1;
     
-    memset (check->top,0xff,sizeof(check->top));
+    memset (check->top,0xff,screenwidth*sizeof(*check->top));
 		
     return check;
 }
@@ -270,6 +418,7 @@ R_CheckPlane
   int		start,
   int		stop )
 {
+    visplane_t*	check;
     int		intrl;
     int		intrh;
     int		unionl;
@@ -299,7 +448,7 @@ R_CheckPlane
     }
 
     for (x=intrl ; x<= intrh ; x++)
-	if (pl->top[x] != 0xff)
+	if (pl->top[x] != 0xffff)
 	    break;
 
     if (x > intrh)
@@ -311,16 +460,17 @@ R_CheckPlane
 	return pl;		
     }
 	
-    // make a new visplane
-    lastvisplane->height = pl->height;
-    lastvisplane->picnum = pl->picnum;
-    lastvisplane->lightlevel = pl->lightlevel;
+    // make a new visplane,
+    //  chained after the one it continues
+    check = R_NewVisplane (pl->height, pl->picnum, pl->lightlevel);
+    check->next = pl->next;
+    pl->next = check;
     
-    pl = lastvisplane++;
+    pl = check;
     pl->minx = start;
     pl->maxx = stop;
 
-    memset (pl->top,0xff,sizeof(pl->top));
+    memset (pl->top,0xff,screenwidth*sizeof(*pl->top));
 		
     return pl;
 }
@@ -369,6 +519,7 @@ R_MakeSpans
 void R_DrawPlanes (void)
 {
     visplane_t*		pl;
+    int			i;
     int			light;
     int			x;
     int			stop;
@@ -378,18 +529,12 @@ void R_DrawPlanes (void)
     if (ds_p - drawsegs > MAXDRAWSEGS)
 	I_Error ("R_DrawPlanes: drawsegs overflow (%i)",
 		 ds_p - drawsegs);
-    
-    if (lastvisplane - visplanes > MAXVISPLANES)
-	I_Error ("R_DrawPlanes: visplane overflow (%i)",
-		 lastvisplane - visplanes);
-    
-    if (lastopening - openings > MAXOPENINGS)
-	I_Error ("R_DrawPlanes: opening overflow (%i)",
-		 lastopening - openings);
 #endif
 
-    for (pl = visplanes ; pl < lastvisplane ; pl++)
+    for (i = 0 ; i < numvisplanes ; i++)
     {
+	pl = visplanes[i];
+
 	if (pl->minx > pl->maxx)
 	    continue;
 
@@ -437,8 +582,8 @@ void R_DrawPlanes (void)
 
 	planezlight = zlight[light];
 
-	pl->top[pl->maxx+1] = 0xff;
-	pl->top[pl->minx-1] = 0xff;
+	pl->top[pl->maxx+1] = 0xffff;
+	pl->top[pl->minx-1] = 0xffff;
 		
 	stop = pl->maxx + 1;
 
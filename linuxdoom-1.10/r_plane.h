@@ -32,8 +32,17 @@
 
 
 // Visplane related.
-extern  short*		lastopening;
-extern  short*          endofopenings;
+// Per frame memory, freed by R_ClearPlanes.
+void*	R_FrameAlloc (int size);
+
+// Space for count clip values, e.g. openings.
+short*	R_NewOpenings (int count);
+
+// Openings handed out this frame.
+extern int		numopenings;
+
+// Visplanes used this frame.
+extern int		numvisplanes;
 
 
 typedef void (*planefunction_t) (int top, int bottom);
@@ -41,11 +50,11 @@ typedef void (*planefunction_t) (int top, int bottom);
 extern planefunction_t	floorfunc;
 extern planefunction_t	ceilingfunc_t;
 
-extern short		floorclip[SCREENWIDTH];
-extern short		ceilingclip[SCREENWIDTH];
+extern short*		floorclip;
+extern short*		ceilingclip;
 
-extern fixed_t		yslope[SCREENHEIGHT];
-extern fixed_t		distscale[SCREENWIDTH];
+extern fixed_t*		yslope;
+extern fixed_t*		distscale;
 
 void R_InitPlanes (void);
 void R_ClearPlanes (void);
@@ -608,8 +608,8 @@ R_StoreWallRange
 	{
 	    // masked midtexture
 	    maskedtexture = true;
-	    ds_p->maskedtexturecol = maskedtexturecol = lastopening - rw_x;
-	    lastopening += rw_stopx - rw_x;
+	    maskedtexturecol = R_NewOpenings (rw_stopx - rw_x) - rw_x;
+	    ds_p->maskedtexturecol = maskedtexturecol;
 	}
     }
     
@@ -718,23 +718,15 @@ R_StoreWallRange
     if ( ((ds_p->silhouette & SIL_TOP) || maskedtexture)
 	 && !ds_p->sprtopclip)
     {
-	memcpy (lastopening, ceilingclip+start, 2*(rw_stopx-start));
-	ds_p->sprtopclip = lastopening - start;
-	lastopening += rw_stopx - start;
-	if ((size_t)lastopening > (size_t)endofopenings) {
-		I_Error("R_StoreWallRange: overflowed openings");
-	}
+	ds_p->sprtopclip = R_NewOpenings (rw_stopx - start) - start;
+	memcpy (ds_p->sprtopclip+start, ceilingclip+start, 2*(rw_stopx-start));
     }
     
     if ( ((ds_p->silhouette & SIL_BOTTOM) || maskedtexture)
 	 && !ds_p->sprbottomclip)
     {
-	memcpy (lastopening, floorclip+start, 2*(rw_stopx-start));
-	ds_p->sprbottomclip = lastopening - start;
-	lastopening += rw_stopx - start;	
-	if ((size_t)lastopening > (size_t)endofopenings) {
-		I_Error("R_StoreWallRange: overflowed openings");
-	}
+	ds_p->sprbottomclip = R_NewOpenings (rw_stopx - start) - start;
+	memcpy (ds_p->sprbottomclip+start, floorclip+start, 2*(rw_stopx-start));
     }
 
     if (maskedtexture && !(ds_p->silhouette&SIL_TOP))
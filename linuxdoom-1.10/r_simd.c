@@ -0,0 +1,534 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Vectorized column and span drawers, x86 only.
+//	Eight texture coordinates are stepped per iteration.
+//	SSE2 only computes the texel addresses, AVX2 also
+//	 gathers the texels and their colormap entries.
+//	The fixed point stepping wraps exactly like the C
+//	 loops, so the pixels come out the same.
+//
+//-----------------------------------------------------------------------------
+
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+
+#include "doomdef.h"
+
+#include "i_system.h"
+#include "m_argv.h"
+
+#include "r_local.h"
+
+#include "v_video.h"
+
+#ifdef __GNUG__
+#pragma implementation "r_simd.h"
+#endif
+#include "r_simd.h"
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+
+void	(*drawcolumnfunc) (void) = R_DrawColumn;
+void	(*drawspanfunc) (void) = R_DrawSpan;
+
+transposefunc_t	transposefunc = R_TransposeBlock;
+
+
+
+//
+// R_TransposeBlock
+//
+void
+R_TransposeBlock
+( byte*		src,
+  int		srcstride,
+  byte*		dest,
+  int		deststride )
+{
+    int		x;
+    int		y;
+
+    for (y=0 ; y<16 ; y++)
+	for (x=0 ; x<16 ; x++)
+	    dest[y*deststride + x] = src[x*srcstride + y];
+}
+
+
+#ifdef SIMD_X86
+
+//
+// The gathers load four bytes ending at the wanted texel,
+//  i.e. from source-3, and keep the top byte.
+// The three bytes before a column, flat or colormap are
+//  still in the same lump or its zone block header.
+//
+#define GATHERBASE(p)	((int const *)((byte *)(p) - 3))
+
+
+
+//
+// R_DrawColumnSSE2
+//
+__attribute__((target("sse2")))
+void R_DrawColumnSSE2 (void)
+{
+    int			count;
+    byte*		dest;
+    byte*		source;
+    lighttable_t*	colormap;
+    fixed_t		frac;
+    fixed_t		fracstep;
+    __m128i		frac0;
+    __m128i		frac1;
+    __m128i		step8;
+    __m128i		mask;
+    int			index[8] __attribute__((aligned(16)));
+    int			i;
+    int			stride;
+
+    count = dc_yh - dc_yl;
+
+    if (count < 0)
+	return;
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x >= screenwidth
+	|| dc_yl < 0
+	|| dc_yh >= screenheight)
+	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+    dest = ylookup[dc_yl] + columnofs[dc_x];
+    source = dc_source;
+    colormap = dc_colormap;
+    stride = rowstride;
+
+    fracstep = dc_iscale;
+    frac = dc_texturemid + (dc_yl-centery)*fracstep;
+
+    // pixels left, not count-1 as in R_DrawColumn
+    count++;
+
+    if (count >= 8)
+    {
+	frac0 = _mm_setr_epi32 (frac,
+				frac + fracstep,
+				frac + fracstep*2,
+				frac + fracstep*3);
+	frac1 = _mm_add_epi32 (frac0, _mm_set1_epi32 (fracstep*4));
+	step8 = _mm_set1_epi32 (fracstep*8);
+	mask = _mm_set1_epi32 (127);
+
+	do
+	{
+	    _mm_store_si128 ((__m128i *)index,
+			     _mm_and_si128 (_mm_srli_epi32 (frac0, FRACBITS), mask));
+	    _mm_store_si128 ((__m128i *)(index+4),
+			     _mm_and_si128 (_mm_srli_epi32 (frac1, FRACBITS), mask));
+
+	    for (i=0 ; i<8 ; i++)
+	    {
+		*dest = colormap[source[index[i]]];
+		dest += stride;
+	    }
+
+	    frac0 = _mm_add_epi32 (frac0, step8);
+	    frac1 = _mm_add_epi32 (frac1, step8);
+	    frac += fracstep*8;
+	    count -= 8;
+	} while (count >= 8);
+    }
+
+    while (count--)
+    {
+	*dest = colormap[source[(frac>>FRACBITS)&127]];
+	dest += stride;
+	frac += fracstep;
+    }
+}
+
+
+
+//
+// R_DrawSpanSSE2
+//
+__attribute__((target("sse2")))
+void R_DrawSpanSSE2 (void)
+{
+    int			count;
+    byte*		dest;
+    byte*		source;
+    lighttable_t*	colormap;
+    fixed_t		xfrac;
+    fixed_t		yfrac;
+    __m128i		x0, x1;
+    __m128i		y0, y1;
+    __m128i		xstep8;
+    __m128i		ystep8;
+    __m128i		xmask;
+    __m128i		ymask;
+    int			spot[8] __attribute__((aligned(16)));
+    int			i;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=screenwidth
+	|| (unsigned)ds_y>screenheight)
+    {
+	I_Error( "R_DrawSpan: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    xfrac = ds_xfrac;
+    yfrac = ds_yfrac;
+    source = ds_source;
+    colormap = ds_colormap;
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+    count = ds_x2 - ds_x1 + 1;
+
+    if (count >= 8)
+    {
+	x0 = _mm_setr_epi32 (xfrac,
+			     xfrac + ds_xstep,
+			     xfrac + ds_xstep*2,
+			     xfrac + ds_xstep*3);
+	y0 = _mm_setr_epi32 (yfrac,
+			     yfrac + ds_ystep,
+			     yfrac + ds_ystep*2,
+			     yfrac + ds_ystep*3);
+	x1 = _mm_add_epi32 (x0, _mm_set1_epi32 (ds_xstep*4));
+	y1 = _mm_add_epi32 (y0, _mm_set1_epi32 (ds_ystep*4));
+	xstep8 = _mm_set1_epi32 (ds_xstep*8);
+	ystep8 = _mm_set1_epi32 (ds_ystep*8);
+	xmask = _mm_set1_epi32 (63);
+	ymask = _mm_set1_epi32 (63*64);
+
+	do
+	{
+	    // spot = ((yfrac>>(16-6))&(63*64)) + ((xfrac>>16)&63)
+	    _mm_store_si128 ((__m128i *)spot,
+			     _mm_or_si128 (_mm_and_si128 (_mm_srli_epi32 (y0, 16-6), ymask),
+					   _mm_and_si128 (_mm_srli_epi32 (x0, 16), xmask)));
+	    _mm_store_si128 ((__m128i *)(spot+4),
+			     _mm_or_si128 (_mm_and_si128 (_mm_srli_epi32 (y1, 16-6), ymask),
+					   _mm_and_si128 (_mm_srli_epi32 (x1, 16), xmask)));
+
+	    for (i=0 ; i<8 ; i++)
+		dest[i] = colormap[source[spot[i]]];
+
+	    x0 = _mm_add_epi32 (x0, xstep8);
+	    x1 = _mm_add_epi32 (x1, xstep8);
+	    y0 = _mm_add_epi32 (y0, ystep8);
+	    y1 = _mm_add_epi32 (y1, ystep8);
+	    xfrac += ds_xstep*8;
+	    yfrac += ds_ystep*8;
+	    dest += 8;
+	    count -= 8;
+	} while (count >= 8);
+    }
+
+    while (count--)
+    {
+	*dest++ = colormap[source[((yfrac>>(16-6))&(63*64)) + ((xfrac>>16)&63)]];
+	xfrac += ds_xstep;
+	yfrac += ds_ystep;
+    }
+}
+
+
+
+//
+// Packs the low bytes of eight dwords into 64 bits.
+//
+__attribute__((target("avx2")))
+static inline __m128i R_PackBytesAVX2 (__m256i v)
+{
+    __m256i	shuf;
+
+    shuf = _mm256_setr_epi8 (0, 4, 8, 12, -1, -1, -1, -1,
+			     -1, -1, -1, -1, -1, -1, -1, -1,
+			     0, 4, 8, 12, -1, -1, -1, -1,
+			     -1, -1, -1, -1, -1, -1, -1, -1);
+    v = _mm256_shuffle_epi8 (v, shuf);
+
+    return _mm_unpacklo_epi32 (_mm256_castsi256_si128 (v),
+			       _mm256_extracti128_si256 (v, 1));
+}
+
+
+//
+// R_DrawColumnAVX2
+//
+__attribute__((target("avx2")))
+void R_DrawColumnAVX2 (void)
+{
+    int			count;
+    byte*		dest;
+    byte*		source;
+    lighttable_t*	colormap;
+    fixed_t		frac;
+    fixed_t		fracstep;
+    __m256i		fracs;
+    __m256i		step8;
+    __m256i		mask;
+    __m256i		pixels;
+    byte		packed[8];
+    int			i;
+    int			stride;
+
+    count = dc_yh - dc_yl;
+
+    if (count < 0)
+	return;
+
+#ifdef RANGECHECK
+    if ((unsigned)dc_x >= screenwidth
+	|| dc_yl < 0
+	|| dc_yh >= screenheight)
+	I_Error ("R_DrawColumn: %i to %i at %i", dc_yl, dc_yh, dc_x);
+#endif
+
+    dest = ylookup[dc_yl] + columnofs[dc_x];
+    source = dc_source;
+    colormap = dc_colormap;
+    stride = rowstride;
+
+    fracstep = dc_iscale;
+    frac = dc_texturemid + (dc_yl-centery)*fracstep;
+
+    count++;
+
+    if (count >= 8)
+    {
+	fracs = _mm256_add_epi32 (_mm256_set1_epi32 (frac),
+				  _mm256_mullo_epi32 (_mm256_setr_epi32 (0,1,2,3,4,5,6,7),
+						      _mm256_set1_epi32 (fracstep)));
+	step8 = _mm256_set1_epi32 (fracstep*8);
+	mask = _mm256_set1_epi32 (127);
+
+	do
+	{
+	    pixels = _mm256_and_si256 (_mm256_srli_epi32 (fracs, FRACBITS), mask);
+	    pixels = _mm256_srli_epi32 (_mm256_i32gather_epi32 (GATHERBASE(source),
+								pixels, 1), 24);
+	    pixels = _mm256_srli_epi32 (_mm256_i32gather_epi32 (GATHERBASE(colormap),
+								pixels, 1), 24);
+	    if (stride == 1)
+	    {
+		// column major, the column is contiguous
+		_mm_storel_epi64 ((__m128i *)dest, R_PackBytesAVX2 (pixels));
+		dest += 8;
+	    }
+	    else
+	    {
+		// a byte per row
+		_mm_storel_epi64 ((__m128i *)packed, R_PackBytesAVX2 (pixels));
+		for (i=0 ; i<8 ; i++)
+		{
+		    *dest = packed[i];
+		    dest += stride;
+		}
+	    }
+
+	    fracs = _mm256_add_epi32 (fracs, step8);
+	    frac += fracstep*8;
+	    count -= 8;
+	} while (count >= 8);
+    }
+
+    while (count--)
+    {
+	*dest = colormap[source[(frac>>FRACBITS)&127]];
+	dest += stride;
+	frac += fracstep;
+    }
+}
+
+
+
+//
+// R_DrawSpanAVX2
+//
+__attribute__((target("avx2")))
+void R_DrawSpanAVX2 (void)
+{
+    int			count;
+    byte*		dest;
+    byte*		source;
+    lighttable_t*	colormap;
+    fixed_t		xfrac;
+    fixed_t		yfrac;
+    __m256i		lanes;
+    __m256i		xfracs;
+    __m256i		yfracs;
+    __m256i		xstep8;
+    __m256i		ystep8;
+    __m256i		xmask;
+    __m256i		ymask;
+    __m256i		pixels;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+	|| ds_x1<0
+	|| ds_x2>=screenwidth
+	|| (unsigned)ds_y>screenheight)
+    {
+	I_Error( "R_DrawSpan: %i to %i at %i",
+		 ds_x1,ds_x2,ds_y);
+    }
+#endif
+
+    xfrac = ds_xfrac;
+    yfrac = ds_yfrac;
+    source = ds_source;
+    colormap = ds_colormap;
+
+    dest = ylookup[ds_y] + columnofs[ds_x1];
+    count = ds_x2 - ds_x1 + 1;
+
+    if (count >= 8)
+    {
+	lanes = _mm256_setr_epi32 (0,1,2,3,4,5,6,7);
+	xfracs = _mm256_add_epi32 (_mm256_set1_epi32 (xfrac),
+				   _mm256_mullo_epi32 (lanes, _mm256_set1_epi32 (ds_xstep)));
+	yfracs = _mm256_add_epi32 (_mm256_set1_epi32 (yfrac),
+				   _mm256_mullo_epi32 (lanes, _mm256_set1_epi32 (ds_ystep)));
+	xstep8 = _mm256_set1_epi32 (ds_xstep*8);
+	ystep8 = _mm256_set1_epi32 (ds_ystep*8);
+	xmask = _mm256_set1_epi32 (63);
+	ymask = _mm256_set1_epi32 (63*64);
+
+	do
+	{
+	    pixels = _mm256_or_si256 (_mm256_and_si256 (_mm256_srli_epi32 (yfracs, 16-6), ymask),
+				      _mm256_and_si256 (_mm256_srli_epi32 (xfracs, 16), xmask));
+	    pixels = _mm256_srli_epi32 (_mm256_i32gather_epi32 (GATHERBASE(source),
+								pixels, 1), 24);
+	    pixels = _mm256_srli_epi32 (_mm256_i32gather_epi32 (GATHERBASE(colormap),
+								pixels, 1), 24);
+	    _mm_storel_epi64 ((__m128i *)dest, R_PackBytesAVX2 (pixels));
+
+	    xfracs = _mm256_add_epi32 (xfracs, xstep8);
+	    yfracs = _mm256_add_epi32 (yfracs, ystep8);
+	    xfrac += ds_xstep*8;
+	    yfrac += ds_ystep*8;
+	    dest += 8;
+	    count -= 8;
+	} while (count >= 8);
+    }
+
+    while (count--)
+    {
+	*dest++ = colormap[source[((yfrac>>(16-6))&(63*64)) + ((xfrac>>16)&63)]];
+	xfrac += ds_xstep;
+	yfrac += ds_ystep;
+    }
+}
+
+
+
+//
+// R_TransposeBlockSSE2
+// Four rounds of interleaving rows i and i+8
+//  move every byte to its transposed place.
+//
+__attribute__((target("sse2")))
+void
+R_TransposeBlockSSE2
+( byte*		src,
+  int		srcstride,
+  byte*		dest,
+  int		deststride )
+{
+    __m128i	a[16];
+    __m128i	b[16];
+    int		i;
+    int		round;
+
+    for (i=0 ; i<16 ; i++)
+	a[i] = _mm_loadu_si128 ((__m128i *)(src + i*srcstride));
+
+    for (round=0 ; round<4 ; round++)
+    {
+	for (i=0 ; i<8 ; i++)
+	{
+	    b[i*2] = _mm_unpacklo_epi8 (a[i], a[i+8]);
+	    b[i*2+1] = _mm_unpackhi_epi8 (a[i], a[i+8]);
+	}
+	for (i=0 ; i<16 ; i++)
+	    a[i] = b[i];
+    }
+
+    for (i=0 ; i<16 ; i++)
+	_mm_storeu_si128 ((__m128i *)(dest + i*deststride), a[i]);
+}
+
+#endif // SIMD_X86
+
+
+
+//
+// R_InitSIMD
+//
+void R_InitSIMD (void)
+{
+    drawcolumnfunc = R_DrawColumn;
+    drawspanfunc = R_DrawSpan;
+    transposefunc = R_TransposeBlock;
+
+    if (M_CheckParm ("-nosimd"))
+	return;
+
+#ifdef SIMD_X86
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("sse2"))
+	transposefunc = R_TransposeBlockSSE2;
+
+    // Only the spans are switched over.
+    // In bench/drawbench.c the vector columns were
+    //  no faster than R_DrawColumn, row or column major
+    //  (AVX2 slower, the gathers cost more than the
+    //  loop they replace).
+    // The vector spans store whole rows, so column
+    //  major keeps R_DrawSpan.
+    // -simdcolumns uses the vector columns anyway.
+    if (__builtin_cpu_supports ("avx2"))
+    {
+	if (!colmajor)
+	    drawspanfunc = R_DrawSpanAVX2;
+	if (M_CheckParm ("-simdcolumns"))
+	    drawcolumnfunc = R_DrawColumnAVX2;
+    }
+    else if (__builtin_cpu_supports ("sse2"))
+    {
+	if (!colmajor)
+	    drawspanfunc = R_DrawSpanSSE2;
+	if (M_CheckParm ("-simdcolumns"))
+	    drawcolumnfunc = R_DrawColumnSSE2;
+    }
+#endif
+}
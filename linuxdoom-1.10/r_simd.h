@@ -0,0 +1,70 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// DESCRIPTION:
+//	Vectorized column and span drawers.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __R_SIMD__
+#define __R_SIMD__
+
+
+#ifdef __GNUG__
+#pragma interface
+#endif
+
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#endif
+
+
+// The fastest high detail drawers this CPU runs,
+//  picked by R_InitSIMD, used by R_ExecuteSetViewSize.
+extern void	(*drawcolumnfunc) (void);
+extern void	(*drawspanfunc) (void);
+
+// Transposes a 16x16 block of bytes,
+//  dest[y*deststride+x] = src[x*srcstride+y].
+typedef void (*transposefunc_t) (byte* src, int srcstride,
+				 byte* dest, int deststride);
+
+extern transposefunc_t	transposefunc;
+
+void	R_TransposeBlock (byte* src, int srcstride, byte* dest, int deststride);
+
+// CPU detection. -nosimd keeps the C drawers.
+// -simdcolumns also vectorizes the column drawer.
+void R_InitSIMD (void);
+
+
+#ifdef SIMD_X86
+// Same output as R_DrawColumn and R_DrawSpan,
+//  byte for byte.
+void	R_DrawColumnSSE2 (void);
+void	R_DrawSpanSSE2 (void);
+void	R_DrawColumnAVX2 (void);
+void	R_DrawSpanAVX2 (void);
+void	R_TransposeBlockSSE2 (byte* src, int srcstride, byte* dest, int deststride);
+#endif
+
+
+#endif
+//-----------------------------------------------------------------------------
+//
+// $Log:$
+//
+//-----------------------------------------------------------------------------
@@ -0,0 +1,285 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Per frame timing and counts of the renderer,
+//	 and the load of the sound mixer and music.
+//	-rstats draws rolling averages and high water marks
+//	 over the view, -rstatscsv <file> writes one row per frame,
+//	 with the map and view position, to find the frames
+//	 that blow the budget.
+//
+//-----------------------------------------------------------------------------
+
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+
+#include <stdio.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "i_system.h"
+#include "i_sound.h"
+#include "m_argv.h"
+#include "m_menu.h"
+
+#include "r_local.h"
+#include "r_stats.h"
+
+
+// Counts taken by R_CountStats.
+enum
+{
+    rc_segs,
+    rc_visplanes,
+    rc_drawsegs,
+    rc_vissprites,
+    rc_openings,
+    rc_mixus,		// longest mixer chunk in the frame
+    rc_voices,		// sounds mixed
+    rc_virtual,		// sounds playing but not mixed
+    rc_musunder,	// mixer chunks the music was late for
+    rc_musahead,	// ms of music rendered ahead
+    NUMRCOUNTS
+};
+
+// Frames in the rolling average.
+#define AVGFRAMES	32
+
+typedef struct
+{
+    // microseconds per phase, the last one is the whole frame
+    unsigned	time[NUMRTIMERS+1];
+    int		count[NUMRCOUNTS];
+
+} rframe_t;
+
+
+boolean			rstats;
+
+static boolean		showstats;
+static FILE*		csvfile;
+
+static rframe_t		curframe;
+static rframe_t		history[AVGFRAMES];
+static rframe_t		highwater;
+static int		numframes;
+
+static unsigned		starttime[NUMRTIMERS];
+static unsigned		lastfinish;
+
+static char*		timernames[NUMRTIMERS+1] =
+{
+    "setup", "bsp", "planes", "masked", "strips", "hud", "blit", "frame"
+};
+
+static char*		countnames[NUMRCOUNTS] =
+{
+    "segs", "visplanes", "drawsegs", "vissprites", "openings",
+    "mix_us", "voices", "virtual", "mus_under", "mus_ms"
+};
+
+
+
+//
+// R_InitStats
+//
+void R_InitStats (void)
+{
+    int		p;
+    int		i;
+
+    showstats = M_CheckParm ("-rstats") != 0;
+
+    p = M_CheckParm ("-rstatscsv");
+    if (p && p < myargc-1)
+    {
+	csvfile = fopen (myargv[p+1], "w");
+	if (!csvfile)
+	    I_Error ("R_InitStats: couldn't open %s", myargv[p+1]);
+
+	fprintf (csvfile, "frame,gametic,episode,map,x,y,angle");
+	for (i=0 ; i<NUMRTIMERS+1 ; i++)
+	    fprintf (csvfile, ",%s_us", timernames[i]);
+	for (i=0 ; i<NUMRCOUNTS ; i++)
+	    fprintf (csvfile, ",%s", countnames[i]);
+	fprintf (csvfile, "\n");
+    }
+
+    rstats = showstats || csvfile;
+}
+
+
+
+//
+// R_StartTimer
+//
+void R_StartTimer (rtimer_t timer)
+{
+    if (!rstats)
+	return;
+
+    starttime[timer] = I_GetTimeUS ();
+}
+
+
+//
+// R_StopTimer
+//
+void R_StopTimer (rtimer_t timer)
+{
+    if (!rstats)
+	return;
+
+    curframe.time[timer] += I_GetTimeUS () - starttime[timer];
+}
+
+
+//
+// R_CountStats
+//
+void R_CountStats (void)
+{
+    mixstats_t	mix;
+
+    if (!rstats)
+	return;
+
+    I_GetMixStats (&mix);
+    curframe.count[rc_mixus] = mix.peakus;
+    curframe.count[rc_voices] = mix.heard;
+    curframe.count[rc_virtual] = mix.virtualvoices;
+    curframe.count[rc_musunder] = mix.musicunderruns;
+    curframe.count[rc_musahead] = mix.musicaheadms;
+
+    curframe.count[rc_segs] = linecount;
+    curframe.count[rc_visplanes] = numvisplanes;
+    curframe.count[rc_drawsegs] = ds_p - drawsegs;
+    curframe.count[rc_vissprites] = vissprite_p - vissprites;
+    curframe.count[rc_openings] = numopenings;
+}
+
+
+
+//
+// R_DrawStats
+//
+#define STATLINE	8
+
+static void
+R_DrawStatLine
+( int		y,
+  char*		name,
+  char*		fmt,
+  double	avg,
+  double	max )
+{
+    char	buf[16];
+
+    M_WriteText (2, y, name);
+    sprintf (buf, fmt, avg);
+    M_WriteText (85, y, buf);
+    sprintf (buf, fmt, max);
+    M_WriteText (135, y, buf);
+}
+
+void R_DrawStats (void)
+{
+    double	sum;
+    int		frames;
+    int		i;
+    int		j;
+    int		y;
+
+    if (!showstats)
+	return;
+
+    frames = numframes < AVGFRAMES ? numframes : AVGFRAMES;
+    if (!frames)
+	return;
+
+    y = 2;
+    M_WriteText (85, y, "avg");
+    M_WriteText (135, y, "max");
+    y += STATLINE;
+
+    // times in milliseconds
+    for (i=0 ; i<NUMRTIMERS+1 ; i++, y+=STATLINE)
+    {
+	sum = 0;
+	for (j=0 ; j<frames ; j++)
+	    sum += history[j].time[i];
+	R_DrawStatLine (y, timernames[i], "%.2f",
+			sum/frames/1000, highwater.time[i]/1000.0);
+    }
+
+    for (i=0 ; i<NUMRCOUNTS ; i++, y+=STATLINE)
+    {
+	sum = 0;
+	for (j=0 ; j<frames ; j++)
+	    sum += history[j].count[i];
+	R_DrawStatLine (y, countnames[i], "%.0f",
+			sum/frames, highwater.count[i]);
+    }
+}
+
+
+
+//
+// R_FinishStats
+//
+void R_FinishStats (void)
+{
+    unsigned	now;
+    int		i;
+
+    if (!rstats)
+	return;
+
+    now = I_GetTimeUS ();
+    if (numframes)
+	curframe.time[NUMRTIMERS] = now - lastfinish;
+    lastfinish = now;
+
+    for (i=0 ; i<NUMRTIMERS+1 ; i++)
+	if (curframe.time[i] > highwater.time[i])
+	    highwater.time[i] = curframe.time[i];
+    for (i=0 ; i<NUMRCOUNTS ; i++)
+	if (curframe.count[i] > highwater.count[i])
+	    highwater.count[i] = curframe.count[i];
+
+    if (csvfile)
+    {
+	fprintf (csvfile, "%i,%i,%i,%i,%i,%i,%i",
+		 numframes, gametic, gameepisode, gamemap,
+		 viewx>>FRACBITS, viewy>>FRACBITS,
+		 (int)(viewangle/(ANG45/45)));
+	for (i=0 ; i<NUMRTIMERS+1 ; i++)
+	    fprintf (csvfile, ",%u", curframe.time[i]);
+	for (i=0 ; i<NUMRCOUNTS ; i++)
+	    fprintf (csvfile, ",%i", curframe.count[i]);
+	fprintf (csvfile, "\n");
+    }
+
+    history[numframes%AVGFRAMES] = curframe;
+    numframes++;
+
+    memset (&curframe, 0, sizeof(curframe));
+}
@@ -0,0 +1,78 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// DESCRIPTION:
+//	Per frame timing and counts of the renderer.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __R_STATS__
+#define __R_STATS__
+
+
+#ifdef __GNUG__
+#pragma interface
+#endif
+
+
+//
+// The timed phases of a frame, in drawing order.
+//
+typedef enum
+{
+    rt_setup,	// R_SetupFrame and clearing
+    rt_bsp,	// R_RenderBSPNode
+    rt_planes,	// R_DrawPlanes
+    rt_masked,	// R_DrawMasked
+    rt_strips,	// R_FinishStrips and R_TransposeView
+    rt_hud,	// ST_Drawer and HU_Drawer
+    rt_blit,	// I_FinishUpdate
+    NUMRTIMERS
+
+} rtimer_t;
+
+
+// Set by -rstats or -rstatscsv,
+//  nothing is measured otherwise.
+extern boolean		rstats;
+
+
+// Reads -rstats and -rstatscsv <file>.
+void R_InitStats (void);
+
+// Around each phase, a phase can be timed
+//  more than once in a frame.
+void R_StartTimer (rtimer_t timer);
+void R_StopTimer (rtimer_t timer);
+
+// Takes the counts of the view just rendered,
+//  from the end of R_RenderPlayerView.
+void R_CountStats (void);
+
+// Draws the averages and high water marks
+//  on top of the frame, with -rstats.
+void R_DrawStats (void);
+
+// After the frame is on screen.
+// Writes the CSV row and starts a new frame.
+void R_FinishStats (void);
+
+
+#endif
+//-----------------------------------------------------------------------------
+//
+// $Log:$
+//
+//-----------------------------------------------------------------------------
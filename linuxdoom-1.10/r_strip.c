@@ -0,0 +1,378 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Multithreaded strip drawing.
+//	BSP traversal, clipping and sorting stay on the main thread,
+//	 the column and span drawers only record what they would draw.
+//	The recorded commands are then drawn by N threads, each one
+//	 owning a vertical strip of the view, in recorded order.
+//	Every pixel is written by exactly the same sequence of draws
+//	 as in the serial renderer, so the output is identical.
+//
+//-----------------------------------------------------------------------------
+
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+
+#include <stdlib.h>
+
+#include "doomdef.h"
+
+#include "i_system.h"
+#include "i_thread.h"
+#include "z_zone.h"
+#include "m_argv.h"
+
+#include "r_local.h"
+
+#ifdef __GNUG__
+#pragma implementation "r_strip.h"
+#endif
+#include "r_strip.h"
+
+
+// Commands recorded between flushes.
+#define MAXSTRIPCMDS		16384
+
+// Same limit as the worker pool.
+#define MAXSTRIPS		64
+
+
+typedef enum
+{
+    sc_column,
+    sc_fuzzcolumn,
+    sc_span
+
+} stripcmdtype_t;
+
+
+//
+// A recorded column or span,
+//  the values of the dc_* or ds_* globals at the call.
+//
+typedef struct
+{
+    stripcmdtype_t	type;
+    void		(*func) (void);
+
+    int			x;		// dc_x, or ds_y for spans
+    int			y1;		// dc_yl, or ds_x1
+    int			y2;		// dc_yh, or ds_x2
+
+    lighttable_t*	colormap;
+    byte*		source;
+    byte*		translation;
+
+    fixed_t		frac;		// dc_texturemid, or ds_xfrac
+    fixed_t		step;		// dc_iscale, or ds_xstep
+    fixed_t		yfrac;		// spans only
+    fixed_t		ystep;
+
+    int			fuzzpos;	// fuzz columns only
+
+} stripcmd_t;
+
+
+int			numstrips = 1;
+
+static stripcmd_t*	stripcmds;
+static int		numstripcmds;
+static boolean		stripsactive;
+
+// The real drawers, while the recorders are hooked in.
+static void		(*drawcolumn) (void);
+static void		(*drawfuzzcolumn) (void);
+static void		(*drawtranscolumn) (void);
+static void		(*drawspan) (void);
+
+
+
+//
+// R_NewStripCmd
+//
+static stripcmd_t* R_NewStripCmd (void)
+{
+    if (numstripcmds == MAXSTRIPCMDS)
+	R_FlushStrips ();
+
+    return &stripcmds[numstripcmds++];
+}
+
+
+//
+// Copy the drawer globals to and from a command.
+//
+static void R_SaveColumn (stripcmd_t* cmd)
+{
+    cmd->x = dc_x;
+    cmd->y1 = dc_yl;
+    cmd->y2 = dc_yh;
+    cmd->colormap = dc_colormap;
+    cmd->source = dc_source;
+    cmd->translation = dc_translation;
+    cmd->frac = dc_texturemid;
+    cmd->step = dc_iscale;
+    cmd->fuzzpos = fuzzpos;
+}
+
+
+static void R_LoadColumn (stripcmd_t* cmd)
+{
+    dc_x = cmd->x;
+    dc_yl = cmd->y1;
+    dc_yh = cmd->y2;
+    dc_colormap = cmd->colormap;
+    dc_source = cmd->source;
+    dc_translation = cmd->translation;
+    dc_texturemid = cmd->frac;
+    dc_iscale = cmd->step;
+    fuzzpos = cmd->fuzzpos;
+}
+
+
+static void R_SaveSpan (stripcmd_t* cmd)
+{
+    cmd->x = ds_y;
+    cmd->y1 = ds_x1;
+    cmd->y2 = ds_x2;
+    cmd->colormap = ds_colormap;
+    cmd->source = ds_source;
+    cmd->frac = ds_xfrac;
+    cmd->step = ds_xstep;
+    cmd->yfrac = ds_yfrac;
+    cmd->ystep = ds_ystep;
+}
+
+
+static void R_LoadSpan (stripcmd_t* cmd)
+{
+    ds_y = cmd->x;
+    ds_x1 = cmd->y1;
+    ds_x2 = cmd->y2;
+    ds_colormap = cmd->colormap;
+    ds_source = cmd->source;
+    ds_xfrac = cmd->frac;
+    ds_xstep = cmd->step;
+    ds_yfrac = cmd->yfrac;
+    ds_ystep = cmd->ystep;
+}
+
+
+
+//
+// The recorders hooked in as colfunc and friends.
+//
+static void R_RecordColumn (void)
+{
+    stripcmd_t*	cmd = R_NewStripCmd ();
+
+    cmd->type = sc_column;
+    cmd->func = drawcolumn;
+    R_SaveColumn (cmd);
+}
+
+
+static void R_RecordTranslatedColumn (void)
+{
+    stripcmd_t*	cmd = R_NewStripCmd ();
+
+    cmd->type = sc_column;
+    cmd->func = drawtranscolumn;
+    R_SaveColumn (cmd);
+}
+
+
+static void R_RecordFuzzColumn (void)
+{
+    stripcmd_t*	cmd = R_NewStripCmd ();
+
+    cmd->type = sc_fuzzcolumn;
+    cmd->func = drawfuzzcolumn;
+    R_SaveColumn (cmd);
+
+    // keep the fuzz table running as if it was drawn
+    R_SkipFuzzColumn ();
+}
+
+
+static void R_RecordSpan (void)
+{
+    stripcmd_t*	cmd = R_NewStripCmd ();
+
+    cmd->type = sc_span;
+    cmd->func = drawspan;
+    R_SaveSpan (cmd);
+}
+
+
+
+//
+// R_DrawStrip
+// Draws the part of every recorded command
+//  that falls inside the strip.
+// The dc_* and ds_* globals are per thread.
+//
+static void R_DrawStrip (int index, void* arg)
+{
+    stripcmd_t*	cmd;
+    stripcmd_t*	end;
+    int		x1;
+    int		x2;
+    unsigned	skip;
+
+    x1 = index*viewwidth/numstrips;
+    x2 = (index+1)*viewwidth/numstrips - 1;
+
+    end = stripcmds + numstripcmds;
+
+    for (cmd = stripcmds ; cmd < end ; cmd++)
+    {
+	if (cmd->type == sc_span)
+	{
+	    if (cmd->y2 < x1 || cmd->y1 > x2)
+		continue;
+
+	    R_LoadSpan (cmd);
+
+	    // Step the texture coordinates to the strip edge,
+	    //  wrapping the same way the drawer's adds do.
+	    if (ds_x1 < x1)
+	    {
+		skip = x1 - ds_x1;
+		ds_xfrac = (unsigned)ds_xfrac + skip*(unsigned)ds_xstep;
+		ds_yfrac = (unsigned)ds_yfrac + skip*(unsigned)ds_ystep;
+		ds_x1 = x1;
+	    }
+	    if (ds_x2 > x2)
+		ds_x2 = x2;
+	}
+	else
+	{
+	    if (cmd->x < x1 || cmd->x > x2)
+		continue;
+
+	    R_LoadColumn (cmd);
+	}
+
+	cmd->func ();
+    }
+}
+
+
+
+//
+// R_FlushStrips
+//
+void R_FlushStrips (void)
+{
+    stripcmd_t	column;
+    stripcmd_t	span;
+
+    if (!numstripcmds)
+	return;
+
+    // The calling thread draws strip 0 with its own
+    //  globals, which the renderer may still be using.
+    R_SaveColumn (&column);
+    R_SaveSpan (&span);
+
+    I_RunParallel (numstrips, R_DrawStrip, NULL);
+
+    R_LoadColumn (&column);
+    R_LoadSpan (&span);
+
+    numstripcmds = 0;
+}
+
+
+
+//
+// R_StartStrips
+//
+void R_StartStrips (void)
+{
+    // The low detail drawers write past the ends
+    //  of their spans, so they are left serial.
+    if (numstrips <= 1 || detailshift)
+	return;
+
+    drawcolumn = basecolfunc;
+    drawfuzzcolumn = fuzzcolfunc;
+    drawtranscolumn = transcolfunc;
+    drawspan = spanfunc;
+
+    colfunc = basecolfunc = R_RecordColumn;
+    fuzzcolfunc = R_RecordFuzzColumn;
+    transcolfunc = R_RecordTranslatedColumn;
+    spanfunc = R_RecordSpan;
+
+    stripsactive = true;
+}
+
+
+//
+// R_FinishStrips
+//
+void R_FinishStrips (void)
+{
+    if (!stripsactive)
+	return;
+
+    R_FlushStrips ();
+
+    colfunc = basecolfunc = drawcolumn;
+    fuzzcolfunc = drawfuzzcolumn;
+    transcolfunc = drawtranscolumn;
+    spanfunc = drawspan;
+
+    stripsactive = false;
+}
+
+
+
+//
+// R_InitStrips
+//
+void R_InitStrips (void)
+{
+    int		p;
+
+    numstrips = 1;
+
+    // -rthreads 0 uses every processor
+    p = M_CheckParm ("-rthreads");
+    if (p && p < myargc-1)
+    {
+	numstrips = atoi (myargv[p+1]);
+	if (numstrips <= 0)
+	    numstrips = I_NumProcessors ();
+	if (numstrips > MAXSTRIPS)
+	    numstrips = MAXSTRIPS;
+    }
+
+    if (numstrips <= 1)
+	return;
+
+    stripcmds = Z_Malloc (MAXSTRIPCMDS*sizeof(*stripcmds), PU_STATIC, NULL);
+
+    // textures a recorded draw reads from must
+    //  stay put until it has been drawn
+    zonefreehook = R_FlushStrips;
+}
@@ -0,0 +1,56 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// DESCRIPTION:
+//	Multithreaded strip drawing for the player view.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __R_STRIP__
+#define __R_STRIP__
+
+
+#ifdef __GNUG__
+#pragma interface
+#endif
+
+
+// Number of vertical strips the view is split into,
+//  1 draws everything on the calling thread.
+extern int		numstrips;
+
+
+// Reads -rthreads and allocates the command buffer.
+void R_InitStrips (void);
+
+// Called around R_RenderPlayerView.
+// While active, the draw functions only record their
+//  parameters, and the recorded columns and spans
+//  are drawn in parallel, one strip per thread.
+void R_StartStrips (void);
+void R_FinishStrips (void);
+
+// Draws everything recorded so far.
+// Must be called before a texture a recorded draw reads
+//  from can be freed, see Z_Free.
+void R_FlushStrips (void);
+
+
+#endif
+//-----------------------------------------------------------------------------
+//
+// $Log:$
+//
+//-----------------------------------------------------------------------------
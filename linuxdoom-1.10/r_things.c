@@ -38,9 +38,13 @@ rcsid[] = "$Id: r_things.c,v 1.5 1997/02/03 16:47:56 b1 Exp $";
 #include "w_wad.h"
 
 #include "r_local.h"
+#include "r_interp.h"
+#include "r_cache.h"
 
 #include "doomstat.h"
 
+#include "v_video.h"
+
 
 
 #define MINZ				(FRACUNIT*4)
@@ -78,8 +82,12 @@ lighttable_t**	spritelights;
 
 // constant arrays
 //  used for psprite clipping and initializing clipping
-short		negonearray[SCREENWIDTH];
-short		screenheightarray[SCREENWIDTH];
+short*		negonearray;
+short*		screenheightarray;
+
+// R_DrawSprite clip arrays
+static short*	clipbot;
+static short*	cliptop;
 
 
 //
@@ -159,6 +167,78 @@ R_InstallSpriteLump
 
 
 
+//
+// R_LoadSpriteDefs
+// The frames from the cache file, used in place.
+//
+static boolean R_LoadSpriteDefs (void)
+{
+    byte*	p;
+    byte*	end;
+    int		length;
+    int		i;
+
+    p = R_CacheSection (rs_spritedefs, &length);
+    if (!p)
+	return false;
+    end = p + length;
+
+    if (*(int *)p != numsprites)
+	I_Error ("R_InitSprites: the sprite cache is damaged, "
+		 "delete it or use -nodatacache");
+    p += sizeof(int);
+
+    sprites = Z_Malloc(numsprites *sizeof(*sprites), PU_STATIC, NULL);
+
+    for (i=0 ; i<numsprites && p < end ; i++)
+    {
+	sprites[i].numframes = *(int *)p;
+	p += sizeof(int);
+	sprites[i].spriteframes = (spriteframe_t *)p;
+	p += sprites[i].numframes*sizeof(spriteframe_t);
+    }
+
+    if (i < numsprites || p != end)
+	I_Error ("R_InitSprites: the sprite cache is damaged, "
+		 "delete it or use -nodatacache");
+
+    return true;
+}
+
+
+//
+// R_SaveSpriteDefs
+// For the cache file.
+//
+static void R_SaveSpriteDefs (void)
+{
+    byte*	data;
+    byte*	p;
+    int		length;
+    int		i;
+
+    length = sizeof(int);
+    for (i=0 ; i<numsprites ; i++)
+	length += sizeof(int) + sprites[i].numframes*sizeof(spriteframe_t);
+
+    data = p = Z_Malloc (length, PU_STATIC, NULL);
+
+    *(int *)p = numsprites;
+    p += sizeof(int);
+
+    for (i=0 ; i<numsprites ; i++)
+    {
+	*(int *)p = sprites[i].numframes;
+	p += sizeof(int);
+	memcpy (p, sprites[i].spriteframes,
+		sprites[i].numframes*sizeof(spriteframe_t));
+	p += sprites[i].numframes*sizeof(spriteframe_t);
+    }
+
+    R_AddSection (rs_spritedefs, data, length);
+}
+
+
 //
 // R_InitSpriteDefs
 // Pass a null terminated list of sprite names
@@ -195,6 +275,9 @@ void R_InitSpriteDefs (char** namelist)
 	
     if (!numsprites)
 	return;
+
+    if (R_LoadSpriteDefs ())
+	return;
 		
     sprites = Z_Malloc(numsprites *sizeof(*sprites), PU_STATIC, NULL);
 	
@@ -278,6 +361,8 @@ void R_InitSpriteDefs (char** namelist)
 	memcpy (sprites[i].spriteframes, sprtemp, maxframe*sizeof(spriteframe_t));
     }
 
+    if (R_CacheEnabled ())
+	R_SaveSpriteDefs ();
 }
 
 
@@ -286,10 +371,15 @@ void R_InitSpriteDefs (char** namelist)
 //
 // GAME FUNCTIONS
 //
-vissprite_t	vissprites[MAXVISSPRITES];
+vissprite_t*	vissprites;
 vissprite_t*	vissprite_p;
+int		maxvissprites;
 int		newvissprite;
 
+// sorted pointers, and the other half of the merge
+vissprite_t**	vsprsorted;
+vissprite_t**	vsprmerge;
+
 
 
 //
@@ -299,8 +389,13 @@ int		newvissprite;
 void R_InitSprites (char** namelist)
 {
     int		i;
+
+    negonearray = Z_Malloc (screenwidth*sizeof(short), PU_STATIC, NULL);
+    screenheightarray = Z_Malloc (screenwidth*sizeof(short), PU_STATIC, NULL);
+    clipbot = Z_Malloc (screenwidth*sizeof(short), PU_STATIC, NULL);
+    cliptop = Z_Malloc (screenwidth*sizeof(short), PU_STATIC, NULL);
 	
-    for (i=0 ; i<SCREENWIDTH ; i++)
+    for (i=0 ; i<screenwidth ; i++)
     {
 	negonearray[i] = -1;
     }
@@ -322,13 +417,36 @@ void R_ClearSprites (void)
 
 //
 // R_NewVisSprite
+// Doubles the list when it is full,
+//  so after a few frames it stops growing.
 //
-vissprite_t	overflowsprite;
-
 vissprite_t* R_NewVisSprite (void)
 {
-    if (vissprite_p == &vissprites[MAXVISSPRITES])
-	return &overflowsprite;
+    vissprite_t*	newsprites;
+    int			count;
+
+    count = vissprite_p - vissprites;
+
+    if (count == maxvissprites)
+    {
+	maxvissprites = maxvissprites ? maxvissprites*2 : 128;
+	newsprites = Z_Malloc (maxvissprites*sizeof(*newsprites),
+			       PU_STATIC, NULL);
+	if (vissprites)
+	{
+	    memcpy (newsprites, vissprites, count*sizeof(*newsprites));
+	    Z_Free (vissprites);
+	    Z_Free (vsprsorted);
+	    Z_Free (vsprmerge);
+	}
+	vissprites = newsprites;
+	vissprite_p = vissprites + count;
+
+	vsprsorted = Z_Malloc (maxvissprites*sizeof(*vsprsorted),
+			       PU_STATIC, NULL);
+	vsprmerge = Z_Malloc (maxvissprites*sizeof(*vsprmerge),
+			      PU_STATIC, NULL);
+    }
     
     vissprite_p++;
     return vissprite_p-1;
@@ -416,7 +534,7 @@ R_DrawVisSprite
     }
     else if (vis->mobjflags & MF_TRANSLATION)
     {
-	colfunc = R_DrawTranslatedColumn;
+	colfunc = transcolfunc;
 	dc_translation = translationtables - 256 +
 	    ( (vis->mobjflags & MF_TRANSLATION) >> (MF_TRANSSHIFT-8) );
     }
@@ -478,10 +596,19 @@ void R_ProjectSprite (mobj_t* thing)
     
     angle_t		ang;
     fixed_t		iscale;
+
+    fixed_t		thingx;
+    fixed_t		thingy;
+    fixed_t		thingz;
+
+    // between tics, if uncapped
+    thingx = R_LerpFixed (thing->oldx, thing->x);
+    thingy = R_LerpFixed (thing->oldy, thing->y);
+    thingz = R_LerpFixed (thing->oldz, thing->z);
     
     // transform the origin point
-    tr_x = thing->x - viewx;
-    tr_y = thing->y - viewy;
+    tr_x = thingx - viewx;
+    tr_y = thingy - viewy;
 	
     gxt = FixedMul(tr_x,viewcos); 
     gyt = -FixedMul(tr_y,viewsin);
@@ -519,7 +646,7 @@ void R_ProjectSprite (mobj_t* thing)
     if (sprframe->rotate)
     {
 	// choose a different rotation based on player view
-	ang = R_PointToAngle (thing->x, thing->y);
+	ang = R_PointToAngle (thingx, thingy);
 	rot = (ang-thing->angle+(unsigned)(ANG45/2)*9)>>29;
 	lump = sprframe->lump[rot];
 	flip = (boolean)sprframe->flip[rot];
@@ -550,10 +677,10 @@ void R_ProjectSprite (mobj_t* thing)
     vis = R_NewVisSprite ();
     vis->mobjflags = thing->flags;
     vis->scale = xscale<<detailshift;
-    vis->gx = thing->x;
-    vis->gy = thing->y;
-    vis->gz = thing->z;
-    vis->gzt = thing->z + spritetopoffset[lump];
+    vis->gx = thingx;
+    vis->gy = thingy;
+    vis->gz = thingz;
+    vis->gzt = thingz + spritetopoffset[lump];
     vis->texturemid = vis->gzt - viewz;
     vis->x1 = x1 < 0 ? 0 : x1;
     vis->x2 = x2 >= viewwidth ? viewwidth-1 : x2;	
@@ -780,57 +907,68 @@ void R_DrawPlayerSprites (void)
 
 //
 // R_SortVisSprites
+// Bottom up merge sort on scale, smallest first.
+// Equal scales keep the order they were added in,
+//  as the old selection sort did, so the draw order
+//  is exactly the same.
 //
-vissprite_t	vsprsortedhead;
-
-
 void R_SortVisSprites (void)
 {
     int			i;
     int			count;
-    vissprite_t*	ds;
-    vissprite_t*	best;
-    vissprite_t		unsorted;
-    fixed_t		bestscale;
+    int			width;
+    int			lo;
+    int			mid;
+    int			hi;
+    int			a;
+    int			b;
+    vissprite_t**	src;
+    vissprite_t**	dest;
+    vissprite_t**	swap;
 
     count = vissprite_p - vissprites;
-	
-    unsorted.next = unsorted.prev = &unsorted;
 
-    if (!count)
-	return;
-		
-    for (ds=vissprites ; ds<vissprite_p ; ds++)
-    {
-	ds->next = ds+1;
-	ds->prev = ds-1;
-    }
-    
-    vissprites[0].prev = &unsorted;
-    unsorted.next = &vissprites[0];
-    (vissprite_p-1)->next = &unsorted;
-    unsorted.prev = vissprite_p-1;
-    
-    // pull the vissprites out by scale
-    //best = 0;		// shut up the compiler warning
-    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
+    src = vsprsorted;
+    dest = vsprmerge;
+
     for (i=0 ; i<count ; i++)
+	src[i] = &vissprites[i];
+
+    for (width=1 ; width<count ; width*=2)
     {
-	bestscale = MAXINT;
-	for (ds=unsorted.next ; ds!= &unsorted ; ds=ds->next)
+	for (lo=0 ; lo<count ; lo+=2*width)
 	{
-	    if (ds->scale < bestscale)
+	    mid = lo+width < count ? lo+width : count;
+	    hi = lo+2*width < count ? lo+2*width : count;
+
+	    a = lo;
+	    b = mid;
+	    i = lo;
+
+	    // take from the left run unless the right is smaller
+	    while (a < mid && b < hi)
 	    {
-		bestscale = ds->scale;
-		best = ds;
+		if (src[b]->scale < src[a]->scale)
+		    dest[i++] = src[b++];
+		else
+		    dest[i++] = src[a++];
 	    }
+	    while (a < mid)
+		dest[i++] = src[a++];
+	    while (b < hi)
+		dest[i++] = src[b++];
 	}
-	best->next->prev = best->prev;
-	best->prev->next = best->next;
-	best->next = &vsprsortedhead;
-	best->prev = vsprsortedhead.prev;
-	vsprsortedhead.prev->next = best;
-	vsprsortedhead.prev = best;
+
+	swap = src;
+	src = dest;
+	dest = swap;
+    }
+
+    // the last pass may have left it in the other array
+    if (src != vsprsorted)
+    {
+	vsprmerge = vsprsorted;
+	vsprsorted = src;
     }
 }
 
@@ -842,8 +980,6 @@ void R_SortVisSprites (void)
 void R_DrawSprite (vissprite_t* spr)
 {
     drawseg_t*		ds;
-    short		clipbot[SCREENWIDTH];
-    short		cliptop[SCREENWIDTH];
     int			x;
     int			r1;
     int			r2;
@@ -957,22 +1093,17 @@ void R_DrawSprite (vissprite_t* spr)
 //
 void R_DrawMasked (void)
 {
-    vissprite_t*	spr;
+    int			i;
+    int			count;
     drawseg_t*		ds;
 	
     R_SortVisSprites ();
 
-    if (vissprite_p > vissprites)
-    {
-	// draw all vissprites back to front
-	for (spr = vsprsortedhead.next ;
-	     spr != &vsprsortedhead ;
-	     spr=spr->next)
-	{
-	    
-	    R_DrawSprite (spr);
-	}
-    }
+    // draw all vissprites back to front
+    count = vissprite_p - vissprites;
+
+    for (i=0 ; i<count ; i++)
+	R_DrawSprite (vsprsorted[i]);
     
     // render any remaining masked mid textures
     for (ds=ds_p-1 ; ds >= drawsegs ; ds--)
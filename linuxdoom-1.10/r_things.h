@@ -28,16 +28,17 @@
 #pragma interface
 #endif
 
-#define MAXVISSPRITES  	128
-
-extern vissprite_t	vissprites[MAXVISSPRITES];
+// Grows as needed, so there is no limit.
+extern vissprite_t*	vissprites;
 extern vissprite_t*	vissprite_p;
-extern vissprite_t	vsprsortedhead;
+
+// Back to front, made by R_SortVisSprites.
+extern vissprite_t**	vsprsorted;
 
 // Constant arrays used for psprite clipping
 //  and initializing clipping.
-extern short		negonearray[SCREENWIDTH];
-extern short		screenheightarray[SCREENWIDTH];
+extern short*		negonearray;
+extern short*		screenheightarray;
 
 // vars for R_DrawMaskedColumn
 extern short*		mfloorclip;
@@ -32,6 +32,7 @@ rcsid[] = "$Id: st_stuff.c,v 1.6 1997/02/03 22:45:13 b1 Exp $";
 #include "i_system.h"
 #include "i_video.h"
 #include "z_zone.h"
+#include "z_stats.h"
 #include "m_random.h"
 #include "w_wad.h"
 
@@ -463,6 +464,13 @@ unsigned char	cheat_mypos_seq[] =
 }; 
 
 
+// zone and lump cache cheat
+unsigned char	cheat_mem_seq[] =
+{
+    0xb2, 0x26, 0xb6, 0xa6, 0xb6, 0xff	// idmem
+};
+
+
 // Now what?
 cheatseq_t	cheat_mus = { cheat_mus_seq, 0 };
 cheatseq_t	cheat_god = { cheat_god_seq, 0 };
@@ -485,6 +493,7 @@ cheatseq_t	cheat_powerup[7] =
 cheatseq_t	cheat_choppers = { cheat_choppers_seq, 0 };
 cheatseq_t	cheat_clev = { cheat_clev_seq, 0 };
 cheatseq_t	cheat_mypos = { cheat_mypos_seq, 0 };
+cheatseq_t	cheat_mem = { cheat_mem_seq, 0 };
 
 
 // 
@@ -499,14 +508,16 @@ void ST_Stop(void);
 void ST_refreshBackground(void)
 {
 
+    // The background is drawn where it is on screen,
+    //  so it scales to the same real rows.
     if (st_statusbaron)
     {
-	V_DrawPatch(ST_X, 0, BG, sbar);
+	V_DrawPatch(ST_X, ST_Y, BG, sbar);
 
 	if (netgame)
-	    V_DrawPatch(ST_FX, 0, BG, faceback);
+	    V_DrawPatch(ST_FX, ST_Y, BG, faceback);
 
-	V_CopyRect(ST_X, 0, BG, ST_WIDTH, ST_HEIGHT, ST_X, ST_Y, FG);
+	V_CopyRect(ST_X, ST_Y, BG, ST_WIDTH, ST_HEIGHT, ST_X, ST_Y, FG);
     }
 
 }
@@ -670,6 +681,12 @@ ST_Responder (event_t* ev)
 		players[consoleplayer].mo->y);
 	plyr->message = buf;
       }
+      // 'mem' for the zone and lump cache, all of it on stdout
+      else if (cht_CheckCheat(&cheat_mem, ev->data1))
+      {
+	plyr->message = Z_StatsMessage ();
+	Z_WriteStats (stdout);
+      }
     }
     
     // 'clev' change-level cheat
@@ -1467,5 +1484,5 @@ void ST_Init (void)
 {
     veryfirsttime = 0;
     ST_loadData();
-    screens[4] = (byte *) Z_Malloc(ST_WIDTH*ST_HEIGHT, PU_STATIC, 0);
+    screens[4] = (byte *) Z_Malloc(screenwidth*screenheight, PU_STATIC, 0);
 }
@@ -28,20 +28,30 @@ static const char __attribute__((unused))
 rcsid[] = "$Id: v_video.c,v 1.5 1997/02/03 22:45:13 b1 Exp $";
 
 
+#include <stdlib.h>
+
 #include "i_system.h"
 #include "r_local.h"
 
 #include "doomdef.h"
 #include "doomdata.h"
 
+#include "m_argv.h"
 #include "m_bbox.h"
 #include "m_swap.h"
 
 #include "v_video.h"
 
 
-// Each screen is [SCREENWIDTH*SCREENHEIGHT]; 
+// Each screen is [screenwidth*screenheight]; 
 byte*				screens[5];	
+
+int				screenwidth;
+int				screenheight;
+
+// The 320x200 row and column of each real one.
+static int*			virtualrow;
+static int*			virtualcol;
  
 fixed_t			dirtybox[4]; 
 
@@ -167,6 +177,8 @@ V_CopyRect
 { 
     byte*	src;
     byte*	dest; 
+    int		w;
+    int		h;
 	 
 #ifdef RANGECHECK 
     if (srcx<0
@@ -184,18 +196,65 @@ V_CopyRect
 #endif 
     V_MarkRect (destx, desty, width, height); 
 	 
-    src = screens[srcscrn]+SCREENWIDTH*srcy+srcx; 
-    dest = screens[destscrn]+SCREENWIDTH*desty+destx; 
+    src = screens[srcscrn]+screenwidth*SCALEY(srcy)+SCALEX(srcx); 
+    dest = screens[destscrn]+screenwidth*SCALEY(desty)+SCALEX(destx); 
+    w = SCALEX(destx+width) - SCALEX(destx);
+    h = SCALEY(desty+height) - SCALEY(desty);
 
-    for ( ; height>0 ; height--) 
+    for ( ; h>0 ; h--) 
     { 
-	memcpy (dest, src, width); 
-	src += SCREENWIDTH; 
-	dest += SCREENWIDTH; 
+	memcpy (dest, src, w); 
+	src += screenwidth; 
+	dest += screenwidth; 
     } 
 } 
  
 
+//
+// V_DrawPatchColumn
+// Draws the posts of one patch column,
+//  scaled up to the real screen.
+//
+void
+V_DrawPatchColumn
+( int		x,
+  int		y,
+  int		scrn,
+  column_t*	column ) 
+{ 
+    byte*	desttop;
+    byte*	dest;
+    byte*	source; 
+    int		top;
+    int		y1;
+    int		y2;
+    int		w;
+    int		i;
+
+    desttop = screens[scrn]+SCALEX(x);
+    w = SCALEX(x+1) - SCALEX(x);
+
+    // step through the posts in a column 
+    while (column->topdelta != 0xff ) 
+    { 
+	source = (byte *)column + 3; 
+	top = y + column->topdelta;
+	y1 = SCALEY(top);
+	y2 = SCALEY(top + column->length);
+	dest = desttop + y1*screenwidth; 
+
+	for ( ; y1<y2 ; y1++) 
+	{ 
+	    for (i=0 ; i<w ; i++)
+		dest[i] = source[virtualrow[y1]-top];
+	    dest += screenwidth; 
+	} 
+	column = (column_t *)(  (byte *)column + column->length 
+				+ 4 ); 
+    } 
+} 
+
+
 //
 // V_DrawPatch
 // Masks a column based masked pic to the screen. 
@@ -208,12 +267,8 @@ V_DrawPatch
   patch_t*	patch ) 
 { 
 
-    int		count;
     int		col; 
     column_t*	column; 
-    byte*	desttop;
-    byte*	dest;
-    byte*	source; 
     int		w; 
 	 
     y -= SHORT(patch->topoffset); 
@@ -235,30 +290,12 @@ V_DrawPatch
     if (!scrn)
 	V_MarkRect (x, y, SHORT(patch->width), SHORT(patch->height)); 
 
-    col = 0; 
-    desttop = screens[scrn]+y*SCREENWIDTH+x; 
-	 
     w = SHORT(patch->width); 
 
-    for ( ; col<w ; x++, col++, desttop++)
+    for (col=0 ; col<w ; x++, col++)
     { 
 	column = (column_t *)((byte *)patch + LONG(patch->columnofs[col])); 
- 
-	// step through the posts in a column 
-	while (column->topdelta != 0xff ) 
-	{ 
-	    source = (byte *)column + 3; 
-	    dest = desttop + column->topdelta*SCREENWIDTH; 
-	    count = column->length; 
-			 
-	    while (count--) 
-	    { 
-		*dest = *source++; 
-		dest += SCREENWIDTH; 
-	    } 
-	    column = (column_t *)(  (byte *)column + column->length 
-				    + 4 ); 
-	} 
+	V_DrawPatchColumn (x, y, scrn, column);
     }			 
 } 
  
@@ -275,12 +312,8 @@ V_DrawPatchFlipped
   patch_t*	patch ) 
 { 
 
-    int		count;
     int		col; 
     column_t*	column; 
-    byte*	desttop;
-    byte*	dest;
-    byte*	source; 
     int		w; 
 	 
     y -= SHORT(patch->topoffset); 
@@ -300,30 +333,12 @@ V_DrawPatchFlipped
     if (!scrn)
 	V_MarkRect (x, y, SHORT(patch->width), SHORT(patch->height)); 
 
-    col = 0; 
-    desttop = screens[scrn]+y*SCREENWIDTH+x; 
-	 
     w = SHORT(patch->width); 
 
-    for ( ; col<w ; x++, col++, desttop++) 
+    for (col=0 ; col<w ; x++, col++)
     { 
 	column = (column_t *)((byte *)patch + LONG(patch->columnofs[w-1-col])); 
- 
-	// step through the posts in a column 
-	while (column->topdelta != 0xff ) 
-	{ 
-	    source = (byte *)column + 3; 
-	    dest = desttop + column->topdelta*SCREENWIDTH; 
-	    count = column->length; 
-			 
-	    while (count--) 
-	    { 
-		*dest = *source++; 
-		dest += SCREENWIDTH; 
-	    } 
-	    column = (column_t *)(  (byte *)column + column->length 
-				    + 4 ); 
-	} 
+	V_DrawPatchColumn (x, y, scrn, column);
     }			 
 } 
  
@@ -397,6 +412,35 @@ V_DrawPatchDirect
  
 
 
+//
+// V_FillFlat
+// Tiles a flat over the top of the screen,
+//  e.g. around the view window.
+//
+void
+V_FillFlat
+( byte*		flat,
+  int		scrn,
+  int		height )
+{
+    byte*	src;
+    byte*	dest; 
+    int		x;
+    int		y; 
+
+    dest = screens[scrn];
+    height = SCALEY(height);
+
+    for (y=0 ; y<height ; y++) 
+    { 
+	src = flat + ((virtualrow[y]&63)<<6);
+	for (x=0 ; x<screenwidth ; x++) 
+	    *dest++ = src[virtualcol[x]&63];
+    } 
+}
+
+
+
 //
 // V_DrawBlock
 // Draw a linear block of pixels into the view buffer.
@@ -414,9 +458,9 @@ V_DrawBlock
 	 
 #ifdef RANGECHECK 
     if (x<0
-	||x+width >SCREENWIDTH
+	||x+width >screenwidth
 	|| y<0
-	|| y+height>SCREENHEIGHT 
+	|| y+height>screenheight 
 	|| (unsigned)scrn>4 )
     {
 	I_Error ("Bad V_DrawBlock");
@@ -425,13 +469,13 @@ V_DrawBlock
  
     V_MarkRect (x, y, width, height); 
  
-    dest = screens[scrn] + y*SCREENWIDTH+x; 
+    dest = screens[scrn] + y*screenwidth+x; 
 
     while (height--) 
     { 
 	memcpy (dest, src, width); 
 	src += width; 
-	dest += SCREENWIDTH; 
+	dest += screenwidth; 
     } 
 } 
  
@@ -454,21 +498,21 @@ V_GetBlock
 	 
 #ifdef RANGECHECK 
     if (x<0
-	||x+width >SCREENWIDTH
+	||x+width >screenwidth
 	|| y<0
-	|| y+height>SCREENHEIGHT 
+	|| y+height>screenheight 
 	|| (unsigned)scrn>4 )
     {
 	I_Error ("Bad V_DrawBlock");
     }
 #endif 
  
-    src = screens[scrn] + y*SCREENWIDTH+x; 
+    src = screens[scrn] + y*screenwidth+x; 
 
     while (height--) 
     { 
 	memcpy (dest, src, width); 
-	src += SCREENWIDTH; 
+	src += screenwidth; 
 	dest += width; 
     } 
 } 
@@ -482,12 +526,42 @@ V_GetBlock
 void V_Init (void) 
 { 
     int		i;
+    int		p;
     byte*	base;
+
+    screenwidth = SCREENWIDTH;
+    screenheight = SCREENHEIGHT;
+
+    p = M_CheckParm ("-width");
+    if (p && p < myargc-1)
+	screenwidth = atoi (myargv[p+1]);
+
+    p = M_CheckParm ("-height");
+    if (p && p < myargc-1)
+	screenheight = atoi (myargv[p+1]);
+
+    // The graphics are only ever scaled up,
+    //  and the clip arrays hold shorts.
+    // Low detail and the melt work on pixel pairs.
+    if (screenwidth < SCREENWIDTH || screenwidth > MAXSHORT
+	|| screenheight < SCREENHEIGHT || screenheight > MAXSHORT
+	|| (screenwidth & 1))
+    {
+	I_Error ("V_Init: bad resolution %ix%i", screenwidth, screenheight);
+    }
 		
     // stick these in low dos memory on PCs
 
-    base = I_AllocLow (SCREENWIDTH*SCREENHEIGHT*4);
+    base = I_AllocLow (screenwidth*screenheight*4);
 
     for (i=0 ; i<4 ; i++)
-	screens[i] = base + i*SCREENWIDTH*SCREENHEIGHT;
+	screens[i] = base + i*screenwidth*screenheight;
+
+    virtualrow = (int *)I_AllocLow (screenheight*sizeof(int));
+    virtualcol = (int *)I_AllocLow (screenwidth*sizeof(int));
+
+    for (i=0 ; i<screenheight ; i++)
+	virtualrow[i] = i*SCREENHEIGHT/screenheight;
+    for (i=0 ; i<screenwidth ; i++)
+	virtualcol[i] = i*SCREENWIDTH/screenwidth;
 }
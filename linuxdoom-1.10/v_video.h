@@ -39,8 +39,18 @@
 #define CENTERY			(SCREENHEIGHT/2)
 
 
+// Size of the real screen, -width and -height.
+extern	int		screenwidth;
+extern	int		screenheight;
+
+// First real pixel of a 320x200 coordinate.
+#define SCALEX(x)		(((x)*screenwidth+SCREENWIDTH-1)/SCREENWIDTH)
+#define SCALEY(y)		(((y)*screenheight+SCREENHEIGHT-1)/SCREENHEIGHT)
+
+
 // Screen 0 is the screen updated by I_Update screen.
 // Screen 1 is an extra buffer.
+// All are screenwidth wide.
 
 
 
@@ -82,6 +92,24 @@ V_DrawPatchDirect
   int		scrn,
   patch_t*	patch );
 
+// One column of a patch, its top at x,y.
+void
+V_DrawPatchColumn
+( int		x,
+  int		y,
+  int		scrn,
+  column_t*	column );
+
+// Tiles a 64x64 flat over the top height rows.
+void
+V_FillFlat
+( byte*		flat,
+  int		scrn,
+  int		height );
+
+
+// The block functions take real screen coordinates,
+//  everything else the 320x200 ones.
 
 // Draw a linear block of pixels into the view buffer.
 void
@@ -34,6 +34,7 @@ rcsid[] = "$Id: w_wad.c,v 1.5 1997/02/03 16:47:57 b1 Exp $";
 #include <stdlib.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <alloca.h>
 #define O_BINARY		0
 #endif
@@ -41,12 +42,15 @@ rcsid[] = "$Id: w_wad.c,v 1.5 1997/02/03 16:47:57 b1 Exp $";
 #include "doomtype.h"
 #include "m_swap.h"
 #include "i_system.h"
+#include "m_argv.h"
 #include "z_zone.h"
+#include "i_thread.h"
 
 #ifdef __GNUG__
 #pragma implementation "w_wad.h"
 #endif
 #include "w_wad.h"
+#include "w_zip.h"
 
 #include "i_device.h"
 
@@ -63,6 +67,17 @@ int			numlumps;
 
 void**			lumpcache;
 
+// Set by -mmap: wads are mapped once, and the lumps
+//  in them are used in place instead of cached.
+static boolean		mapwads;
+
+int			lumphits[NUMLUMPSPACES];
+int			lumpmisses[NUMLUMPSPACES];
+
+// Hash chains through lumpinfo[].next, see W_HashLumps.
+static int*		lumphash;
+static int		lumphashmask;
+
 
 #define strcmpi	strcasecmp
 
@@ -127,6 +142,8 @@ ExtractFileBase
 //  found (PWAD, if all required lumps are present).
 // Files with a .wad extension are wadlink files
 //  with multiple lumps.
+// Files with a .zip or .pk3 extension are archives,
+//  every file in them is a lump, see w_zip.c.
 // Other files are single lumps with the base filename
 //  for the lump name.
 //
@@ -138,6 +155,100 @@ int			reloadlump;
 char*			reloadname;
 
 
+//
+// W_MapFile
+// Maps the whole file read only, or returns NULL
+//  and the lumps are read through Storage as before.
+//
+static byte*
+W_MapFile
+( char*		filename,
+  int*		length )
+{
+#ifdef NORMALUNIX
+    int		handle;
+    void*	base;
+
+    handle = open (filename, O_RDONLY | O_BINARY);
+    if (handle == -1)
+	return NULL;
+
+    *length = filelength (handle);
+    base = mmap (NULL, *length, PROT_READ, MAP_PRIVATE, handle, 0);
+    close (handle);
+
+    if (base == MAP_FAILED)
+	return NULL;
+
+    Z_AddMapped (base, *length);
+    return base;
+#else
+    return NULL;
+#endif
+}
+
+
+//
+// W_AddZipFile
+// Zips are mapped whenever they can be, without -mmap.
+// Stored files are then used in place like the lumps
+//  of a mapped wad, and deflated ones are inflated
+//  straight from the map.
+//
+static void
+W_AddZipFile
+( char*		filename,
+  cap_t		handle )
+{
+    lumpinfo_t*		lump_p;
+    ziplump_t*		zipinfo;
+    ziplump_t*		zip_p;
+    int			count;
+    byte*		mapped;
+    int			length;
+    int			i;
+
+    if (reloadname)
+	I_Error ("W_AddFile: can't reload %s", filename);
+
+    mapped = W_MapFile (filename, &length);
+    if (!mapped)
+	length = filelength (handle);
+
+    count = W_ReadZipDirectory (filename, handle, mapped, length, &zipinfo);
+
+    lumpinfo = realloc (lumpinfo, (numlumps+count)*sizeof(lumpinfo_t));
+
+    if (!lumpinfo)
+	I_Error ("Couldn't realloc lumpinfo");
+
+    lump_p = &lumpinfo[numlumps];
+
+    for (i=0, zip_p=zipinfo ; i<count ; i++, lump_p++, zip_p++)
+    {
+	lump_p->handle = handle;
+	lump_p->position = zip_p->filepos;
+	lump_p->size = zip_p->size;
+	lump_p->packedsize = zip_p->packedsize;
+	memcpy (lump_p->name, zip_p->name, 8);
+
+	lump_p->loads = 0;
+	lump_p->data = NULL;
+	lump_p->packed = NULL;
+	if (mapped)
+	{
+	    if (lump_p->packedsize)
+		lump_p->packed = mapped + lump_p->position;
+	    else
+		lump_p->data = mapped + lump_p->position;
+	}
+    }
+
+    numlumps += count;
+    free (zipinfo);
+}
+
+
 void W_AddFile (char *filename)
 {
     wadinfo_t		header;
@@ -149,6 +260,8 @@ void W_AddFile (char *filename)
     filelump_t*		fileinfo;
     filelump_t		singleinfo;
     cap_t		storehandle;
+    byte*		mapped;
+    int			maplength;
     
     // open the file and add to directory
 
@@ -168,6 +281,12 @@ void W_AddFile (char *filename)
 
     printf (" adding %s\n",filename);
     startlump = numlumps;
+
+    if (W_IsZipFile (filename))
+    {
+	W_AddZipFile (filename, handle);
+	return;
+    }
 	
     if (strcmpi (filename+strlen(filename)-3 , "wad" ) )
     {
@@ -211,6 +330,11 @@ void W_AddFile (char *filename)
     lump_p = &lumpinfo[startlump];
 	
     storehandle = reloadname ? -1 : handle;
+
+    // the reload file is read again on every level
+    mapped = NULL;
+    if (mapwads && !reloadname)
+	mapped = W_MapFile (filename, &maplength);
 	
     for (i=startlump ; i<numlumps ; i++,lump_p++, fileinfo++)
     {
@@ -218,6 +342,17 @@ void W_AddFile (char *filename)
 	lump_p->position = LONG(fileinfo->filepos);
 	lump_p->size = LONG(fileinfo->size);
 	strncpy (lump_p->name, fileinfo->name, 8);
+
+	lump_p->loads = 0;
+	lump_p->data = NULL;
+	lump_p->packedsize = 0;
+	lump_p->packed = NULL;
+	if (mapped
+	    && lump_p->position >= 0 && lump_p->size >= 0
+	    && lump_p->position <= maplength - lump_p->size)
+	{
+	    lump_p->data = mapped + lump_p->position;
+	}
     }
 	
     if (reloadname)
@@ -244,6 +379,8 @@ void W_Reload (void)
 	
     if (!reloadname)
 	return;
+
+    W_StopPrefetch ();
 		
     if ( !(handle = Storage_FindObject (reloadname)) )
 	I_Error ("W_Reload: couldn't open %s",reloadname);
@@ -267,6 +404,7 @@ void W_Reload (void)
 
 	lump_p->position = LONG(fileinfo->filepos);
 	lump_p->size = LONG(fileinfo->size);
+	lump_p->loads = 0;
     }
 	
     System_DropCapability (handle);
@@ -274,6 +412,328 @@ void W_Reload (void)
 
 
 
+//
+// W_HashName
+// Case insensitive, like the compares.
+//
+static unsigned W_HashName (char* name)
+{
+    unsigned	hash;
+    int		i;
+
+    hash = 0;
+    for (i=0 ; i<8 && name[i] ; i++)
+	hash = hash*31 + toupper(name[i]);
+
+    return hash;
+}
+
+
+//
+// W_HashLumps
+// Links every lump into the chain for its name.
+// Lumps are pushed on the front of a chain in order,
+//  so the chain is walked from the last file added
+//  to the first, and patch files still take precedence.
+//
+static void W_HashLumps (void)
+{
+    int		size;
+    int		bucket;
+    int		i;
+
+    for (size = 1 ; size < numlumps ; size <<= 1)
+	;
+
+    lumphash = malloc (size*sizeof(*lumphash));
+    if (!lumphash)
+	I_Error ("Couldn't allocate lumphash");
+
+    lumphashmask = size-1;
+    for (i=0 ; i<size ; i++)
+	lumphash[i] = -1;
+
+    for (i=0 ; i<numlumps ; i++)
+    {
+	bucket = W_HashName (lumpinfo[i].name) & lumphashmask;
+	lumpinfo[i].next = lumphash[bucket];
+	lumphash[bucket] = i;
+    }
+}
+
+
+static char*	maplumpnames[] =
+{
+    "THINGS", "LINEDEFS", "SIDEDEFS", "VERTEXES", "SEGS",
+    "SSECTORS", "NODES", "SECTORS", "REJECT", "BLOCKMAP",
+    NULL
+};
+
+//
+// W_InitSpaces
+// Sets lumpinfo[].space. Flats, patches and sprites are
+//  between markers, F_START to F_END and so on, with
+//  more markers like P1_START inside. Sounds and map
+//  lumps are known by name.
+//
+static void W_InitSpaces (void)
+{
+    lumpinfo_t*	lump;
+    lumpspace_t	inside;
+    char	name[9];
+    char**	map;
+    int		len;
+    int		i;
+
+    inside = ls_other;
+    name[8] = 0;
+
+    for (i=0, lump=lumpinfo ; i<numlumps ; i++, lump++)
+    {
+	strncpy (name, lump->name, 8);
+	len = strlen (name);
+
+	lump->space = ls_other;
+
+	if (len > 6 && !strcasecmp (name+len-6, "_START"))
+	{
+	    switch (toupper (name[0]))
+	    {
+	      case 'F':	inside = ls_flats; break;
+	      case 'P':	inside = ls_patches; break;
+	      case 'S':	inside = ls_sprites; break;
+	    }
+	    continue;
+	}
+
+	if (len > 4 && !strcasecmp (name+len-4, "_END"))
+	{
+	    inside = ls_other;
+	    continue;
+	}
+
+	if (inside != ls_other)
+	{
+	    lump->space = inside;
+	    continue;
+	}
+
+	// DS for digital sounds, DP for the PC speaker
+	if (toupper (name[0]) == 'D'
+	    && (toupper (name[1]) == 'S' || toupper (name[1]) == 'P'))
+	{
+	    lump->space = ls_sounds;
+	    continue;
+	}
+
+	// ExMy and MAPxx markers, and what follows them
+	if ((len == 4 && toupper (name[0]) == 'E' && toupper (name[2]) == 'M')
+	    || (len == 5 && !strncasecmp (name, "MAP", 3)))
+	{
+	    lump->space = ls_maps;
+	    continue;
+	}
+
+	for (map = maplumpnames ; *map ; map++)
+	{
+	    if (!strcasecmp (name, *map))
+	    {
+		lump->space = ls_maps;
+		break;
+	    }
+	}
+    }
+}
+
+
+
+//
+// PREFETCH
+// Queued lumps are read on the job thread, a few at a
+//  time, into PU_STATIC blocks that lumpcache already
+//  points at. The zone is only used from the main thread,
+//  the job only fills the block in.
+// When it is done the block becomes PU_CACHE like any
+//  other lump, until then W_CacheLumpNum finishes it
+//  first, so only a lump that is needed right now is
+//  waited for.
+// The job never calls I_Error, a lump that can't be
+//  read is reported when it is finished.
+//
+#define NUMPREFETCH	16
+
+typedef struct
+{
+    job_t	job;	// first, the job is the prefetch
+    int		lump;	// -1 if not in use
+    boolean	failed;	// bad zip data, set by the job
+
+} prefetch_t;
+
+static prefetch_t	prefetches[NUMPREFETCH];
+
+// prefetches index+1 for lumps being read, 0 otherwise
+static byte*		lumpprefetch;
+
+// lumps still to be read, in order
+static int*		prefetchqueue;
+static int		prefetchhead;
+static int		prefetchtail;
+
+
+//
+// W_PrefetchJob
+// W_ReadLump, without the errors.
+//
+static void W_PrefetchJob (job_t* job)
+{
+    prefetch_t*	pf = (prefetch_t *)job;
+    lumpinfo_t*	l = &lumpinfo[pf->lump];
+
+    if (l->packedsize)
+    {
+	pf->failed = !W_InflateLump (l, lumpcache[pf->lump]);
+	return;
+    }
+
+    I_LockIO ();
+    Storage_CopyToMemory (l->handle, lumpcache[pf->lump], l->position, l->size);
+    I_UnlockIO ();
+}
+
+
+//
+// W_InitPrefetch
+//
+static void W_InitPrefetch (void)
+{
+    int		i;
+
+    lumpprefetch = malloc (numlumps);
+    prefetchqueue = malloc (numlumps * sizeof(*prefetchqueue));
+
+    if (!lumpprefetch || !prefetchqueue)
+	I_Error ("Couldn't allocate the prefetch queue");
+
+    memset (lumpprefetch,0, numlumps);
+
+    for (i=0 ; i<NUMPREFETCH ; i++)
+    {
+	prefetches[i].lump = -1;
+	prefetches[i].job.func = W_PrefetchJob;
+    }
+}
+
+
+//
+// W_FinishPrefetch
+//
+static void W_FinishPrefetch (prefetch_t* pf)
+{
+    int		lump;
+
+    I_FinishJob (&pf->job);
+
+    lump = pf->lump;
+    lumpprefetch[lump] = 0;
+    pf->lump = -1;
+
+    if (pf->failed)
+	I_Error ("W_ReadLump: bad data in %.8s", lumpinfo[lump].name);
+
+    Z_ChangeTag (lumpcache[lump], PU_CACHE);
+}
+
+
+//
+// W_PrefetchLump
+//
+void W_PrefetchLump (int lump)
+{
+    if ((unsigned)lump >= numlumps)
+	I_Error ("W_PrefetchLump: %i >= numlumps",lump);
+
+    if (prefetchtail == numlumps)
+	return;
+
+    prefetchqueue[prefetchtail++] = lump;
+}
+
+
+//
+// W_UpdatePrefetch
+// Hands back the lumps that are read,
+//  and starts on the next ones.
+//
+void W_UpdatePrefetch (void)
+{
+    prefetch_t*	pf;
+    lumpinfo_t*	l;
+    int		lump;
+    int		i;
+
+    for (i=0, pf=prefetches ; i<NUMPREFETCH ; i++, pf++)
+    {
+	if (pf->lump != -1 && I_JobDone (&pf->job))
+	    W_FinishPrefetch (pf);
+
+	while (pf->lump == -1 && prefetchhead < prefetchtail)
+	{
+	    lump = prefetchqueue[prefetchhead++];
+	    l = &lumpinfo[lump];
+
+	    // a reloadable file is opened for each read,
+	    //  through the platform layer
+	    if (l->data
+		|| l->handle == -1
+		|| lumpcache[lump]
+		|| lumpprefetch[lump])
+		continue;
+
+	    // the job can't report a short read
+	    if (!l->packed
+		&& l->position + (l->packedsize ? l->packedsize : l->size)
+		   > Storage_ObjectSize (l->handle))
+	    {
+		I_Error ("W_ReadLump: %.8s is past the end of its file",
+			 l->name);
+	    }
+
+	    if (l->loads++)
+		cachestats.reloadedbytes += l->size;
+
+	    Z_Malloc (l->size, PU_STATIC, &lumpcache[lump]);
+
+	    pf->lump = lump;
+	    pf->failed = false;
+	    lumpprefetch[lump] = i+1;
+	    I_QueueJob (&pf->job);
+	}
+    }
+
+    if (prefetchhead == prefetchtail)
+	prefetchhead = prefetchtail = 0;
+}
+
+
+//
+// W_StopPrefetch
+// Drops the queue, what is being read is finished.
+//
+void W_StopPrefetch (void)
+{
+    prefetch_t*	pf;
+    int		i;
+
+    prefetchhead = prefetchtail = 0;
+
+    for (i=0, pf=prefetches ; i<NUMPREFETCH ; i++, pf++)
+	if (pf->lump != -1)
+	    W_FinishPrefetch (pf);
+}
+
+
+
 //
 // W_InitMultipleFiles
 // Pass a null terminated list of files to use.
@@ -291,6 +751,8 @@ void W_InitMultipleFiles (char** filenames)
 {	
     int		size;
     
+    mapwads = M_CheckParm ("-mmap") != 0;
+
     // open all the files, load headers, and count lumps
     numlumps = 0;
 
@@ -311,6 +773,10 @@ void W_InitMultipleFiles (char** filenames)
 	I_Error ("Couldn't allocate lumpcache");
 
     memset (lumpcache,0, size);
+
+    W_InitPrefetch ();
+    W_HashLumps ();
+    W_InitSpaces ();
 }
 
 
@@ -356,6 +822,7 @@ int W_CheckNumForName (char* name)
     
     int		v1;
     int		v2;
+    int		i;
     lumpinfo_t*	lump_p;
 
     // make the name into two integers for easy compares
@@ -371,15 +838,17 @@ int W_CheckNumForName (char* name)
     v2 = name8.x[1];
 
 
-    // scan backwards so patch lump files take precedence
-    lump_p = lumpinfo + numlumps;
-
-    while (lump_p-- != lumpinfo)
+    // the chain runs backwards so patch lump files take precedence
+    for (i = lumphash[W_HashName (name8.s) & lumphashmask] ;
+	 i != -1 ;
+	 i = lump_p->next)
     {
+	lump_p = lumpinfo + i;
+
 	if ( *(int *)lump_p->name == v1
 	     && *(int *)&lump_p->name[4] == v2)
 	{
-	    return lump_p - lumpinfo;
+	    return i;
 	}
     }
 
@@ -438,6 +907,19 @@ W_ReadLump
 	I_Error ("W_ReadLump: %i >= numlumps",lump);
 
     l = lumpinfo+lump;
+
+    if (l->data)
+    {
+	memcpy (dest, l->data, l->size);
+	return;
+    }
+
+    if (l->packedsize)
+    {
+	if (!W_InflateLump (l, dest))
+	    I_Error ("W_ReadLump: bad data in %.8s", l->name);
+	return;
+    }
 	
     // ??? I_BeginRead ();
 	
@@ -450,7 +932,9 @@ W_ReadLump
     else
 	handle = l->handle;
 		
+    I_LockIO ();
     Storage_CopyToMemory (handle, dest, l->position, l->size);
+    I_UnlockIO ();
 
     if (l->handle == -1)
 	System_DropCapability (handle);
@@ -471,18 +955,37 @@ W_CacheLumpNum
 {
     if ((unsigned)lump >= numlumps)
 	I_Error ("W_CacheLumpNum: %i >= numlumps",lump);
+
+    if (lumpprefetch[lump])
+	W_FinishPrefetch (&prefetches[lumpprefetch[lump]-1]);
+
+    // Mapped lumps are used in place and never purged.
+    // Z_Free and Z_ChangeTag ignore them.
+    if (lumpinfo[lump].data)
+    {
+	cachestats.hits++;
+	lumphits[lumpinfo[lump].space]++;
+	return lumpinfo[lump].data;
+    }
 		
     if (!lumpcache[lump])
     {
 	// read the lump in
 	
 	//printf ("cache miss on lump %i\n",lump);
+	cachestats.misses++;
+	lumpmisses[lumpinfo[lump].space]++;
+	if (lumpinfo[lump].loads++)
+	    cachestats.reloadedbytes += lumpinfo[lump].size;
+
 	Z_Malloc (W_LumpLength (lump), tag, &lumpcache[lump]);
 	W_ReadLump (lump, lumpcache[lump]);
     }
     else
     {
 	//printf ("cache hit on lump %i\n",lump);
+	cachestats.hits++;
+	lumphits[lumpinfo[lump].space]++;
 	Z_ChangeTag (lumpcache[lump],tag);
     }
 	
@@ -504,64 +1007,28 @@ W_CacheLumpName
 
 
 //
-// W_Profile
+// W_GetNumForHandle
+// Looks the name up on the first call only,
+//  lump numbers don't change after startup.
 //
-int		info[2500][10];
-int		profilecount;
-
-void W_Profile (void)
+int W_GetNumForHandle (lumphandle_t* handle)
 {
-    int		i;
-    memblock_t*	block;
-    void*	ptr;
-    char	ch;
-    FILE*	f;
-    int		j;
-    char	name[9];
-	
-	
-    for (i=0 ; i<numlumps ; i++)
-    {	
-	ptr = lumpcache[i];
-	if (!ptr)
-	{
-	    ch = ' ';
-	    continue;
-	}
-	else
-	{
-	    block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
-	    if (block->tag < PU_PURGELEVEL)
-		ch = 'S';
-	    else
-		ch = 'P';
-	}
-	info[i][profilecount] = ch;
-    }
-    profilecount++;
-	
-    f = fopen ("waddump.txt","w");
-    name[8] = 0;
-
-    for (i=0 ; i<numlumps ; i++)
-    {
-	memcpy (name,lumpinfo[i].name,8);
-
-	for (j=0 ; j<8 ; j++)
-	    if (!name[j])
-		break;
-
-	for ( ; j<8 ; j++)
-	    name[j] = ' ';
+    if (handle->lump == -1)
+	handle->lump = W_GetNumForName (handle->name);
 
-	fprintf (f,"%s ",name);
+    return handle->lump;
+}
 
-	for (j=0 ; j<profilecount ; j++)
-	    fprintf (f,"    %c",info[i][j]);
 
-	fprintf (f,"\n");
-    }
-    fclose (f);
+//
+// W_CacheLumpHandle
+//
+void*
+W_CacheLumpHandle
+( lumphandle_t*	handle,
+  int		tag )
+{
+    return W_CacheLumpNum (W_GetNumForHandle (handle), tag);
 }
 
 
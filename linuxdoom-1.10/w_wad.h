@@ -53,6 +53,23 @@ typedef struct
     
 } filelump_t;
 
+//
+// What a lump is, from its name and the markers
+//  around it, to count cache hits by kind.
+//
+typedef enum
+{
+    ls_other,
+    ls_flats,
+    ls_patches,
+    ls_sprites,
+    ls_sounds,
+    ls_maps,
+    NUMLUMPSPACES
+
+} lumpspace_t;
+
+
 //
 // WADFILE I/O related stuff.
 //
@@ -62,13 +79,49 @@ typedef struct
     int		handle;
     int		position;
     int		size;
+
+    // next lump in the same hash chain, or -1
+    int		next;
+
+    // the lump in a mapped wad, or NULL, see -mmap
+    void*	data;
+
+    // deflated size in a zip, 0 if stored as is,
+    //  and the deflated data if the zip is mapped
+    int		packedsize;
+    void*	packed;
+
+    // times read into lumpcache, more than once
+    //  if it was purged
+    int		loads;
+
+    lumpspace_t	space;
 } lumpinfo_t;
 
 
+//
+// A lump name looked up only once,
+//  for names that are drawn every frame.
+// static lumphandle_t pause = LUMPHANDLE("M_PAUSE");
+//
+typedef struct
+{
+    char*	name;
+    int		lump;	// -1 until the first use
+
+} lumphandle_t;
+
+#define LUMPHANDLE(name)	{ (name), -1 }
+
+
 extern	void**		lumpcache;
 extern	lumpinfo_t*	lumpinfo;
 extern	int		numlumps;
 
+// W_CacheLumpNum calls, by lumpspace_t.
+extern	int		lumphits[NUMLUMPSPACES];
+extern	int		lumpmisses[NUMLUMPSPACES];
+
 void    W_InitMultipleFiles (char** filenames);
 void    W_Reload (void);
 
@@ -81,6 +134,17 @@ void    W_ReadLump (int lump, void *dest);
 void*	W_CacheLumpNum (int lump, int tag);
 void*	W_CacheLumpName (char* name, int tag);
 
+int	W_GetNumForHandle (lumphandle_t* handle);
+void*	W_CacheLumpHandle (lumphandle_t* handle, int tag);
+
+// Reading ahead, see R_PrecacheLevel.
+// Queued lumps are read in order on the job thread,
+//  W_UpdatePrefetch is called every frame to keep it
+//  going, W_StopPrefetch drops the rest of the queue.
+void	W_PrefetchLump (int lump);
+void	W_UpdatePrefetch (void);
+void	W_StopPrefetch (void);
+
 
 
 
@@ -0,0 +1,404 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Zip (PK3) archives as lump sources.
+//	The central directory is read once into lumpinfo, every
+//	 file is a lump named after its base name. Stored files
+//	 are read like wad lumps, deflated ones are inflated
+//	 with zlib when they are first cached. The deflated
+//	 data never goes in the zone, it comes from the mapped
+//	 file, or is read in small pieces as it is inflated.
+//
+//-----------------------------------------------------------------------------
+
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+
+#include <zlib.h>
+
+#include "doomtype.h"
+#include "i_system.h"
+#include "i_thread.h"
+
+#ifdef __GNUG__
+#pragma implementation "w_zip.h"
+#endif
+#include "w_zip.h"
+
+
+#define ZIP_LOCAL	0x04034b50
+#define ZIP_CENTRAL	0x02014b50
+#define ZIP_END		0x06054b50
+
+#define LOCALSIZE	30
+#define CENTRALSIZE	46
+#define ENDSIZE		22
+
+// the end record is followed by a comment of up to 64k
+#define MAXCOMMENT	0xffff
+
+// deflated data read at a time, without a map
+#define ZIPCHUNK	16384
+
+#define ZIP_STORED	0
+#define ZIP_DEFLATED	8
+
+
+//
+// Folders that are lump namespaces, each
+//  becomes a range between two markers.
+//
+typedef struct
+{
+    char*	folder;
+    char	start[8];	// zero padded, like lump names
+    char	end[8];
+
+} zipspace_t;
+
+static zipspace_t	zipspaces[] =
+{
+    { "flats/",		"F_START",	"F_END" },
+    { "sprites/",	"S_START",	"S_END" },
+    { "patches/",	"P_START",	"P_END" }
+};
+
+#define NUMZIPSPACES	(sizeof(zipspaces)/sizeof(zipspaces[0]))
+
+
+
+static int W_ZipShort (byte* p)
+{
+    return p[0] | (p[1]<<8);
+}
+
+static unsigned W_ZipLong (byte* p)
+{
+    return p[0] | (p[1]<<8) | (p[2]<<16) | ((unsigned)p[3]<<24);
+}
+
+
+//
+// W_ZipRead
+//
+static void
+W_ZipRead
+( cap_t		handle,
+  byte*		mapped,
+  void*		dest,
+  int		position,
+  int		length )
+{
+    if (mapped)
+	memcpy (dest, mapped+position, length);
+    else
+	Storage_CopyToMemory (handle, dest, position, length);
+}
+
+
+//
+// W_IsZipFile
+//
+boolean W_IsZipFile (char* filename)
+{
+    int		length;
+
+    length = strlen (filename);
+    if (length < 4)
+	return false;
+
+    return !strcasecmp (filename+length-4, ".zip")
+	|| !strcasecmp (filename+length-4, ".pk3");
+}
+
+
+//
+// W_ZipLumpName
+// The base name up to the first dot, false if
+//  it is not a lump name.
+//
+static boolean
+W_ZipLumpName
+( char*		path,
+  int		length,
+  char*		dest )
+{
+    char*	base;
+    char*	end;
+    int		i;
+
+    end = path+length;
+    for (base = end ; base > path && base[-1] != '/' ; base--)
+	;
+
+    memset (dest, 0, 8);
+    for (i=0 ; base+i < end && base[i] != '.' ; i++)
+    {
+	if (i == 8)
+	    return false;
+	dest[i] = toupper (base[i]);
+    }
+
+    return i > 0;
+}
+
+
+//
+// W_ZipMarker
+//
+static void W_ZipMarker (ziplump_t* lump, char* name)
+{
+    memset (lump, 0, sizeof(*lump));
+    memcpy (lump->name, name, 8);
+}
+
+
+//
+// W_ReadZipDirectory
+//
+int
+W_ReadZipDirectory
+( char*		filename,
+  cap_t		handle,
+  byte*		mapped,
+  int		length,
+  ziplump_t**	lumps )
+{
+    byte*	buffer;
+    byte*	entry;
+    byte	local[LOCALSIZE];
+    int		tail;
+    int		numentries;
+    int		dirsize;
+    int		dirpos;
+    int		method;
+    unsigned	packedsize;
+    unsigned	size;
+    unsigned	localpos;
+    int		namelength;
+    int		datapos;
+    ziplump_t*	files;
+    ziplump_t*	out;
+    byte*	spaces;
+    int		numfiles;
+    int		count;
+    int		space;
+    int		i;
+    int		j;
+
+    // find the end record, from the back
+    if (length < ENDSIZE)
+	I_Error ("W_ReadZipDirectory: %s is not a zip", filename);
+
+    tail = length < ENDSIZE+MAXCOMMENT ? length : ENDSIZE+MAXCOMMENT;
+    buffer = malloc (tail);
+    if (!buffer)
+	I_Error ("W_ReadZipDirectory: out of memory");
+    W_ZipRead (handle, mapped, buffer, length-tail, tail);
+
+    for (i = tail-ENDSIZE ; i >= 0 ; i--)
+	if (W_ZipLong (buffer+i) == ZIP_END)
+	    break;
+
+    if (i < 0)
+	I_Error ("W_ReadZipDirectory: %s is not a zip", filename);
+
+    numentries = W_ZipShort (buffer+i+10);
+    dirsize = W_ZipLong (buffer+i+12);
+    dirpos = W_ZipLong (buffer+i+16);
+    free (buffer);
+
+    if (dirsize < 0 || dirpos < 0 || dirpos > length - dirsize)
+	I_Error ("W_ReadZipDirectory: bad directory in %s", filename);
+
+    buffer = malloc (dirsize+1);
+    files = malloc ((numentries+1) * sizeof(*files));
+    spaces = malloc (numentries+1);
+    out = malloc ((numentries + 2*NUMZIPSPACES) * sizeof(*out));
+    if (!buffer || !files || !spaces || !out)
+	I_Error ("W_ReadZipDirectory: out of memory");
+    W_ZipRead (handle, mapped, buffer, dirpos, dirsize);
+
+    // the files that can be lumps
+    numfiles = 0;
+    entry = buffer;
+    for (i=0 ; i<numentries ; i++)
+    {
+	if (entry+CENTRALSIZE > buffer+dirsize
+	    || W_ZipLong (entry) != ZIP_CENTRAL)
+	{
+	    I_Error ("W_ReadZipDirectory: bad directory in %s", filename);
+	}
+
+	method = W_ZipShort (entry+10);
+	packedsize = W_ZipLong (entry+20);
+	size = W_ZipLong (entry+24);
+	namelength = W_ZipShort (entry+28);
+	localpos = W_ZipLong (entry+42);
+
+	if (entry+CENTRALSIZE+namelength > buffer+dirsize)
+	    I_Error ("W_ReadZipDirectory: bad directory in %s", filename);
+
+	// folders
+	if (!namelength || entry[CENTRALSIZE+namelength-1] == '/')
+	    goto next;
+
+	// encrypted, or neither stored nor deflated,
+	//  or too big for a lump
+	if ((W_ZipShort (entry+8) & 1)
+	    || (method != ZIP_STORED && method != ZIP_DEFLATED)
+	    || size >= 0x7fffffff
+	    || packedsize >= 0x7fffffff
+	    || !W_ZipLumpName ((char *)entry+CENTRALSIZE, namelength,
+			       files[numfiles].name))
+	{
+	    printf (" skipping %.*s in %s\n",
+		    namelength, entry+CENTRALSIZE, filename);
+	    goto next;
+	}
+
+	if (method == ZIP_STORED && packedsize != size)
+	    I_Error ("W_ReadZipDirectory: bad directory in %s", filename);
+
+	// the data follows the local header,
+	//  which has its own name and extra field
+	if ((int)localpos < 0 || (int)localpos > length - LOCALSIZE)
+	    I_Error ("W_ReadZipDirectory: bad directory in %s", filename);
+	W_ZipRead (handle, mapped, local, localpos, LOCALSIZE);
+	if (W_ZipLong (local) != ZIP_LOCAL)
+	    I_Error ("W_ReadZipDirectory: bad directory in %s", filename);
+
+	datapos = localpos + LOCALSIZE
+	    + W_ZipShort (local+26) + W_ZipShort (local+28);
+	if (datapos > length - (int)packedsize)
+	    I_Error ("W_ReadZipDirectory: %.*s is cut off in %s",
+		     namelength, entry+CENTRALSIZE, filename);
+
+	files[numfiles].filepos = datapos;
+	files[numfiles].size = size;
+	files[numfiles].packedsize = method == ZIP_DEFLATED ? packedsize : 0;
+
+	spaces[numfiles] = NUMZIPSPACES;
+	for (j=0 ; j<NUMZIPSPACES ; j++)
+	{
+	    if (!strncasecmp ((char *)entry+CENTRALSIZE, zipspaces[j].folder,
+			      strlen (zipspaces[j].folder)))
+	    {
+		spaces[numfiles] = j;
+		break;
+	    }
+	}
+	numfiles++;
+
+      next:
+	entry += CENTRALSIZE + namelength
+	    + W_ZipShort (entry+30) + W_ZipShort (entry+32);
+    }
+
+    // the rest in order, then each namespace
+    count = 0;
+    for (i=0 ; i<numfiles ; i++)
+	if (spaces[i] == NUMZIPSPACES)
+	    out[count++] = files[i];
+
+    for (space=0 ; space<NUMZIPSPACES ; space++)
+    {
+	for (i=0 ; i<numfiles ; i++)
+	    if (spaces[i] == space)
+		break;
+	if (i == numfiles)
+	    continue;
+
+	W_ZipMarker (&out[count++], zipspaces[space].start);
+	for ( ; i<numfiles ; i++)
+	    if (spaces[i] == space)
+		out[count++] = files[i];
+	W_ZipMarker (&out[count++], zipspaces[space].end);
+    }
+
+    free (buffer);
+    free (files);
+    free (spaces);
+
+    *lumps = out;
+    return count;
+}
+
+
+
+//
+// W_InflateLump
+//
+boolean W_InflateLump (lumpinfo_t* lump, void* dest)
+{
+    z_stream	stream;
+    byte	chunk[ZIPCHUNK];
+    int		position;
+    int		left;
+    int		length;
+    int		err;
+
+    memset (&stream, 0, sizeof(stream));
+
+    // raw deflate, zip has its own headers
+    if (inflateInit2 (&stream, -MAX_WBITS) != Z_OK)
+	return false;
+
+    stream.next_out = dest;
+    stream.avail_out = lump->size;
+
+    if (lump->packed)
+    {
+	stream.next_in = lump->packed;
+	stream.avail_in = lump->packedsize;
+	err = inflate (&stream, Z_FINISH);
+    }
+    else
+    {
+	position = lump->position;
+	left = lump->packedsize;
+	err = Z_OK;
+
+	while (err == Z_OK && left)
+	{
+	    length = left < ZIPCHUNK ? left : ZIPCHUNK;
+
+	    I_LockIO ();
+	    Storage_CopyToMemory (lump->handle, chunk, position, length);
+	    I_UnlockIO ();
+
+	    position += length;
+	    left -= length;
+
+	    stream.next_in = chunk;
+	    stream.avail_in = length;
+	    err = inflate (&stream, left ? Z_NO_FLUSH : Z_FINISH);
+	}
+    }
+
+    inflateEnd (&stream);
+
+    return err == Z_STREAM_END && stream.total_out == lump->size;
+}
@@ -0,0 +1,77 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// DESCRIPTION:
+//	Zip (PK3) archives as lump sources.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __W_ZIP__
+#define __W_ZIP__
+
+
+#ifdef __GNUG__
+#pragma interface
+#endif
+
+
+#include "doomtype.h"
+#include "w_wad.h"
+
+
+//
+// A file in the archive, as a lump.
+//
+typedef struct
+{
+    int		filepos;	// of the data, past the local header
+    int		size;
+    int		packedsize;	// deflated size, 0 if stored
+    char	name[8];
+
+} ziplump_t;
+
+
+// True for a .zip or .pk3 name.
+boolean W_IsZipFile (char* filename);
+
+// Reads the central directory into a malloced list, in
+//  lump order, and returns the number of lumps.
+// mapped is the whole file, or NULL to read through
+//  the handle.
+// Files in flats/, sprites/ and patches/ are put between
+//  F_START and F_END, S_START and S_END, P_START and P_END,
+//  the rest keep their order in the archive.
+int
+W_ReadZipDirectory
+( char*		filename,
+  cap_t		handle,
+  byte*		mapped,
+  int		length,
+  ziplump_t**	lumps );
+
+// Inflates a deflated lump into dest, from its mapped
+//  data or a piece at a time from the file.
+// False if the data is bad, the caller reports it.
+// Safe on the job thread.
+boolean W_InflateLump (lumpinfo_t* lump, void* dest);
+
+
+#endif
+//-----------------------------------------------------------------------------
+//
+// $Log:$
+//
+//-----------------------------------------------------------------------------
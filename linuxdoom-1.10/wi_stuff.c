@@ -405,7 +405,7 @@ static patch_t**	lnames;
 
 void WI_slamBackground(void)
 {
-    memcpy(screens[0], screens[1], SCREENWIDTH * SCREENHEIGHT);
+    memcpy(screens[0], screens[1], screenwidth * screenheight);
     V_MarkRect (0, 0, SCREENWIDTH, SCREENHEIGHT);
 }
 
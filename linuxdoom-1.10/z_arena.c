@@ -0,0 +1,311 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Level memory, for both zone allocators.
+//	PU_LEVEL and PU_LEVSPEC blocks are cut one after the
+//	 other from big chunks of the zone, and all of it goes
+//	 back in one step when the level is freed, instead of
+//	 thousands of small blocks mixed in with the cache.
+//	Z_Free still works on single blocks, small ones are
+//	 kept on a free list by size for the next thinker.
+//
+//-----------------------------------------------------------------------------
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+#include <string.h>
+
+#include "doomtype.h"
+#include "z_zone.h"
+#include "i_system.h"
+#include "doomdef.h"
+
+
+//
+// Arena blocks have the same header as zone blocks,
+//  with next set to NULL, which no zone block has.
+// prev links a freed block on its free list.
+//
+
+#define ZONEID		0x1d4a11
+
+// Chunks are at least this big, and blocks over a
+//  quarter of it get a chunk of their own.
+#define CHUNKSIZE	(256*1024)
+
+// Free lists by size, in 8 byte steps.
+#define NUMFREELISTS	64
+
+
+typedef struct arenachunk_s
+{
+    struct arenachunk_s*	next;
+    int				size;	// bytes after this header
+    int				used;
+
+} arenachunk_t;
+
+
+// the first chunk is the one being cut from
+static arenachunk_t*	chunks;
+
+static memblock_t*	freelists[NUMFREELISTS];
+
+
+
+//
+// Z_NewChunk
+// Big blocks get a chunk of their own, put after
+//  the first so cutting goes on in that one.
+//
+static arenachunk_t* Z_NewChunk (int size)
+{
+    arenachunk_t*	chunk;
+    boolean		own;
+
+    own = size > CHUNKSIZE/4;
+    if (!own)
+	size = CHUNKSIZE;
+
+    chunk = Z_Malloc (sizeof(arenachunk_t) + size, PU_STATIC, NULL);
+    chunk->size = size;
+    chunk->used = 0;
+
+    if (own && chunks)
+    {
+	chunk->next = chunks->next;
+	chunks->next = chunk;
+    }
+    else
+    {
+	chunk->next = chunks;
+	chunks = chunk;
+    }
+
+    return chunk;
+}
+
+
+//
+// Z_ArenaMalloc
+//
+void*
+Z_ArenaMalloc
+( int		size,
+  int		tag,
+  void*		user )
+{
+    arenachunk_t*	chunk;
+    memblock_t*		block;
+    int			list;
+
+    size = (size + 7) & ~7;
+    size += sizeof(memblock_t);
+
+    zoneallocs++;
+    zoneallocbytes += size;
+
+    list = size >> 3;
+    if (list < NUMFREELISTS && freelists[list])
+    {
+	block = freelists[list];
+	freelists[list] = block->prev;
+    }
+    else
+    {
+	chunk = chunks;
+	if (!chunk || chunk->used + size > chunk->size)
+	    chunk = Z_NewChunk (size);
+
+	block = (memblock_t *)((byte *)(chunk+1) + chunk->used);
+	chunk->used += size;
+	block->size = size;
+    }
+
+    block->next = block->prev = NULL;
+    block->tag = tag;
+    block->id = ZONEID;
+
+    if (user)
+    {
+	block->user = user;
+	*(void **)user = (void *) ((byte *)block + sizeof(memblock_t));
+    }
+    else
+    {
+	// mark as in use, but unowned
+	block->user = (void *)2;
+    }
+
+    return (void *) ((byte *)block + sizeof(memblock_t));
+}
+
+
+//
+// Z_ArenaFree
+// From Z_Free, for a block with no next.
+//
+void Z_ArenaFree (memblock_t* block)
+{
+    int		list;
+
+    if (zonefreehook)
+	zonefreehook ();
+
+    if (block->user > (void **)0x100)
+	*block->user = 0;
+
+    block->user = NULL;
+    block->tag = 0;
+    block->id = 0;
+
+    // bigger ones wait for the level to end
+    list = block->size >> 3;
+    if (list < NUMFREELISTS)
+    {
+	block->prev = freelists[list];
+	freelists[list] = block;
+    }
+}
+
+
+//
+// Z_ArenaChangeTag
+// Level memory goes when the level does, it can
+//  change between the level tags, or be made
+//  purgable, which it is at the end of the level.
+// To outlive the level it is copied into the zone,
+//  the owner is pointed at the copy, as when a lump
+//  cached for the level is asked for as PU_STATIC.
+//
+void Z_ArenaChangeTag (memblock_t* block, int tag)
+{
+    void**	user;
+
+    if (Z_ISLEVELTAG (tag))
+    {
+	block->tag = tag;
+	return;
+    }
+
+    if (tag >= PU_PURGELEVEL)
+	return;
+
+    user = block->user;
+    if (user < (void **)0x100)
+	I_Error ("Z_ChangeTag: an owner is needed to make level memory static");
+
+    block->user = (void *)2;
+    Z_Malloc (block->size - sizeof(memblock_t), tag, user);
+    memcpy (*user, (byte *)block + sizeof(memblock_t),
+	    block->size - sizeof(memblock_t));
+    Z_ArenaFree (block);
+}
+
+
+//
+// Z_ArenaFreeTags
+// All at once when both level tags go, or nothing
+//  is left in use, block by block otherwise.
+//
+void
+Z_ArenaFreeTags
+( int		lowtag,
+  int		hightag )
+{
+    arenachunk_t*	chunk;
+    arenachunk_t*	next;
+    memblock_t*		block;
+    byte*		p;
+    boolean		all;
+    boolean		live;
+    int			i;
+
+    if (hightag < PU_LEVEL || lowtag > PU_LEVSPEC)
+	return;
+
+    all = lowtag <= PU_LEVEL && hightag >= PU_LEVSPEC;
+    live = false;
+
+    for (chunk = chunks ; chunk ; chunk = chunk->next)
+    {
+	p = (byte *)(chunk+1);
+	for ( ; p < (byte *)(chunk+1) + chunk->used ; p += block->size)
+	{
+	    block = (memblock_t *)p;
+
+	    if (!block->user)
+		continue;
+
+	    if (block->tag < lowtag || block->tag > hightag)
+	    {
+		live = true;
+		continue;
+	    }
+
+	    if (all)
+	    {
+		// only the owners need to know
+		if (block->user > (void **)0x100)
+		    *block->user = 0;
+	    }
+	    else
+		Z_ArenaFree (block);
+	}
+    }
+
+    if (live)
+	return;
+
+    for (chunk = chunks ; chunk ; chunk = next)
+    {
+	next = chunk->next;
+	Z_Free (chunk);
+    }
+    chunks = NULL;
+
+    for (i=0 ; i<NUMFREELISTS ; i++)
+	freelists[i] = NULL;
+}
+
+
+//
+// Z_ArenaStats
+// The chunks are PU_STATIC zone blocks,
+//  count what is in them by its own tag.
+//
+void Z_ArenaStats (zonestats_t* stats)
+{
+    arenachunk_t*	chunk;
+    memblock_t*		block;
+    byte*		p;
+
+    for (chunk = chunks ; chunk ; chunk = chunk->next)
+    {
+	block = (memblock_t *)((byte *)chunk - sizeof(memblock_t));
+	stats->tagbytes[PU_STATIC] -= block->size;
+
+	p = (byte *)(chunk+1);
+	for ( ; p < (byte *)(chunk+1) + chunk->used ; p += block->size)
+	{
+	    block = (memblock_t *)p;
+	    if (block->user)
+		stats->tagbytes[block->tag] += block->size;
+	}
+    }
+}
@@ -0,0 +1,894 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Zone Memory Allocation with size class bins.
+//	Same interface and purge tags as z_zone.c, build with
+//	 "make ZONE=bins" to use it instead.
+//	Free blocks are kept on one list per power of two size,
+//	 so Z_Malloc does not walk the whole heap to find room.
+//	The heap is only walked when nothing free is big enough,
+//	 to throw out a run of purgable blocks.
+//
+//-----------------------------------------------------------------------------
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+#include <string.h>
+
+#include "z_zone.h"
+#include "i_system.h"
+#include "doomdef.h"
+
+
+//
+// ZONE MEMORY ALLOCATION
+//
+// As in z_zone.c, all blocks are on one list in address
+//  order, there is never any space between memblocks,
+//  and there will never be two contiguous free memblocks.
+// Free blocks are also on the list of their bin, the
+//  links are kept in the otherwise unused block data.
+// The rover is only where the next purge starts looking.
+// Regions end in fences, as in z_zone.c.
+//
+
+#define ZONEID		0x1d4a11
+#define FENCEID		0x1d4a12
+
+#define MAXREGIONS	64
+
+// 2^NUMBINS is more than any int size
+#define NUMBINS		32
+
+// Blocks are a multiple of this, so the free links are aligned.
+#define ZONEALIGN	8
+
+
+typedef struct freeblock_s
+{
+    memblock_t		block;
+    struct freeblock_s*	nextfree;
+    struct freeblock_s*	prevfree;
+
+} freeblock_t;
+
+
+typedef struct
+{
+    byte*	base;
+    int		size;
+
+} memregion_t;
+
+
+typedef struct
+{
+    // total bytes malloced, including header
+    int		size;
+
+    // start / end cap for linked list
+    memblock_t	blocklist;
+
+    memblock_t*	rover;
+
+    // free blocks of at least 1<<bin bytes,
+    //  and a bit set for each bin that has any
+    freeblock_t*	bins[NUMBINS];
+    unsigned		binmask;
+
+    // the first one holds the memzone_t
+    memregion_t	regions[MAXREGIONS];
+    int		numregions;
+
+} memzone_t;
+
+
+
+memzone_t*	mainzone;
+
+// heap blocks changed to a level tag, usually none
+static int	numlevelblocks;
+
+
+
+//
+// Z_BinForSize
+// The largest power of two not over size.
+//
+static int Z_BinForSize (int size)
+{
+    int		bin;
+
+    bin = 0;
+    while (size >>= 1)
+	bin++;
+
+    return bin;
+}
+
+
+//
+// Z_LinkFree
+// Puts a free block on the list of its bin.
+//
+static void Z_LinkFree (memblock_t* block)
+{
+    freeblock_t*	fb;
+    int			bin;
+
+    fb = (freeblock_t *)block;
+    bin = Z_BinForSize (block->size);
+
+    fb->prevfree = NULL;
+    fb->nextfree = mainzone->bins[bin];
+    if (fb->nextfree)
+	fb->nextfree->prevfree = fb;
+
+    mainzone->bins[bin] = fb;
+    mainzone->binmask |= 1u<<bin;
+}
+
+
+//
+// Z_UnlinkFree
+// Takes a free block off its bin, before it
+//  is used, merged or changes size.
+//
+static void Z_UnlinkFree (memblock_t* block)
+{
+    freeblock_t*	fb;
+    int			bin;
+
+    fb = (freeblock_t *)block;
+    bin = Z_BinForSize (block->size);
+
+    if (fb->prevfree)
+	fb->prevfree->nextfree = fb->nextfree;
+    else
+	mainzone->bins[bin] = fb->nextfree;
+
+    if (fb->nextfree)
+	fb->nextfree->prevfree = fb->prevfree;
+
+    if (!mainzone->bins[bin])
+	mainzone->binmask &= ~(1u<<bin);
+}
+
+
+
+//
+// Z_InitRegion
+// Makes the space from start to end one free block,
+//  and puts it at the end of the list with a fence.
+//
+static memblock_t*
+Z_InitRegion
+( byte*		start,
+  byte*		end )
+{
+    memblock_t*	block;
+    memblock_t*	fence;
+
+    block = (memblock_t *)start;
+    fence = (memblock_t *)(start + ((end - start - sizeof(memblock_t))
+				    & ~(ZONEALIGN-1)));
+
+    block->prev = mainzone->blocklist.prev;
+    block->next = fence;
+    fence->prev = block;
+    fence->next = &mainzone->blocklist;
+    block->prev->next = block;
+    mainzone->blocklist.prev = fence;
+
+    // NULL indicates a free block.
+    block->user = NULL;
+    block->tag = 0;
+    block->id = 0;
+    block->size = (byte *)fence - start;
+    Z_LinkFree (block);
+
+    fence->user = (void *)mainzone;
+    fence->tag = PU_STATIC;
+    fence->id = FENCEID;
+    fence->size = sizeof(memblock_t);
+
+    return block;
+}
+
+
+//
+// Z_AddRegion
+// Gets more memory when nothing in the zone
+//  can be freed to make room for size bytes.
+//
+static memblock_t* Z_AddRegion (int size)
+{
+    memregion_t*	region;
+    byte*		base;
+
+    if (mainzone->numregions == MAXREGIONS)
+	return NULL;
+
+    // the fence, and rounding
+    size += sizeof(memblock_t) + ZONEALIGN;
+
+    base = I_ZoneGrow (&size);
+    if (!base)
+	return NULL;
+
+    region = &mainzone->regions[mainzone->numregions++];
+    region->base = base;
+    region->size = size;
+    mainzone->size += size;
+
+    return Z_InitRegion (base, base+size);
+}
+
+
+
+//
+// Z_Init
+//
+void Z_Init (void)
+{
+    int		size;
+    int		i;
+
+    Z_InitCache ();
+
+    mainzone = (memzone_t *)I_ZoneBase (&size);
+    mainzone->size = size;
+
+    mainzone->regions[0].base = (byte *)mainzone;
+    mainzone->regions[0].size = size;
+    mainzone->numregions = 1;
+
+    for (i=0 ; i<NUMBINS ; i++)
+	mainzone->bins[i] = NULL;
+    mainzone->binmask = 0;
+
+    // an empty list
+    mainzone->blocklist.next =
+	mainzone->blocklist.prev = &mainzone->blocklist;
+
+    mainzone->blocklist.user = (void *)mainzone;
+    mainzone->blocklist.tag = PU_STATIC;
+
+    // set the entire zone to one free block
+    mainzone->rover = Z_InitRegion ((byte *)mainzone + sizeof(memzone_t),
+				    (byte *)mainzone + size);
+}
+
+
+//
+// Z_InZone
+//
+int Z_InZone (void* ptr)
+{
+    memregion_t*	region;
+    int			i;
+
+    for (i=0, region=mainzone->regions ; i<mainzone->numregions ; i++, region++)
+    {
+	if ((byte *)ptr > region->base
+	    && (byte *)ptr < region->base + region->size)
+	    return true;
+    }
+
+    return false;
+}
+
+
+//
+// Z_Free
+//
+void	(*zonefreehook) (void);
+
+void Z_Free (void* ptr)
+{
+    memblock_t*		block;
+    memblock_t*		other;
+
+    // used in place, e.g. a mapped lump
+    if (Z_IsMapped (ptr))
+	return;
+
+    if (!Z_InZone (ptr))
+	I_Error ("Z_Free: freed a pointer outside the zone");
+
+    block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
+
+    if (block->id != ZONEID)
+	I_Error ("Z_Free: freed a pointer without ZONEID");
+
+    if (!block->next)
+    {
+	Z_ArenaFree (block);
+	return;
+    }
+
+    if (Z_ISLEVELTAG (block->tag))
+	numlevelblocks--;
+
+    if (zonefreehook)
+	zonefreehook ();
+
+    if (block->user > (void **)0x100)
+    {
+	// smaller values are not pointers
+	// Note: OS-dependend?
+
+	// clear the user's mark
+	*block->user = 0;
+    }
+
+    Z_CacheRetag (block, 0);
+
+    // mark as free
+    block->user = NULL;
+    block->tag = 0;
+    block->id = 0;
+
+    other = block->prev;
+
+    if (!other->user)
+    {
+	// merge with previous free block
+	Z_UnlinkFree (other);
+	other->size += block->size;
+	other->next = block->next;
+	other->next->prev = other;
+
+	if (block == mainzone->rover)
+	    mainzone->rover = other;
+
+	block = other;
+    }
+
+    other = block->next;
+    if (!other->user)
+    {
+	// merge the next free block onto the end
+	Z_UnlinkFree (other);
+	block->size += other->size;
+	block->next = other->next;
+	block->next->prev = block;
+
+	if (other == mainzone->rover)
+	    mainzone->rover = block;
+    }
+
+    Z_LinkFree (block);
+}
+
+
+
+//
+// Z_FindFree
+// A free block of at least size bytes, or NULL.
+// The bin of the size can have smaller blocks,
+//  so it is searched first for the closest fit,
+//  any block in a higher bin is big enough.
+//
+static memblock_t* Z_FindFree (int size)
+{
+    freeblock_t*	fb;
+    unsigned		mask;
+    int			bin;
+
+    bin = Z_BinForSize (size);
+
+    for (fb = mainzone->bins[bin] ; fb ; fb = fb->nextfree)
+    {
+	if (fb->block.size >= size)
+	    return &fb->block;
+    }
+
+    if (bin == NUMBINS-1)
+	return NULL;
+
+    mask = mainzone->binmask & ~((2u<<bin)-1);
+    if (!mask)
+	return NULL;
+
+    return &mainzone->bins[__builtin_ctz (mask)]->block;
+}
+
+
+//
+// Z_PurgeFor
+// Throws out the first run of purgable blocks from the
+//  rover on that, with the free blocks between them,
+//  makes a free block of at least size bytes.
+//
+static void Z_PurgeFor (int size)
+{
+    memblock_t*	start;
+    memblock_t*	block;
+    memblock_t*	first;
+    memblock_t*	prev;
+    int		total;
+
+    start = block = mainzone->rover;
+    first = NULL;
+    total = 0;
+
+    do
+    {
+	if (!block->user || block->tag >= PU_PURGELEVEL)
+	{
+	    if (!first)
+	    {
+		first = block;
+		total = 0;
+	    }
+	    total += block->size;
+
+	    if (total >= size)
+		break;
+	}
+	else
+	{
+	    // hit a block that can't be purged
+	    first = NULL;
+	}
+
+	block = block->next;
+    } while (block != start);
+
+    if (!first || total < size)
+	return;
+
+    // next purge starts after this one
+    mainzone->rover = block->next;
+
+    // free from the end back, a block freed only merges
+    //  into the one before it, which is still to be seen
+    for ( ; ; block = prev)
+    {
+	prev = block->prev;
+
+	if (block->user)
+	    Z_CacheEvict (block);
+
+	if (block == first)
+	    break;
+    }
+}
+
+
+
+//
+// Z_Malloc
+// You can pass a NULL user if the tag is < PU_PURGELEVEL.
+//
+#define MINFRAGMENT		64
+
+
+void*
+Z_Malloc
+( int		size,
+  int		tag,
+  void*		user )
+{
+    int		extra;
+    int		evicted;
+    int		freed;
+    memblock_t* newblock;
+    memblock_t*	base;
+
+    if (Z_ISLEVELTAG (tag))
+	return Z_ArenaMalloc (size, tag, user);
+
+    // keep purgable blocks under -cachebudget
+    Z_CacheBudget ();
+
+    size = (size + ZONEALIGN-1) & ~(ZONEALIGN-1);
+
+    // account for size of block header
+    size += sizeof(memblock_t);
+
+    zoneallocs++;
+    zoneallocbytes += size;
+
+    // room for the free links once it is freed
+    if (size < sizeof(freeblock_t))
+	size = sizeof(freeblock_t);
+
+    base = Z_FindFree (size);
+
+    // nothing free is big enough, throw out what was used
+    //  longest ago. When as much as size is out and there
+    //  is still no hole, the zone is fragmented, and more
+    //  would only flush the cache.
+    for (evicted = 0 ; !base && evicted < size ; )
+    {
+	freed = Z_EvictOldest ();
+	if (!freed)
+	    break;
+	evicted += freed;
+	base = Z_FindFree (size);
+    }
+
+    // then get a new region with room, up to -heapmax
+    if (!base)
+	base = Z_AddRegion (size);
+
+    // then the rest of what is not being drawn
+    while (!base && Z_EvictOldest ())
+	base = Z_FindFree (size);
+
+    if (!base)
+    {
+	// last resort, anything purgable
+	Z_PurgeFor (size);
+	base = Z_FindFree (size);
+
+	if (!base)
+	    I_Error ("Z_Malloc: failed on allocation of %i bytes", size);
+    }
+
+    Z_UnlinkFree (base);
+
+    // found a block big enough
+    extra = base->size - size;
+
+    if (extra >  MINFRAGMENT && extra >= sizeof(freeblock_t))
+    {
+	// there will be a free fragment after the allocated block
+	newblock = (memblock_t *) ((byte *)base + size );
+	newblock->size = extra;
+
+	// NULL indicates free block.
+	newblock->user = NULL;
+	newblock->tag = 0;
+	newblock->id = 0;
+	newblock->prev = base;
+	newblock->next = base->next;
+	newblock->next->prev = newblock;
+
+	base->next = newblock;
+	base->size = size;
+
+	Z_LinkFree (newblock);
+    }
+
+    if (user)
+    {
+	// mark as an in use block
+	base->user = user;
+	*(void **)user = (void *) ((byte *)base + sizeof(memblock_t));
+    }
+    else
+    {
+	if (tag >= PU_PURGELEVEL)
+	    I_Error ("Z_Malloc: an owner is required for purgable blocks");
+
+	// mark as in use, but unowned
+	base->user = (void *)2;
+    }
+    Z_CacheRetag (base, tag);
+    base->tag = tag;
+
+    base->id = ZONEID;
+
+    return (void *) ((byte *)base + sizeof(memblock_t));
+}
+
+
+
+//
+// Z_FreeTags
+//
+void
+Z_FreeTags
+( int		lowtag,
+  int		hightag )
+{
+    memblock_t*	block;
+    memblock_t*	next;
+    memblock_t*	prev;
+
+    Z_ArenaFreeTags (lowtag, hightag);
+
+    // what is left of the level is in the arena,
+    //  unless a heap block was changed to a level tag
+    if (lowtag >= PU_LEVEL && hightag < PU_PURGELEVEL && !numlevelblocks)
+	return;
+
+    for (block = mainzone->blocklist.next ;
+	 block != &mainzone->blocklist ;
+	 block = next)
+    {
+	// get link before freeing
+	next = block->next;
+
+	// free block?
+	if (!block->user)
+	    continue;
+
+	if (block->tag >= lowtag && block->tag <= hightag)
+	{
+	    prev = block->prev;
+	    Z_Free ( (byte *)block+sizeof(memblock_t));
+
+	    // it can be merged into the block before,
+	    //  and take in the one after
+	    block = prev->user ? prev->next : prev;
+	    next = block->next;
+	}
+    }
+}
+
+
+
+//
+// Z_ReleaseRegions
+//
+void Z_ReleaseRegions (void)
+{
+    memregion_t*	region;
+    memblock_t*		first;
+    memblock_t*		fence;
+    memblock_t*		block;
+    memblock_t*		prev;
+    int			i;
+
+    // never the first, it holds the zone
+    for (i=mainzone->numregions-1 ; i>0 ; i--)
+    {
+	region = &mainzone->regions[i];
+	first = (memblock_t *)region->base;
+
+	for (fence = first ; fence->id != FENCEID ; fence = fence->next)
+	    if (fence->user && fence->tag < PU_PURGELEVEL)
+		break;
+
+	if (fence->id != FENCEID)
+	    continue;
+
+	// throw out the cache, from the end back,
+	//  so all merges are into blocks still to be seen
+	for (block = fence->prev ; ; block = prev)
+	{
+	    prev = block->prev;
+
+	    if (block->user)
+		Z_CacheEvict (block);
+
+	    if (block == first)
+		break;
+	}
+
+	// first is now the only block before the fence
+	Z_UnlinkFree (first);
+	first->prev->next = fence->next;
+	fence->next->prev = first->prev;
+
+	if (mainzone->rover == first || mainzone->rover == fence)
+	    mainzone->rover = mainzone->blocklist.next;
+
+	mainzone->size -= region->size;
+	I_ZoneRelease (region->base, region->size);
+
+	*region = mainzone->regions[--mainzone->numregions];
+    }
+}
+
+
+
+//
+// Z_GetStats
+//
+void Z_GetStats (zonestats_t* stats)
+{
+    memblock_t*	block;
+
+    memset (stats, 0, sizeof(*stats));
+    stats->heapsize = mainzone->size;
+    stats->numregions = mainzone->numregions;
+
+    for (block = mainzone->blocklist.next ;
+	 block != &mainzone->blocklist ;
+	 block = block->next)
+    {
+	if (block->id == FENCEID)
+	    continue;
+
+	stats->numblocks++;
+
+	if (!block->user)
+	{
+	    stats->freebytes += block->size;
+	    if (block->size > stats->largestfree)
+		stats->largestfree = block->size;
+	}
+	else if (block->tag >= 0 && block->tag <= PU_CACHE)
+	    stats->tagbytes[block->tag] += block->size;
+    }
+
+    Z_ArenaStats (stats);
+}
+
+
+
+//
+// Z_FileDumpHeap
+//
+void Z_FileDumpHeap (FILE* f)
+{
+    memblock_t*	block;
+    freeblock_t*	fb;
+    int		i;
+
+    fprintf (f,"zone size: %i  location: %p\n",mainzone->size,mainzone);
+
+    for (block = mainzone->blocklist.next ; ; block = block->next)
+    {
+	fprintf (f,"block:%p    size:%7i    user:%p    tag:%3i\n",
+		 block, block->size, block->user, block->tag);
+
+	if (block->next == &mainzone->blocklist)
+	{
+	    // all blocks have been hit
+	    break;
+	}
+
+	if (block->id != FENCEID
+	    && (byte *)block + block->size != (byte *)block->next)
+	    fprintf (f,"ERROR: block size does not touch the next block\n");
+
+	if ( block->next->prev != block)
+	    fprintf (f,"ERROR: next block doesn't have proper back link\n");
+
+	if (!block->user && !block->next->user)
+	    fprintf (f,"ERROR: two consecutive free blocks\n");
+    }
+
+    for (i=0 ; i<NUMBINS ; i++)
+    {
+	if (!mainzone->bins[i])
+	    continue;
+
+	fprintf (f,"bin %2i:",i);
+	for (fb = mainzone->bins[i] ; fb ; fb = fb->nextfree)
+	    fprintf (f," %i",fb->block.size);
+	fprintf (f,"\n");
+    }
+}
+
+
+
+//
+// Z_CheckHeap
+//
+void Z_CheckHeap (void)
+{
+    memblock_t*	block;
+    freeblock_t*	fb;
+    int		numfree;
+    int		i;
+
+    numfree = 0;
+
+    for (block = mainzone->blocklist.next ; ; block = block->next)
+    {
+	if (!block->user)
+	    numfree++;
+
+	if (block->next == &mainzone->blocklist)
+	{
+	    // all blocks have been hit
+	    break;
+	}
+
+	if (block->id != FENCEID
+	    && (byte *)block + block->size != (byte *)block->next)
+	    I_Error ("Z_CheckHeap: block size does not touch the next block\n");
+
+	if ( block->next->prev != block)
+	    I_Error ("Z_CheckHeap: next block doesn't have proper back link\n");
+
+	if (!block->user && !block->next->user)
+	    I_Error ("Z_CheckHeap: two consecutive free blocks\n");
+    }
+
+    for (i=0 ; i<NUMBINS ; i++)
+    {
+	if (!mainzone->bins[i] != !(mainzone->binmask & (1u<<i)))
+	    I_Error ("Z_CheckHeap: bin mask is wrong\n");
+
+	for (fb = mainzone->bins[i] ; fb ; fb = fb->nextfree)
+	{
+	    if (fb->block.user)
+		I_Error ("Z_CheckHeap: used block in a bin\n");
+
+	    if (Z_BinForSize (fb->block.size) != i)
+		I_Error ("Z_CheckHeap: free block in the wrong bin\n");
+
+	    numfree--;
+	}
+    }
+
+    if (numfree)
+	I_Error ("Z_CheckHeap: free block not in a bin\n");
+}
+
+
+
+
+//
+// Z_ChangeTag
+//
+void
+Z_ChangeTag2
+( void*		ptr,
+  int		tag )
+{
+    memblock_t*	block;
+
+    if (Z_IsMapped (ptr))
+	return;
+
+    if (!Z_InZone (ptr))
+	I_Error ("Z_ChangeTag: a pointer outside the zone");
+
+    block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
+
+    if (block->id != ZONEID)
+	I_Error ("Z_ChangeTag: freed a pointer without ZONEID");
+
+    if (!block->next)
+    {
+	Z_ArenaChangeTag (block, tag);
+	return;
+    }
+
+    if (tag >= PU_PURGELEVEL && (size_t)block->user < 0x100)
+	I_Error ("Z_ChangeTag: an owner is required for purgable blocks");
+
+    if (Z_ISLEVELTAG (block->tag))
+	numlevelblocks--;
+    if (Z_ISLEVELTAG (tag))
+	numlevelblocks++;
+
+    Z_CacheRetag (block, tag);
+    block->tag = tag;
+}
+
+
+
+//
+// Z_FreeMemory
+//
+int Z_FreeMemory (void)
+{
+    memblock_t*		block;
+    int			free;
+
+    free = 0;
+
+    for (block = mainzone->blocklist.next ;
+	 block != &mainzone->blocklist;
+	 block = block->next)
+    {
+	if (!block->user || block->tag >= PU_PURGELEVEL)
+	    free += block->size;
+    }
+    return free;
+}
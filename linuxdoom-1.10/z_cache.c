@@ -0,0 +1,215 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Purge order of PU_CACHE blocks, for both zone allocators.
+//	Purgable blocks are kept on a list, most recently used
+//	 first, and stamped with the frame they were last used in.
+//	The zone throws out the oldest first, and with
+//	 -cachebudget keeps them under that many kilobytes.
+//	Also the mapped files used in place of cached blocks.
+//
+//-----------------------------------------------------------------------------
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+#include <stdlib.h>
+
+#include "doomtype.h"
+#include "z_zone.h"
+#include "i_system.h"
+#include "m_argv.h"
+#include "doomdef.h"
+
+
+cachestats_t	cachestats;
+int		cachebudget;
+
+// bytes in purgable blocks
+static int		cachedbytes;
+
+static int		cacheframe;
+
+// lru.lrunext is the most recently used
+static memblock_t	lru;
+
+
+
+//
+// Z_InitCache
+//
+void Z_InitCache (void)
+{
+    int		p;
+
+    lru.lrunext = lru.lruprev = &lru;
+
+    p = M_CheckParm ("-cachebudget");
+    if (p && p < myargc-1)
+	cachebudget = atoi (myargv[p+1])*1024;
+}
+
+
+//
+// Z_CacheFrame
+//
+void Z_CacheFrame (void)
+{
+    cacheframe++;
+}
+
+
+//
+// Z_CacheRetag
+// Before the tag of a block changes, and with
+//  tag 0 before it is freed.
+//
+void Z_CacheRetag (memblock_t* block, int tag)
+{
+    if (block->tag >= PU_PURGELEVEL)
+    {
+	// off the list
+	block->lruprev->lrunext = block->lrunext;
+	block->lrunext->lruprev = block->lruprev;
+	cachedbytes -= block->size;
+    }
+
+    if (tag >= PU_PURGELEVEL)
+    {
+	// used now, to the front
+	block->lrunext = lru.lrunext;
+	block->lruprev = &lru;
+	lru.lrunext->lruprev = block;
+	lru.lrunext = block;
+	cachedbytes += block->size;
+
+	block->lastuse = cacheframe;
+    }
+}
+
+
+//
+// Z_CacheEvict
+// Purges a block to make room.
+//
+void Z_CacheEvict (memblock_t* block)
+{
+    cachestats.evictions++;
+    cachestats.evictedbytes += block->size;
+
+    Z_Free ((byte *)block+sizeof(memblock_t));
+}
+
+
+//
+// Z_OldestBlock
+// The least recently used block, NULL if
+//  there is none older than this frame.
+//
+memblock_t* Z_OldestBlock (void)
+{
+    memblock_t*	block;
+
+    block = lru.lruprev;
+
+    if (block == &lru || block->lastuse == cacheframe)
+	return NULL;
+
+    return block;
+}
+
+
+//
+// Z_EvictOldest
+// Purges the least recently used block, and returns
+//  its size, 0 if there is none older than this frame.
+//
+int Z_EvictOldest (void)
+{
+    memblock_t*	block;
+    int		size;
+
+    block = Z_OldestBlock ();
+    if (!block)
+	return 0;
+
+    size = block->size;
+    Z_CacheEvict (block);
+    return size;
+}
+
+
+//
+// Z_CacheBudget
+// From Z_Malloc, before it looks for room.
+//
+void Z_CacheBudget (void)
+{
+    if (!cachebudget)
+	return;
+
+    while (cachedbytes > cachebudget && Z_EvictOldest ())
+	;
+}
+
+
+
+//
+// MAPPED MEMORY
+//
+typedef struct
+{
+    byte*	base;
+    int		length;
+
+} mapping_t;
+
+static mapping_t*	mappings;
+static int		nummappings;
+
+
+//
+// Z_AddMapped
+//
+void Z_AddMapped (void* base, int length)
+{
+    mappings = realloc (mappings, (nummappings+1)*sizeof(*mappings));
+    if (!mappings)
+	I_Error ("Z_AddMapped: couldn't realloc mappings");
+
+    mappings[nummappings].base = base;
+    mappings[nummappings].length = length;
+    nummappings++;
+}
+
+
+//
+// Z_IsMapped
+//
+int Z_IsMapped (void* ptr)
+{
+    int		i;
+
+    for (i=0 ; i<nummappings ; i++)
+    {
+	if ((byte *)ptr >= mappings[i].base
+	    && (byte *)ptr < mappings[i].base + mappings[i].length)
+	    return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,240 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//	Zone and lump cache numbers.
+//	Bytes by purge tag, the largest free block and how
+//	 broken up free memory is, the allocation rate, and
+//	 cache hits and misses by kind of lump.
+//	The idmem cheat shows a summary and prints the rest,
+//	 -memjson <file> writes a JSON line at each level exit,
+//	 so builds can be compared on the same demo.
+//
+//-----------------------------------------------------------------------------
+
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+
+#include <stdio.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "i_system.h"
+#include "m_argv.h"
+#include "z_zone.h"
+#include "w_wad.h"
+
+#include "z_stats.h"
+
+
+// Tics in the recent allocation rate.
+#define RATETICS	TICRATE
+
+
+int		zoneallocs;
+long long	zoneallocbytes;
+
+static FILE*	jsonfile;
+
+// allocations in each of the last RATETICS tics
+static int		ticallocs[RATETICS];
+static int		ticbytes[RATETICS];
+static int		numtics;
+static int		lastallocs;
+static long long	lastbytes;
+
+// since the last level exit
+static int		levelallocs;
+static long long	levelbytes;
+static int		leveltics;
+
+static struct
+{
+    int		tag;
+    char*	name;
+
+} tagnames[] =
+{
+    { PU_STATIC,	"static" },
+    { PU_SOUND,		"sound" },
+    { PU_MUSIC,		"music" },
+    { PU_DAVE,		"dave" },
+    { PU_LEVEL,		"level" },
+    { PU_LEVSPEC,	"levspec" },
+    { PU_PURGELEVEL,	"purgelevel" },
+    { PU_CACHE,		"cache" }
+};
+
+#define NUMTAGNAMES	(sizeof(tagnames)/sizeof(tagnames[0]))
+
+static char*	spacenames[NUMLUMPSPACES] =
+{
+    "other", "flats", "patches", "sprites", "sounds", "maps"
+};
+
+
+
+//
+// Z_InitStats
+//
+void Z_InitStats (void)
+{
+    int		p;
+
+    p = M_CheckParm ("-memjson");
+    if (p && p < myargc-1)
+    {
+	jsonfile = fopen (myargv[p+1], "w");
+	if (!jsonfile)
+	    I_Error ("Z_InitStats: couldn't open %s", myargv[p+1]);
+    }
+}
+
+
+//
+// Z_StatsTicker
+//
+void Z_StatsTicker (void)
+{
+    int		slot;
+
+    slot = numtics++ % RATETICS;
+    ticallocs[slot] = zoneallocs - lastallocs;
+    ticbytes[slot] = zoneallocbytes - lastbytes;
+
+    levelallocs += ticallocs[slot];
+    levelbytes += ticbytes[slot];
+    leveltics++;
+
+    lastallocs = zoneallocs;
+    lastbytes = zoneallocbytes;
+}
+
+
+//
+// Z_Fragmentation
+// 0 when all free memory is one block,
+//  towards 1 as it is broken up.
+//
+static double Z_Fragmentation (zonestats_t* zs)
+{
+    if (!zs->freebytes)
+	return 0;
+
+    return 1 - (double)zs->largestfree / zs->freebytes;
+}
+
+
+//
+// Z_StatsMessage
+//
+char* Z_StatsMessage (void)
+{
+    static char	buf[64];
+    zonestats_t	zs;
+    int		lookups;
+
+    Z_GetStats (&zs);
+    lookups = cachestats.hits + cachestats.misses;
+
+    sprintf (buf, "ZONE %.1f/%.1fMB BIG %.1fMB FRAG %.2f HIT %i%%",
+	     (zs.heapsize - zs.freebytes) / (1024*1024.0),
+	     zs.heapsize / (1024*1024.0),
+	     zs.largestfree / (1024*1024.0),
+	     Z_Fragmentation (&zs),
+	     lookups ? (int)(cachestats.hits*100LL / lookups) : 100);
+
+    return buf;
+}
+
+
+//
+// Z_WriteStats
+//
+void Z_WriteStats (FILE* f)
+{
+    zonestats_t	zs;
+    int		tics;
+    int		maxbytes;
+    int		sumbytes;
+    int		sumallocs;
+    int		i;
+
+    Z_GetStats (&zs);
+
+    fprintf (f, "{\"gametic\":%i,\"episode\":%i,\"map\":%i",
+	     gametic, gameepisode, gamemap);
+
+    fprintf (f, ",\"heap\":%i,\"regions\":%i,\"blocks\":%i"
+	     ",\"free\":%i,\"largest_free\":%i,\"fragmentation\":%.4f",
+	     zs.heapsize, zs.numregions, zs.numblocks,
+	     zs.freebytes, zs.largestfree, Z_Fragmentation (&zs));
+
+    fprintf (f, ",\"tags\":{");
+    for (i=0 ; i<NUMTAGNAMES ; i++)
+	fprintf (f, "%s\"%s\":%i", i ? "," : "",
+		 tagnames[i].name, zs.tagbytes[tagnames[i].tag]);
+    fprintf (f, "}");
+
+    // the last second
+    tics = numtics < RATETICS ? numtics : RATETICS;
+    maxbytes = sumbytes = sumallocs = 0;
+    for (i=0 ; i<tics ; i++)
+    {
+	sumbytes += ticbytes[i];
+	sumallocs += ticallocs[i];
+	if (ticbytes[i] > maxbytes)
+	    maxbytes = ticbytes[i];
+    }
+    if (!tics)
+	tics = 1;
+
+    fprintf (f, ",\"alloc_per_tic\":{\"allocs\":%.1f,\"bytes\":%.0f"
+	     ",\"max_bytes\":%i,\"level_allocs\":%.1f,\"level_bytes\":%.0f}",
+	     (double)sumallocs/tics, (double)sumbytes/tics, maxbytes,
+	     leveltics ? (double)levelallocs/leveltics : 0.0,
+	     leveltics ? (double)levelbytes/leveltics : 0.0);
+
+    fprintf (f, ",\"cache\":{\"hits\":%i,\"misses\":%i,\"evictions\":%i"
+	     ",\"evicted_bytes\":%lli,\"reloaded_bytes\":%lli,\"budget\":%i}",
+	     cachestats.hits, cachestats.misses, cachestats.evictions,
+	     cachestats.evictedbytes, cachestats.reloadedbytes, cachebudget);
+
+    fprintf (f, ",\"lumps\":{");
+    for (i=0 ; i<NUMLUMPSPACES ; i++)
+	fprintf (f, "%s\"%s\":{\"hits\":%i,\"misses\":%i}", i ? "," : "",
+		 spacenames[i], lumphits[i], lumpmisses[i]);
+    fprintf (f, "}}\n");
+
+    fflush (f);
+}
+
+
+//
+// Z_LevelStats
+//
+void Z_LevelStats (void)
+{
+    if (jsonfile)
+	Z_WriteStats (jsonfile);
+
+    levelallocs = 0;
+    levelbytes = 0;
+    leveltics = 0;
+}
@@ -0,0 +1,53 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// This source is available for distribution and/or modification
+// only under the terms of the DOOM Source Code License as
+// published by id Software. All rights reserved.
+//
+// The source is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// FITNESS FOR A PARTICULAR PURPOSE. See the DOOM Source Code License
+// for more details.
+//
+// DESCRIPTION:
+//	Zone and lump cache numbers.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __Z_STATS__
+#define __Z_STATS__
+
+#include <stdio.h>
+
+#ifdef __GNUG__
+#pragma interface
+#endif
+
+
+// Reads -memjson <file>.
+void Z_InitStats (void);
+
+// Every tic, for the allocation rate.
+void Z_StatsTicker (void);
+
+// One line for the idmem cheat.
+char* Z_StatsMessage (void);
+
+// Everything as one JSON object on one line.
+void Z_WriteStats (FILE* f);
+
+// At level exit, adds a line to the -memjson file.
+// The level numbers start over.
+void Z_LevelStats (void);
+
+
+#endif
+//-----------------------------------------------------------------------------
+//
+// $Log:$
+//
+//-----------------------------------------------------------------------------
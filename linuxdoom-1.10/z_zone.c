@@ -24,6 +24,8 @@
 static const char __attribute__((unused))
 rcsid[] = "$Id: z_zone.c,v 1.4 1997/02/03 16:47:58 b1 Exp $";
 
+#include <string.h>
+
 #include "z_zone.h"
 #include "i_system.h"
 #include "doomdef.h"
@@ -38,9 +40,26 @@ rcsid[] = "$Id: z_zone.c,v 1.4 1997/02/03 16:47:58 b1 Exp $";
 //
 // It is of no value to free a cachable block,
 //  because it will get overwritten automatically if needed.
+//
+// The zone can be made of more than one region, the list
+//  goes through them in the order they were added.
+// Each region ends in a fence block that is always in use,
+//  so nothing merges across, and there is space between
+//  a fence and the next block.
 // 
  
 #define ZONEID	0x1d4a11
+#define FENCEID	0x1d4a12
+
+#define MAXREGIONS	64
+
+
+typedef struct
+{
+    byte*	base;
+    int		size;
+
+} memregion_t;
 
 
 typedef struct
@@ -52,6 +71,10 @@ typedef struct
     memblock_t	blocklist;
     
     memblock_t*	rover;
+
+    // the first one holds the memzone_t
+    memregion_t	regions[MAXREGIONS];
+    int		numregions;
     
 } memzone_t;
 
@@ -59,30 +82,75 @@ typedef struct
 
 memzone_t*	mainzone;
 
+// heap blocks changed to a level tag, usually none
+static int	numlevelblocks;
+
 
 
 //
-// Z_ClearZone
+// Z_InitRegion
+// Makes the space from start to end one free block,
+//  and puts it at the end of the list with a fence.
 //
-void Z_ClearZone (memzone_t* zone)
+static memblock_t*
+Z_InitRegion
+( byte*		start,
+  byte*		end )
 {
-    memblock_t*		block;
-	
-    // set the entire zone to one free block
-    zone->blocklist.next =
-	zone->blocklist.prev =
-	block = (memblock_t *)( (byte *)zone + sizeof(memzone_t) );
-    
-    zone->blocklist.user = (void *)zone;
-    zone->blocklist.tag = PU_STATIC;
-    zone->rover = block;
-	
-    block->prev = block->next = &zone->blocklist;
-    
+    memblock_t*	block;
+    memblock_t*	fence;
+
+    block = (memblock_t *)start;
+    fence = (memblock_t *)(start + ((end - start - sizeof(memblock_t)) & ~7));
+
+    block->prev = mainzone->blocklist.prev;
+    block->next = fence;
+    fence->prev = block;
+    fence->next = &mainzone->blocklist;
+    block->prev->next = block;
+    mainzone->blocklist.prev = fence;
+
     // NULL indicates a free block.
-    block->user = NULL;	
+    block->user = NULL;
+    block->tag = 0;
+    block->id = 0;
+    block->size = (byte *)fence - start;
+
+    fence->user = (void *)mainzone;
+    fence->tag = PU_STATIC;
+    fence->id = FENCEID;
+    fence->size = sizeof(memblock_t);
 
-    block->size = zone->size - sizeof(memzone_t);
+    return block;
+}
+
+
+//
+// Z_AddRegion
+// Gets more memory when nothing in the zone
+//  can be freed to make room for size bytes.
+//
+static memblock_t* Z_AddRegion (int size)
+{
+    memregion_t*	region;
+    byte*		base;
+
+    if (mainzone->numregions == MAXREGIONS)
+	return NULL;
+
+    // the fence, and rounding
+    size += sizeof(memblock_t) + 8;
+
+    base = I_ZoneGrow (&size);
+    if (!base)
+	return NULL;
+
+    region = &mainzone->regions[mainzone->numregions++];
+    region->base = base;
+    region->size = size;
+    mainzone->size += size;
+
+    return Z_InitRegion (base, base+size);
 }
 
 
@@ -95,39 +163,81 @@ void Z_Init (void)
     memblock_t*	block;
     int		size;
 
+    Z_InitCache ();
+
     mainzone = (memzone_t *)I_ZoneBase (&size);
     mainzone->size = size;
 
-    // set the entire zone to one free block
+    mainzone->regions[0].base = (byte *)mainzone;
+    mainzone->regions[0].size = size;
+    mainzone->numregions = 1;
+
+    // an empty list
     mainzone->blocklist.next =
-	mainzone->blocklist.prev =
-	block = (memblock_t *)( (byte *)mainzone + sizeof(memzone_t) );
+	mainzone->blocklist.prev = &mainzone->blocklist;
 
     mainzone->blocklist.user = (void *)mainzone;
     mainzone->blocklist.tag = PU_STATIC;
+
+    // set the entire zone to one free block
+    block = Z_InitRegion ((byte *)mainzone + sizeof(memzone_t),
+			  (byte *)mainzone + size);
     mainzone->rover = block;
-	
-    block->prev = block->next = &mainzone->blocklist;
+}
 
-    // NULL indicates a free block.
-    block->user = NULL;
-    
-    block->size = mainzone->size - sizeof(memzone_t);
+
+//
+// Z_InZone
+//
+int Z_InZone (void* ptr)
+{
+    memregion_t*	region;
+    int			i;
+
+    for (i=0, region=mainzone->regions ; i<mainzone->numregions ; i++, region++)
+    {
+	if ((byte *)ptr > region->base
+	    && (byte *)ptr < region->base + region->size)
+	    return true;
+    }
+
+    return false;
 }
 
 
 //
 // Z_Free
 //
+void	(*zonefreehook) (void);
+
 void Z_Free (void* ptr)
 {
     memblock_t*		block;
     memblock_t*		other;
+
+    // used in place, e.g. a mapped lump
+    if (Z_IsMapped (ptr))
+	return;
+
+    if (!Z_InZone (ptr))
+	I_Error ("Z_Free: freed a pointer outside the zone");
 	
     block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
 
     if (block->id != ZONEID)
 	I_Error ("Z_Free: freed a pointer without ZONEID");
+
+    if (!block->next)
+    {
+	Z_ArenaFree (block);
+	return;
+    }
+
+    if (Z_ISLEVELTAG (block->tag))
+	numlevelblocks--;
+
+    if (zonefreehook)
+	zonefreehook ();
 		
     if (block->user > (void **)0x100)
     {
@@ -138,6 +248,8 @@ void Z_Free (void* ptr)
 	*block->user = 0;
     }
 
+    Z_CacheRetag (block, 0);
+
     // mark as free
     block->user = NULL;	
     block->tag = 0;
@@ -173,6 +285,50 @@ void Z_Free (void* ptr)
 
 
 
+//
+// Z_FindFree
+// The first free block of size bytes from the
+//  rover on, once around the list.
+//
+static memblock_t* Z_FindFree (int size)
+{
+    memblock_t*	start;
+    memblock_t*	rover;
+
+    start = rover = mainzone->rover;
+
+    do
+    {
+	if (!rover->user && rover->size >= size)
+	    return rover;
+	rover = rover->next;
+    } while (rover != start);
+
+    return NULL;
+}
+
+
+//
+// Z_EvictFor
+// Purges a block, and returns the free block
+//  it ends up in if that has size bytes.
+//
+static memblock_t* Z_EvictFor (memblock_t* block, int size)
+{
+    memblock_t*	prev;
+
+    prev = block->prev;
+    Z_CacheEvict (block);
+
+    // merged onto the end of a free block
+    if (!prev->user)
+	block = prev;
+
+    return block->size >= size ? block : NULL;
+}
+
+
+
 //
 // Z_Malloc
 // You can pass a NULL user if the tag is < PU_PURGELEVEL.
@@ -187,61 +343,98 @@ Z_Malloc
   void*		user )
 {
     int		extra;
+    int		evicted;
     memblock_t*	start;
     memblock_t* rover;
     memblock_t* newblock;
     memblock_t*	base;
+    memblock_t*	block;
+
+    if (Z_ISLEVELTAG (tag))
+	return Z_ArenaMalloc (size, tag, user);
+
+    // keep purgable blocks under -cachebudget
+    Z_CacheBudget ();
 
     size = (size + 3) & ~3;
     
-    // scan through the block list,
-    // looking for the first free block
-    // of sufficient size,
-    // throwing out any purgable blocks along the way.
-
     // account for size of block header
     size += sizeof(memblock_t);
+
+    zoneallocs++;
+    zoneallocbytes += size;
     
-    // if there is a free block behind the rover,
-    //  back up over them
-    base = mainzone->rover;
+    base = Z_FindFree (size);
+
+    // nothing free is big enough, throw out what was used
+    //  longest ago. When as much as size is out and there
+    //  is still no hole, the zone is fragmented, and more
+    //  would only flush the cache.
+    for (evicted = 0 ; !base && evicted < size ; )
+    {
+	block = Z_OldestBlock ();
+	if (!block)
+	    break;
+	evicted += block->size;
+	base = Z_EvictFor (block, size);
+    }
+
+    // then get a new region with room, up to -heapmax
+    if (!base)
+	base = Z_AddRegion (size);
+
+    // then the rest of what is not being drawn
+    while (!base && (block = Z_OldestBlock ()))
+	base = Z_EvictFor (block, size);
+
+    if (!base)
+    {
+	// last resort, scan through the block list,
+	// looking for the first free block
+	// of sufficient size,
+	// throwing out any purgable blocks along the way.
+
+	// if there is a free block behind the rover,
+	//  back up over them
+	base = mainzone->rover;
     
-    if (!base->prev->user)
-	base = base->prev;
+	if (!base->prev->user)
+	    base = base->prev;
 	
-    rover = base;
-    start = base->prev;
-	
-    do
-    {
-	if (rover == start)
-	{
-	    // scanned all the way around the list
-	    I_Error ("Z_Malloc: failed on allocation of %i bytes", size);
-	}
+	rover = base;
+	start = base->prev;
 	
-	if (rover->user)
+	do
 	{
-	    if (rover->tag < PU_PURGELEVEL)
+	    if (rover == start)
 	    {
-		// hit a block that can't be purged,
-		//  so move base past it
-		base = rover = rover->next;
+		// scanned all the way around the list
+		I_Error ("Z_Malloc: failed on allocation of %i bytes", size);
 	    }
-	    else
+	
+	    if (rover->user)
 	    {
-		// free the rover block (adding the size to base)
-
-		// the rover can be the base block
-		base = base->prev;
-		Z_Free ((byte *)rover+sizeof(memblock_t));
-		base = base->next;
-		rover = base->next;
+		if (rover->tag < PU_PURGELEVEL)
+		{
+		    // hit a block that can't be purged,
+		    //  so move base past it
+		    base = rover = rover->next;
+		}
+		else
+		{
+		    // free the rover block (adding the size to base)
+
+		    // the rover can be the base block
+		    base = base->prev;
+		    Z_CacheEvict (rover);
+		    base = base->next;
+		    rover = base->next;
+		}
 	    }
-	}
-	else
-	    rover = rover->next;
-    } while (base->user || base->size < size);
+	    else
+		rover = rover->next;
+	} while (base->user || base->size < size);
+    }
 
     
     // found a block big enough
@@ -278,6 +471,7 @@ Z_Malloc
 	// mark as in use, but unowned	
 	base->user = (void *)2;		
     }
+    Z_CacheRetag (base, tag);
     base->tag = tag;
 
     // next allocation will start looking here
@@ -301,6 +495,13 @@ Z_FreeTags
     memblock_t*	block;
     memblock_t*	next;
 	
+    Z_ArenaFreeTags (lowtag, hightag);
+
+    // what is left of the level is in the arena,
+    //  unless a heap block was changed to a level tag
+    if (lowtag >= PU_LEVEL && hightag < PU_PURGELEVEL && !numlevelblocks)
+	return;
+
     for (block = mainzone->blocklist.next ;
 	 block != &mainzone->blocklist ;
 	 block = next)
@@ -320,46 +521,94 @@ Z_FreeTags
 
 
 //
-// Z_DumpHeap
-// Note: TFileDumpHeap( stdout ) ?
+// Z_ReleaseRegions
 //
-void
-Z_DumpHeap
-( int		lowtag,
-  int		hightag )
+void Z_ReleaseRegions (void)
 {
-    memblock_t*	block;
-	
-    printf ("zone size: %i  location: %p\n",
-	    mainzone->size,mainzone);
-    
-    printf ("tag range: %i to %i\n",
-	    lowtag, hightag);
-	
-    for (block = mainzone->blocklist.next ; ; block = block->next)
+    memregion_t*	region;
+    memblock_t*		first;
+    memblock_t*		fence;
+    memblock_t*		block;
+    memblock_t*		prev;
+    int			i;
+
+    // never the first, it holds the zone
+    for (i=mainzone->numregions-1 ; i>0 ; i--)
     {
-	if (block->tag >= lowtag && block->tag <= hightag)
-	    printf ("block:%p    size:%7i    user:%p    tag:%3i\n",
-		    block, block->size, block->user, block->tag);
-		
-	if (block->next == &mainzone->blocklist)
+	region = &mainzone->regions[i];
+	first = (memblock_t *)region->base;
+
+	for (fence = first ; fence->id != FENCEID ; fence = fence->next)
+	    if (fence->user && fence->tag < PU_PURGELEVEL)
+		break;
+
+	if (fence->id != FENCEID)
+	    continue;
+
+	// throw out the cache, from the end back,
+	//  so all merges are into blocks still to be seen
+	for (block = fence->prev ; ; block = prev)
 	{
-	    // all blocks have been hit
-	    break;
+	    prev = block->prev;
+
+	    if (block->user)
+		Z_CacheEvict (block);
+
+	    if (block == first)
+		break;
 	}
-	
-	if ( (byte *)block + block->size != (byte *)block->next)
-	    printf ("ERROR: block size does not touch the next block\n");
 
-	if ( block->next->prev != block)
-	    printf ("ERROR: next block doesn't have proper back link\n");
+	// first is now the only block before the fence
+	first->prev->next = fence->next;
+	fence->next->prev = first->prev;
 
-	if (!block->user && !block->next->user)
-	    printf ("ERROR: two consecutive free blocks\n");
+	if (mainzone->rover == first || mainzone->rover == fence)
+	    mainzone->rover = mainzone->blocklist.next;
+
+	mainzone->size -= region->size;
+	I_ZoneRelease (region->base, region->size);
+
+	*region = mainzone->regions[--mainzone->numregions];
+    }
+}
+
+
+
+//
+// Z_GetStats
+//
+void Z_GetStats (zonestats_t* stats)
+{
+    memblock_t*	block;
+
+    memset (stats, 0, sizeof(*stats));
+    stats->heapsize = mainzone->size;
+    stats->numregions = mainzone->numregions;
+
+    for (block = mainzone->blocklist.next ;
+	 block != &mainzone->blocklist ;
+	 block = block->next)
+    {
+	if (block->id == FENCEID)
+	    continue;
+
+	stats->numblocks++;
+
+	if (!block->user)
+	{
+	    stats->freebytes += block->size;
+	    if (block->size > stats->largestfree)
+		stats->largestfree = block->size;
+	}
+	else if (block->tag >= 0 && block->tag <= PU_CACHE)
+	    stats->tagbytes[block->tag] += block->size;
     }
+
+    Z_ArenaStats (stats);
 }
 
 
+
 //
 // Z_FileDumpHeap
 //
@@ -380,7 +629,8 @@ void Z_FileDumpHeap (FILE* f)
 	    break;
 	}
 	
-	if ( (byte *)block + block->size != (byte *)block->next)
+	if (block->id != FENCEID
+	    && (byte *)block + block->size != (byte *)block->next)
 	    fprintf (f,"ERROR: block size does not touch the next block\n");
 
 	if ( block->next->prev != block)
@@ -408,7 +658,8 @@ void Z_CheckHeap (void)
 	    break;
 	}
 	
-	if ( (byte *)block + block->size != (byte *)block->next)
+	if (block->id != FENCEID
+	    && (byte *)block + block->size != (byte *)block->next)
 	    I_Error ("Z_CheckHeap: block size does not touch the next block\n");
 
 	if ( block->next->prev != block)
@@ -431,15 +682,33 @@ Z_ChangeTag2
   int		tag )
 {
     memblock_t*	block;
+
+    if (Z_IsMapped (ptr))
+	return;
+
+    if (!Z_InZone (ptr))
+	I_Error ("Z_ChangeTag: a pointer outside the zone");
 	
     block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
 
     if (block->id != ZONEID)
 	I_Error ("Z_ChangeTag: freed a pointer without ZONEID");
 
+    if (!block->next)
+    {
+	Z_ArenaChangeTag (block, tag);
+	return;
+    }
+
     if (tag >= PU_PURGELEVEL && (size_t)block->user < 0x100)
 	I_Error ("Z_ChangeTag: an owner is required for purgable blocks");
 
+    if (Z_ISLEVELTAG (block->tag))
+	numlevelblocks--;
+    if (Z_ISLEVELTAG (tag))
+	numlevelblocks++;
+
+    Z_CacheRetag (block, tag);
     block->tag = tag;
 }
 
@@ -48,33 +48,129 @@ void	Z_Init (void);
 void*	Z_Malloc (int size, int tag, void *ptr);
 void    Z_Free (void *ptr);
 void    Z_FreeTags (int lowtag, int hightag);
-void    Z_DumpHeap (int lowtag, int hightag);
 void    Z_FileDumpHeap (FILE *f);
 void    Z_CheckHeap (void);
 void    Z_ChangeTag2 (void *ptr, int tag);
 int     Z_FreeMemory (void);
 
+// Gives back regions the zone grew by that hold
+//  nothing but purgable blocks, on level change.
+void    Z_ReleaseRegions (void);
+
+
+//
+// The heap as it is now, from Z_GetStats.
+// See z_stats.c for the rest of the numbers.
+//
+typedef struct
+{
+    int		heapsize;	// all regions, with headers
+    int		numregions;
+    int		numblocks;
+    int		freebytes;
+    int		largestfree;
+    int		tagbytes[PU_CACHE+1];	// in use, by purge tag
+
+} zonestats_t;
+
+void    Z_GetStats (zonestats_t* stats);
+
+// Z_Malloc calls and bytes since startup.
+extern int		zoneallocs;
+extern long long	zoneallocbytes;
+
+
+// False for memory the zone did not hand out.
+int     Z_InZone (void *ptr);
+
+// Files mapped by w_wad.c and r_cache.c, used in
+//  place of cached blocks. Z_Free and Z_ChangeTag
+//  leave them alone, so callers need not know where
+//  a lump came from. Anything else outside the zone
+//  is an error.
+void    Z_AddMapped (void* base, int length);
+int     Z_IsMapped (void* ptr);
+
+// Called before any block is freed or purged,
+//  e.g. to finish drawing from it.
+extern void	(*zonefreehook) (void);
+
 
 typedef struct memblock_s
 {
     int			size;	// including the header and possibly tiny fragments
+    int			lastuse;	// cacheframe, if purgable
     void**		user;	// NULL if a free block
     int			tag;	// purgelevel
     int			id;	// should be ZONEID
     struct memblock_s*	next;
     struct memblock_s*	prev;
+    struct memblock_s*	lrunext;	// purgable blocks, most recent first
+    struct memblock_s*	lruprev;
 } memblock_t;
 
+
+//
+// PURGABLE BLOCKS, z_cache.c
+// Blocks at PU_PURGELEVEL and up are purged least
+//  recently used first. Z_ChangeTag to a purgable tag
+//  counts as a use, as W_CacheLumpNum does on a hit.
+//
+typedef struct
+{
+    int		hits;		// W_CacheLumpNum found it cached
+    int		misses;		//  or read it in
+    int		evictions;	// purged to make room
+    long long	evictedbytes;
+    long long	reloadedbytes;	// misses on lumps read before
+
+} cachestats_t;
+
+extern cachestats_t	cachestats;
+
+// Bytes purgable blocks may hold before the oldest are
+//  purged, -cachebudget <kb>, 0 for as much as fits.
+extern int	cachebudget;
+
+// Called once per drawn frame, what was used
+//  this frame is only purged as a last resort.
+void	Z_CacheFrame (void);
+
+// For the allocators.
+void	Z_InitCache (void);
+void	Z_CacheRetag (memblock_t* block, int tag);
+void	Z_CacheEvict (memblock_t* block);
+memblock_t* Z_OldestBlock (void);
+int	Z_EvictOldest (void);
+void	Z_CacheBudget (void);
+
+
+//
+// LEVEL MEMORY, z_arena.c
+// PU_LEVEL and PU_LEVSPEC blocks are not in the heap,
+//  Z_Malloc, Z_Free, Z_ChangeTag and Z_FreeTags pass
+//  them on to these.
+//
+#define Z_ISLEVELTAG(tag)	((tag) == PU_LEVEL || (tag) == PU_LEVSPEC)
+
+void*	Z_ArenaMalloc (int size, int tag, void* user);
+void	Z_ArenaFree (memblock_t* block);
+void	Z_ArenaChangeTag (memblock_t* block, int tag);
+void	Z_ArenaFreeTags (int lowtag, int hightag);
+void	Z_ArenaStats (zonestats_t* stats);
+
 //
 // This is used to get the local FILE:LINE info from CPP
 // prior to really call the function in question.
 //
 #define Z_ChangeTag(p,t) \
+do \
 { \
-      if (( (memblock_t *)( (byte *)(p) - sizeof(memblock_t)))->id!=0x1d4a11) \
-	  I_Error("Z_CT at "__FILE__":%i",__LINE__); \
-	  Z_ChangeTag2(p,t); \
-};
+    if (!Z_IsMapped(p) \
+	&& ( (memblock_t *)( (byte *)(p) - sizeof(memblock_t)))->id!=0x1d4a11) \
+	I_Error("Z_CT at "__FILE__":%i",__LINE__); \
+    Z_ChangeTag2(p,t); \
+} while (0)
 
 
 